@@ -0,0 +1,144 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "array.h"
+#include "color.h"
+#include "display.h"
+#include "schemes.h"
+#include "sequences.h"
+#include "state.h"
+
+/*
+ * Throughput of display_sequence for each type of color scheme against the previous per-residue coloring
+ */
+
+#define NRECORDS 2000
+#define SEQ_LEN 200 // Residues shown in a row of a wide terminal
+#define NREPEATS 5
+
+State state; // Read by the display functions
+
+// Previous coloring, which looked up and formatted the colors of each residue, kept as a reference
+void display_residues_per_residue(Array *buffer, SeqType seq_type, const char *seq, size_t len)
+{
+    SeqTypeState *type = state.types + seq_type;
+    const Alphabet *alphabet = type->alphabet;
+    ColorScheme *color_scheme = type->color_scheme;
+    char s[12];
+    for (size_t i = 0; i < len; i++)
+    {
+        char sym = seq[i];
+        int index = ((unsigned char)sym < 128) ? alphabet->index_map[(unsigned char)sym] : -1;
+        int n;
+        if (index < 0 || !color_scheme->mask.fg[index])
+            n = sprintf(s, "\x1b[39;49m");
+        else if (color_scheme->type == COLOR_4_BIT)
+            n = sprintf(s, "\x1b[%dm", color_scheme->map.b4.fg[index]);
+        else
+            n = sprintf(s, "\x1b[38;5;%dm", color_scheme->map.b8.fg[index]);
+        array_extend(buffer, s, n);
+        array_append(buffer, &sym);
+    }
+    array_extend(buffer, "\x1b[39;49m", sizeof("\x1b[39;49m") - 1);
+}
+
+SeqRecord *make_records(const char *syms, unsigned int nsyms, SeqType type)
+{
+    SeqRecord *records = malloc(NRECORDS * sizeof(SeqRecord));
+    char *seqs = malloc((size_t)NRECORDS * SEQ_LEN);
+    if (records == NULL || seqs == NULL)
+    {
+        free(records);
+        free(seqs);
+        return NULL;
+    }
+    uint32_t x = 1;
+    for (size_t i = 0; i < (size_t)NRECORDS * SEQ_LEN; i++)
+    {
+        x = 1664525 * x + 1013904223;
+        seqs[i] = syms[(x >> 16) % nsyms];
+    }
+    for (int i = 0; i < NRECORDS; i++)
+        records[i] = (SeqRecord){.seq = seqs + (size_t)i * SEQ_LEN, .len = SEQ_LEN, .span = SEQ_LEN, .type = type};
+    return records;
+}
+
+double best_time(bool per_residue, SeqRecord *records, Array *buffer)
+{
+    double best = -1;
+    for (int i = 0; i < NREPEATS; i++)
+    {
+        struct timespec start, stop;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int j = 0; j < NRECORDS; j++)
+        {
+            buffer->len = 0;
+            if (per_residue)
+                display_residues_per_residue(buffer, records[j].type, records[j].seq, SEQ_LEN);
+            else
+                display_sequence(buffer, records + j, 0, SEQ_LEN);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        double elapsed = (stop.tv_sec - start.tv_sec) + 1e-9 * (stop.tv_nsec - start.tv_nsec);
+        if (best < 0 || elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+int main(void)
+{
+    if (sequences_init_base_alphabets() != 0 || schemes_init_base() != 0)
+        return 1;
+    SeqTypeState types[SEQ_TYPE_ERROR + 1] = {{0}};
+    types[SEQ_TYPE_NUCLEIC].alphabet = &NUCLEIC_ALPHABET;
+    types[SEQ_TYPE_PROTEIN].alphabet = &PROTEIN_ALPHABET;
+    state.types = types;
+    state.ntypes = SEQ_TYPE_ERROR + 1;
+    state.ncolors = 256;
+    Array buffer;
+    if (array_init(&buffer, sizeof(char)) != 0)
+        return 1;
+
+    // Gaps come in runs as in alignments, so runs of one color are as common as they would be in views
+    SeqRecord *nucleic = make_records("ACGTACGTACGTN-----", 18, SEQ_TYPE_NUCLEIC);
+    SeqRecord *protein = make_records("ACDEFGHIKLMNPQRSTVWYX-----", 26, SEQ_TYPE_PROTEIN);
+    if (nucleic == NULL || protein == NULL)
+        return 1;
+    struct
+    {
+        const char *name;
+        SeqRecord *records;
+        SeqType type;
+        ColorScheme *scheme;
+    } cases[] = {
+        {"nucleic, 4-bit", nucleic, SEQ_TYPE_NUCLEIC, &schemes_default_nucleic_4_bit},
+        {"nucleic, 8-bit", nucleic, SEQ_TYPE_NUCLEIC, &schemes_default_nucleic_8_bit},
+        {"protein, 4-bit", protein, SEQ_TYPE_PROTEIN, &schemes_default_protein_4_bit},
+        {"protein, 8-bit", protein, SEQ_TYPE_PROTEIN, &schemes_default_protein_8_bit},
+    };
+
+    double mresidues = (double)NRECORDS * SEQ_LEN / 1e6;
+    printf("%d rows of %d residues\n", NRECORDS, SEQ_LEN);
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        state_set_type_color_scheme(&state, cases[i].type, cases[i].scheme);
+        double t_per_residue = best_time(true, cases[i].records, &buffer);
+        double bytes_per_residue = (double)buffer.len / SEQ_LEN;
+        double t_table = best_time(false, cases[i].records, &buffer);
+        printf("%s  per residue %7.1f Mres/s (%.1f bytes/res)  tables %7.1f Mres/s (%.1f bytes/res)  %.2fx\n",
+               cases[i].name, mresidues / t_per_residue, bytes_per_residue, mresidues / t_table,
+               (double)buffer.len / SEQ_LEN, t_per_residue / t_table);
+    }
+
+    free(nucleic->seq);
+    free(nucleic);
+    free(protein->seq);
+    free(protein);
+    array_free(&buffer);
+    for (unsigned int i = 0; i < SCHEMES_N_BASE; i++)
+        color_free_color_scheme(schemes_base + i);
+    return 0;
+}
@@ -0,0 +1,171 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "arena.h"
+#include "array.h"
+#include "fasta.h"
+#include "sequences.h"
+
+/*
+ * Throughput of the chunked FASTA reader against the previous getline-based reader
+ */
+
+#define NRECORDS 20000
+#define SEQ_LEN 1500
+#define NREPEATS 3
+
+// Previous reader, kept as a reference
+int getline_fread(FILE *fp, size_t *nresidues)
+{
+    Array records;
+    array_init(&records, sizeof(SeqRecord));
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t linelen;
+    size_t bufferlen = 256, seqlen = 0;
+    char *buffer = malloc(bufferlen);
+    int nrecords = 0;
+    *nresidues = 0;
+
+    while ((linelen = getline(&line, &capacity, fp)) == 1 && line[0] == '\n')
+        ;
+    while (linelen > 0)
+    {
+        if (line[0] == '\n')
+        {
+            linelen = getline(&line, &capacity, fp);
+            continue;
+        }
+        ssize_t trimlen = linelen;
+        while (line[trimlen - 1] == '\n' || line[trimlen - 1] == '\r')
+            trimlen--;
+        char *header = malloc(trimlen);
+        memcpy(header, line + 1, trimlen - 1);
+        header[trimlen - 1] = '\0';
+        char *id = fasta_get_id(header);
+
+        seqlen = 0;
+        while ((linelen = getline(&line, &capacity, fp)) > 0 && (line[0] != '>'))
+        {
+            trimlen = linelen;
+            while (trimlen > 0 && (line[trimlen - 1] == '\n' || line[trimlen - 1] == '\r'))
+                trimlen--;
+            while (bufferlen <= seqlen + trimlen + 1)
+            {
+                bufferlen *= 2;
+                buffer = realloc(buffer, bufferlen);
+            }
+            memcpy(buffer + seqlen, line, trimlen);
+            seqlen += trimlen;
+            buffer[seqlen] = '\0';
+        }
+        char *seq = malloc(seqlen + 1);
+        memcpy(seq, buffer, seqlen + 1);
+        *nresidues += seqlen;
+        nrecords++;
+
+        SeqRecord record = {.header = header, .id = id, .seq = seq, .len = seqlen};
+        array_append(&records, &record);
+    }
+    free(line);
+    free(buffer);
+    array_shrink(&records);
+    sequences_free_seq_records(records.data, records.len);
+    return nrecords;
+}
+
+int chunked_fread(FILE *fp, size_t *nresidues)
+{
+    Arena arena;
+    arena_init(&arena, 0);
+    SeqRecord *records = NULL;
+    int nrecords = fasta_fread(fp, &arena, &records);
+    *nresidues = 0;
+    for (int i = 0; i < nrecords; i++)
+        *nresidues += records[i].len;
+    free(records);
+    arena_free(&arena);
+    return nrecords;
+}
+
+FILE *make_input(size_t line_len)
+{
+    FILE *fp = tmpfile();
+    if (fp == NULL)
+        return NULL;
+    char *seq = malloc(SEQ_LEN);
+    if (seq == NULL)
+    {
+        fclose(fp);
+        return NULL;
+    }
+    uint32_t x = 1;
+    for (int i = 0; i < NRECORDS; i++)
+    {
+        for (int j = 0; j < SEQ_LEN; j++)
+        {
+            x = 1664525 * x + 1013904223;
+            seq[j] = "ACDEFGHIKLMNPQRSTVWY-"[(x >> 16) % 21];
+        }
+        fprintf(fp, ">seq%d some description of the sequence\n", i);
+        fasta_wrap_string(fp, seq, SEQ_LEN, line_len);
+    }
+    free(seq);
+    fflush(fp);
+    return fp;
+}
+
+double best_time(int (*reader)(FILE *, size_t *), FILE *fp, int *nrecords, size_t *nresidues)
+{
+    double best = -1;
+    for (int i = 0; i < NREPEATS; i++)
+    {
+        struct timespec start, stop;
+        fseek(fp, 0, SEEK_SET);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        *nrecords = reader(fp, nresidues);
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        double elapsed = (stop.tv_sec - start.tv_sec) + 1e-9 * (stop.tv_nsec - start.tv_nsec);
+        if (best < 0 || elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+int main(void)
+{
+    struct
+    {
+        char *name;
+        size_t line_len;
+    } inputs[] = {{"wrapped (60)", 60}, {"unwrapped", SEQ_LEN}};
+
+    for (unsigned int i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
+    {
+        FILE *fp = make_input(inputs[i].line_len);
+        if (fp == NULL)
+        {
+            fprintf(stderr, "Failed to create input\n");
+            return 1;
+        }
+        double mbytes = ftell(fp) / 1e6;
+
+        int nrecords_1, nrecords_2;
+        size_t nresidues_1, nresidues_2;
+        double t_getline = best_time(&getline_fread, fp, &nrecords_1, &nresidues_1);
+        double t_chunked = best_time(&chunked_fread, fp, &nrecords_2, &nresidues_2);
+        if (nrecords_1 != nrecords_2 || nresidues_1 != nresidues_2)
+        {
+            fprintf(stderr, "%s: Readers disagree\n", inputs[i].name);
+            return 1;
+        }
+        printf("%-14s %7.1f MB  getline %8.1f MB/s  chunked %8.1f MB/s  (%.2fx)\n",
+               inputs[i].name, mbytes, mbytes / t_getline, mbytes / t_chunked, t_getline / t_chunked);
+        fclose(fp);
+    }
+    return 0;
+}
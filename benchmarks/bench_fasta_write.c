@@ -0,0 +1,115 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fasta.h"
+#include "sequences.h"
+
+/*
+ * Throughput of the block writer against the stdio writer
+ */
+
+#define NRECORDS 20000
+#define SEQ_LEN 1500
+#define NREPEATS 3
+
+int stdio_write(FILE *fp, SeqRecord *records, size_t line_len)
+{
+    fasta_fwrite(fp, records, NRECORDS, line_len);
+    return fflush(fp);
+}
+
+int block_write(FILE *fp, SeqRecord *records, size_t line_len)
+{
+    return fasta_fdwrite(fileno(fp), records, NRECORDS, line_len);
+}
+
+SeqRecord *make_records(void)
+{
+    SeqRecord *records = malloc(NRECORDS * sizeof(SeqRecord));
+    char *seqs = malloc((size_t)NRECORDS * SEQ_LEN);
+    char *headers = malloc(NRECORDS * 64);
+    if (records == NULL || seqs == NULL || headers == NULL)
+    {
+        free(records);
+        free(seqs);
+        free(headers);
+        return NULL;
+    }
+    uint32_t x = 1;
+    for (size_t i = 0; i < (size_t)NRECORDS * SEQ_LEN; i++)
+    {
+        x = 1664525 * x + 1013904223;
+        seqs[i] = "ACDEFGHIKLMNPQRSTVWY-"[(x >> 16) % 21];
+    }
+    for (int i = 0; i < NRECORDS; i++)
+    {
+        char *header = headers + i * 64;
+        int header_len = snprintf(header, 64, "seq%d some description of the sequence", i);
+        records[i] = (SeqRecord){.header = header, .header_len = header_len, .seq = seqs + (size_t)i * SEQ_LEN,
+                                 .len = SEQ_LEN, .span = SEQ_LEN};
+    }
+    return records;
+}
+
+double best_time(int (*writer)(FILE *, SeqRecord *, size_t), SeqRecord *records, size_t line_len, long *nbytes)
+{
+    double best = -1;
+    for (int i = 0; i < NREPEATS; i++)
+    {
+        FILE *fp = tmpfile();
+        if (fp == NULL)
+            return -1;
+        struct timespec start, stop;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (writer(fp, records, line_len) != 0)
+        {
+            fclose(fp);
+            return -1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        *nbytes = lseek(fileno(fp), 0, SEEK_END);
+        fclose(fp);
+        double elapsed = (stop.tv_sec - start.tv_sec) + 1e-9 * (stop.tv_nsec - start.tv_nsec);
+        if (best < 0 || elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+int main(void)
+{
+    struct
+    {
+        char *name;
+        size_t line_len;
+    } outputs[] = {{"wrapped (60)", 60}, {"unwrapped", 0}};
+
+    SeqRecord *records = make_records();
+    if (records == NULL)
+    {
+        fprintf(stderr, "Failed to create records\n");
+        return 1;
+    }
+    for (unsigned int i = 0; i < sizeof(outputs) / sizeof(outputs[0]); i++)
+    {
+        long nbytes_1, nbytes_2;
+        double t_stdio = best_time(&stdio_write, records, outputs[i].line_len, &nbytes_1);
+        double t_block = best_time(&block_write, records, outputs[i].line_len, &nbytes_2);
+        if (t_stdio < 0 || t_block < 0 || nbytes_1 != nbytes_2)
+        {
+            fprintf(stderr, "%s: Writers failed or disagree\n", outputs[i].name);
+            return 1;
+        }
+        double mbytes = nbytes_1 / 1e6;
+        printf("%-14s %7.1f MB  stdio %8.1f MB/s  block %8.1f MB/s  (%.2fx)\n",
+               outputs[i].name, mbytes, mbytes / t_stdio, mbytes / t_block, t_stdio / t_block);
+    }
+    free(records[0].header);
+    free(records[0].seq);
+    free(records);
+    return 0;
+}
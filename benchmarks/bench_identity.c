@@ -0,0 +1,119 @@
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "identity.h"
+#include "sequences.h"
+
+/*
+ * Pairwise identities of a band of rows against all rows, bytewise and with bit planes over increasing threads
+ */
+
+#define NROWS 4096
+#define NCOLS 1000
+#define BAND_NROWS IDENTITY_BLOCK_NROWS
+
+// Bytewise comparison of each pair, as an identity matrix would be computed without bit planes
+void compute_rows_bytewise(SeqRecord *records, size_t start, size_t nrows, float *identities)
+{
+    for (size_t i = 0; i < nrows; i++)
+    {
+        const char *x = records[start + i].seq;
+        for (size_t j = 0; j < NROWS; j++)
+        {
+            const char *y = records[j].seq;
+            unsigned int naligned = 0, nidentical = 0;
+            for (size_t k = 0; k < NCOLS; k++)
+            {
+                if (x[k] == '-' || y[k] == '-')
+                    continue;
+                naligned++;
+                nidentical += toupper((unsigned char)x[k]) == toupper((unsigned char)y[k]);
+            }
+            identities[i * NROWS + j] = (naligned > 0) ? 100.0f * nidentical / naligned : NAN;
+        }
+    }
+}
+
+double elapsed_since(struct timespec *start)
+{
+    struct timespec stop;
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    return (stop.tv_sec - start->tv_sec) + 1e-9 * (stop.tv_nsec - start->tv_nsec);
+}
+
+int main(void)
+{
+    if (sequences_init_base_alphabets() != 0)
+        return 1;
+    const char *syms = "ACDEFGHIKLMNPQRSTVWY-";
+    SeqRecord *records = malloc(NROWS * sizeof(SeqRecord));
+    if (records == NULL)
+        return 1;
+    uint32_t x = 1;
+    for (size_t i = 0; i < NROWS; i++)
+    {
+        char *seq = malloc(NCOLS);
+        if (seq == NULL)
+            return 1;
+        for (size_t j = 0; j < NCOLS; j++)
+        {
+            x = 1664525 * x + 1013904223;
+            seq[j] = syms[(x >> 16) % 21];
+        }
+        records[i] = (SeqRecord){.seq = seq, .len = NCOLS, .span = NCOLS, .type = SEQ_TYPE_PROTEIN};
+    }
+    float *expected = malloc((size_t)BAND_NROWS * NROWS * sizeof(float));
+    float *identities = malloc((size_t)BAND_NROWS * NROWS * sizeof(float));
+    if (expected == NULL || identities == NULL)
+        return 1;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    compute_rows_bytewise(records, 0, BAND_NROWS, expected);
+    double t_bytewise = elapsed_since(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    IdentityCodes codes;
+    if (identity_encode(&codes, records, NROWS) != 0)
+        return 1;
+    double t_encode = elapsed_since(&start);
+
+    double mpairs = (double)BAND_NROWS * NROWS / 1e6;
+    printf("%d x %d residues; %d rows against all; encoded in %.3f s\n", NROWS, NCOLS, BAND_NROWS, t_encode);
+    printf("bytewise            %8.2f Mpairs/s\n", mpairs / t_bytewise);
+    long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+    double t_one = 0;
+    for (unsigned int nthreads = 1; nthreads <= (nprocs > 0 ? nprocs : 1); nthreads *= 2)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (identity_compute_rows(&codes, 0, BAND_NROWS, identities, nthreads) != 0)
+            return 1;
+        double t = elapsed_since(&start);
+        if (nthreads == 1)
+            t_one = t;
+        for (size_t k = 0; k < (size_t)BAND_NROWS * NROWS; k++)
+        {
+            if (fabsf(identities[k] - expected[k]) > 1e-3f)
+            {
+                fprintf(stderr, "Identities disagree\n");
+                return 1;
+            }
+        }
+        printf("planes, %2u threads %8.2f Mpairs/s  (%.2fx bytewise, %.2fx one thread)\n", nthreads, mpairs / t,
+               t_bytewise / t, t_one / t);
+    }
+
+    identity_free(&codes);
+    for (size_t i = 0; i < NROWS; i++)
+        free(records[i].seq);
+    free(records);
+    free(expected);
+    free(identities);
+    return 0;
+}
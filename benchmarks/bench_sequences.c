@@ -0,0 +1,121 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sequences.h"
+
+/*
+ * Throughput of single-pass type inference against the previous two-pass inference
+ */
+
+#define NRECORDS 100000
+#define SEQ_LEN 300
+#define NREPEATS 3
+
+// Previous inference, kept as a reference
+int two_pass_infer_seq_type(SeqRecord *record)
+{
+    int is_nucleic = sequences_is_nucleic(record);
+    int is_protein = sequences_is_protein(record);
+    if ((is_nucleic == 1) && (is_protein == 1))
+        record->type = SEQ_TYPE_INDETERMINATE;
+    else if (is_nucleic == 1)
+        record->type = SEQ_TYPE_NUCLEIC;
+    else if (is_protein == 1)
+        record->type = SEQ_TYPE_PROTEIN;
+    else if ((is_nucleic == -1) || (is_protein == -1))
+    {
+        record->type = SEQ_TYPE_ERROR;
+        return 2;
+    }
+    else
+    {
+        record->type = SEQ_TYPE_UNKNOWN;
+        return 1;
+    }
+    return 0;
+}
+
+SeqRecord *make_records(const char *syms, unsigned int nsyms)
+{
+    SeqRecord *records = malloc(NRECORDS * sizeof(SeqRecord));
+    char *seqs = malloc((size_t)NRECORDS * SEQ_LEN);
+    if (records == NULL || seqs == NULL)
+    {
+        free(records);
+        free(seqs);
+        return NULL;
+    }
+    uint32_t x = 1;
+    for (size_t i = 0; i < (size_t)NRECORDS * SEQ_LEN; i++)
+    {
+        x = 1664525 * x + 1013904223;
+        seqs[i] = syms[(x >> 16) % nsyms];
+    }
+    for (int i = 0; i < NRECORDS; i++)
+        records[i] = (SeqRecord){.seq = seqs + (size_t)i * SEQ_LEN, .len = SEQ_LEN, .span = SEQ_LEN};
+    return records;
+}
+
+double best_time(int (*infer)(SeqRecord *), SeqRecord *records, size_t counts[SEQ_TYPE_ERROR + 1])
+{
+    double best = -1;
+    for (int i = 0; i < NREPEATS; i++)
+    {
+        for (int j = 0; j <= SEQ_TYPE_ERROR; j++)
+            counts[j] = 0;
+        struct timespec start, stop;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int j = 0; j < NRECORDS; j++)
+        {
+            infer(records + j);
+            counts[records[j].type]++;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        double elapsed = (stop.tv_sec - start.tv_sec) + 1e-9 * (stop.tv_nsec - start.tv_nsec);
+        if (best < 0 || elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+int main(void)
+{
+    struct
+    {
+        char *name;
+        char *syms;
+    } inputs[] = {{"protein", "ACDEFGHIKLMNPQRSTVWY-"}, {"nucleic", "ACGT-"}};
+
+    if (sequences_init_base_alphabets() != 0)
+        return 1;
+    for (unsigned int i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
+    {
+        SeqRecord *records = make_records(inputs[i].syms, strlen(inputs[i].syms));
+        if (records == NULL)
+        {
+            fprintf(stderr, "Failed to create records\n");
+            return 1;
+        }
+        double mbytes = (double)NRECORDS * SEQ_LEN / 1e6;
+
+        size_t counts_1[SEQ_TYPE_ERROR + 1], counts_2[SEQ_TYPE_ERROR + 1];
+        double t_two_pass = best_time(&two_pass_infer_seq_type, records, counts_1);
+        double t_single_pass = best_time(&sequences_infer_seq_type, records, counts_2);
+        for (int j = 0; j <= SEQ_TYPE_ERROR; j++)
+        {
+            if (counts_1[j] != counts_2[j])
+            {
+                fprintf(stderr, "%s: Inferences disagree\n", inputs[i].name);
+                return 1;
+            }
+        }
+        printf("%-8s %7.1f MB  two-pass %8.1f MB/s  single-pass %8.1f MB/s  (%.2fx)\n",
+               inputs[i].name, mbytes, mbytes / t_two_pass, mbytes / t_single_pass, t_two_pass / t_single_pass);
+        free(records[0].seq);
+        free(records);
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sequences.h"
+#include "tiles.h"
+
+/*
+ * Column statistics over row-major records against column-major tiles
+ */
+
+#define NROWS 8192 // Whole bands, so tiles have no padding to count
+#define NCOLS 8192
+#define NCLASSES 8
+#define NREPEATS 3
+
+unsigned char classes[256];
+
+// Column-at-a-time counts striding across separately allocated rows, as column analytics would without tiles
+void count_rows_by_column(SeqRecord *records, uint32_t *counts)
+{
+    for (size_t j = 0; j < NCOLS; j++)
+    {
+        uint32_t *column_counts = counts + j * NCLASSES;
+        for (size_t i = 0; i < NROWS; i++)
+            column_counts[classes[(unsigned char)records[i].seq[j]]]++;
+    }
+}
+
+// Row-at-a-time counts, which read rows in order but scatter across all columns' counts
+void count_rows_by_row(SeqRecord *records, uint32_t *counts)
+{
+    for (size_t i = 0; i < NROWS; i++)
+    {
+        const unsigned char *seq = (const unsigned char *)records[i].seq;
+        for (size_t j = 0; j < NCOLS; j++)
+            counts[j * NCLASSES + classes[seq[j]]]++;
+    }
+}
+
+double best_time(void (*count)(void *, uint32_t *), void *data, uint32_t *counts)
+{
+    double best = -1;
+    for (int i = 0; i < NREPEATS; i++)
+    {
+        memset(counts, 0, (size_t)NCOLS * NCLASSES * sizeof(uint32_t));
+        struct timespec start, stop;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        count(data, counts);
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        double elapsed = (stop.tv_sec - start.tv_sec) + 1e-9 * (stop.tv_nsec - start.tv_nsec);
+        if (best < 0 || elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+void count_by_column(void *data, uint32_t *counts)
+{
+    count_rows_by_column(data, counts);
+}
+
+void count_by_row(void *data, uint32_t *counts)
+{
+    count_rows_by_row(data, counts);
+}
+
+void count_tiles(void *data, uint32_t *counts)
+{
+    tiles_count_columns(data, 0, NCOLS, classes, NCLASSES, counts);
+}
+
+int main(void)
+{
+    if (sequences_init_base_alphabets() != 0)
+        return 1;
+    const char *syms = "ACGT-";
+    for (unsigned int i = 0; syms[i] != '\0'; i++)
+        classes[(unsigned char)syms[i]] = i + 1; // Zero is padding
+
+    SeqRecord *records = malloc(NROWS * sizeof(SeqRecord));
+    if (records == NULL)
+        return 1;
+    uint32_t x = 1;
+    for (size_t i = 0; i < NROWS; i++)
+    {
+        char *seq = malloc(NCOLS);
+        if (seq == NULL)
+            return 1;
+        for (size_t j = 0; j < NCOLS; j++)
+        {
+            x = 1664525 * x + 1013904223;
+            seq[j] = syms[(x >> 16) % 5];
+        }
+        records[i] = (SeqRecord){.seq = seq, .len = NCOLS, .span = NCOLS, .type = SEQ_TYPE_NUCLEIC};
+    }
+
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    Tiles tiles;
+    if (tiles_init(&tiles, NROWS, NCOLS) != 0)
+        return 1;
+    for (size_t band = 0; band < tiles.nbands; band++)
+        for (size_t tile_col = 0; tile_col < tiles.ntile_cols; tile_col++)
+            tiles_fill_tile(&tiles, band, tile_col, records + band * TILES_NROWS);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    double t_fill = (stop.tv_sec - start.tv_sec) + 1e-9 * (stop.tv_nsec - start.tv_nsec);
+
+    uint32_t *counts_1 = malloc((size_t)NCOLS * NCLASSES * sizeof(uint32_t));
+    uint32_t *counts_2 = malloc((size_t)NCOLS * NCLASSES * sizeof(uint32_t));
+    uint32_t *counts_3 = malloc((size_t)NCOLS * NCLASSES * sizeof(uint32_t));
+    if (counts_1 == NULL || counts_2 == NULL || counts_3 == NULL)
+        return 1;
+    double t_column = best_time(&count_by_column, records, counts_1);
+    double t_row = best_time(&count_by_row, records, counts_2);
+    double t_tiles = best_time(&count_tiles, &tiles, counts_3);
+    if (memcmp(counts_1, counts_2, (size_t)NCOLS * NCLASSES * sizeof(uint32_t)) != 0 ||
+        memcmp(counts_1, counts_3, (size_t)NCOLS * NCLASSES * sizeof(uint32_t)) != 0)
+    {
+        fprintf(stderr, "Counts disagree\n");
+        return 1;
+    }
+
+    double mcells = (double)NROWS * NCOLS / 1e6;
+    printf("%zu x %zu cells; tiles filled in %.3f s\n", (size_t)NROWS, (size_t)NCOLS, t_fill);
+    printf("rows by column %8.1f Mcells/s\n", mcells / t_column);
+    printf("rows by row    %8.1f Mcells/s\n", mcells / t_row);
+    printf("tiles          %8.1f Mcells/s  (%.2fx by column, %.2fx by row)\n", mcells / t_tiles, t_column / t_tiles,
+           t_row / t_tiles);
+
+    tiles_free(&tiles);
+    for (size_t i = 0; i < NROWS; i++)
+        free(records[i].seq);
+    free(records);
+    free(counts_1);
+    free(counts_2);
+    free(counts_3);
+    return 0;
+}
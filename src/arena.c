@@ -0,0 +1,105 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+#define DEFAULT_BLOCK_SIZE (1 << 20)
+
+struct ArenaBlock
+{
+    ArenaBlock *next;
+    size_t capacity;
+    size_t len;
+    char data[];
+};
+
+void arena_init(Arena *arena, size_t block_size)
+{
+    arena->head = NULL;
+    arena->block_size = block_size;
+}
+
+void arena_free(Arena *arena)
+{
+    if (arena == NULL)
+        return;
+    ArenaBlock *block = arena->head;
+    while (block != NULL)
+    {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+    ArenaBlock *head = arena->head;
+    if (head != NULL && size <= head->capacity - head->len)
+    {
+        void *ptr = head->data + head->len;
+        head->len += size;
+        return ptr;
+    }
+
+    // Allocate new block
+    size_t block_size = arena->block_size > 0 ? arena->block_size : DEFAULT_BLOCK_SIZE; // Zeroed arenas are valid
+    size_t capacity = size > block_size ? size : block_size;
+    if (capacity > SIZE_MAX - sizeof(ArenaBlock))
+        return NULL;
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + capacity);
+    if (block == NULL)
+        return NULL;
+    block->capacity = capacity;
+    block->len = size;
+
+    // Oversized blocks are full, so they go behind the head to keep its remaining space in use
+    if (head != NULL && capacity == size && head->capacity - head->len > 0)
+    {
+        block->next = head->next;
+        head->next = block;
+    }
+    else
+    {
+        block->next = head;
+        arena->head = block;
+    }
+    return block->data;
+}
+
+void *arena_shrink(Arena *arena, void *ptr, size_t size)
+{
+    // Shrinks the latest allocation to size bytes, returning it; allocations starting their block may move
+    ArenaBlock **link = &arena->head;
+    ArenaBlock *block = arena->head;
+    if (block != NULL && block->next != NULL && (char *)ptr == block->next->data &&
+        block->next->len == block->next->capacity)
+    {
+        link = &block->next; // Oversized allocations go behind the head
+        block = block->next;
+    }
+    if (block == NULL || (char *)ptr < block->data || (char *)ptr > block->data + block->len ||
+        size > (size_t)(block->data + block->len - (char *)ptr))
+        return ptr;
+    block->len = (char *)ptr - block->data + size;
+    if ((char *)ptr != block->data || size >= block->capacity / 2) // Smaller shrinks leave space for later allocations
+        return ptr;
+
+    // Return most of a block to the system if it only holds this allocation
+    ArenaBlock *new_block = realloc(block, sizeof(ArenaBlock) + size);
+    if (new_block == NULL)
+        return ptr;
+    new_block->capacity = size;
+    *link = new_block;
+
+    // Full blocks go behind the head if it has space left, as with oversized allocations
+    ArenaBlock *next = new_block->next;
+    if (link == &arena->head && next != NULL && next->len < next->capacity)
+    {
+        new_block->next = next->next;
+        next->next = new_block;
+        arena->head = next;
+    }
+    return new_block->data;
+}
@@ -0,0 +1,26 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+/*
+ * Arena allocators
+ *
+ * Arenas hand out bytes from large blocks and release them all at once. Allocations are not aligned, so they should
+ * only hold character data.
+ */
+
+#include <stddef.h>
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct
+{
+    ArenaBlock *head;  // Block currently being filled; null until the first allocation
+    size_t block_size; // Capacity of new blocks; larger allocations get a block of their own
+} Arena;
+
+void arena_init(Arena *arena, size_t block_size);
+void arena_free(Arena *arena);
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_shrink(Arena *arena, void *ptr, size_t size);
+
+#endif // ARENA_H
@@ -1,3 +1,6 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "array.h"
@@ -14,7 +17,9 @@ int parse_options(int argc, char *argv[],
                   unsigned int n_type_options, SeqTypeOption *type_options,
                   const char *short_options, const struct option *long_options,
                   unsigned int *n_format_args, char ***format_args_ptr,
-                  unsigned int *n_type_args, char ***type_args_ptr)
+                  unsigned int *n_type_args, char ***type_args_ptr,
+                  bool *write_index, bool *write_cache, unsigned int *njobs, bool *follow, bool *pack,
+                  bool *profile, char **identity_path, bool *frame_stats)
 {
     while (1)
     {
@@ -33,7 +38,13 @@ int parse_options(int argc, char *argv[],
         const char *name = "";
         if (option_index != -1)
             name = options[option_index].long_name;
-        if (c == 'f' || strcmp(name, "format") == 0)
+        if (strcmp(name, "cache") == 0)
+            *write_cache = true;
+        else if (strcmp(name, "follow") == 0)
+            *follow = true;
+        else if (strcmp(name, "frame-stats") == 0)
+            *frame_stats = true;
+        else if (c == 'f' || strcmp(name, "format") == 0)
         {
             ssize_t code = str_split(format_args_ptr, argv[optind - 1], ',');
             if (code < 0)
@@ -53,6 +64,22 @@ int parse_options(int argc, char *argv[],
             print_long_help(noptions, options);
             return 1;
         }
+        else if (strcmp(name, "identity") == 0)
+            *identity_path = argv[optind - 1];
+        else if (strcmp(name, "index") == 0)
+            *write_index = true;
+        else if (c == 'j' || strcmp(name, "jobs") == 0)
+        {
+            char *end;
+            errno = 0;
+            long value = strtol(argv[optind - 1], &end, 10);
+            if (errno != 0 || end == argv[optind - 1] || *end != '\0' || value < 1 || value > UINT_MAX)
+            {
+                error_printf("%s: %s: Invalid number of jobs\n", INVOCATION_NAME, argv[optind - 1]);
+                return 2;
+            }
+            *njobs = value;
+        }
         else if (strcmp(name, "list-formats") == 0)
         {
             printf("Format\tExtensions\n");
@@ -73,6 +100,10 @@ int parse_options(int argc, char *argv[],
             }
             return 1;
         }
+        else if (strcmp(name, "pack") == 0)
+            *pack = true;
+        else if (strcmp(name, "profile") == 0)
+            *profile = true;
         else if (c == 't' || strcmp(name, "type") == 0)
         {
             ssize_t code = str_split(type_args_ptr, argv[optind - 1], ',');
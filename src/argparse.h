@@ -9,6 +9,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+#include "fasta.h"
 #include "sequences.h"
 
 typedef enum
@@ -33,7 +34,14 @@ typedef struct
 {
     const char *name;
     const char *exts;
-    int (*reader)(FILE *, SeqRecord **);
+    int (*reader)(FILE *, Arena *, SeqRecord **);
+    int (*record_reader)(FILE *, Arena *, SeqRecordCallback, void *); // Optional reader passing records as they are parsed
+    int (*mapped_reader)(int, FastaMap *, SeqRecord **); // Optional zero-copy reader for regular files
+    int (*compressed_reader)(int, FastaMap *, SeqRecord **); // Optional reader for gzip-compressed regular files
+    int (*indexed_reader)(const char *, int, FastaMap *, SeqRecord **);
+    int (*compressed_indexed_reader)(const char *, int, FastaMap *, SeqRecord **);
+    int (*index_writer)(const char *, const FastaMap *, SeqRecord *, const size_t);
+    const char *index_ext;
 } FormatOption;
 
 typedef struct
@@ -51,7 +59,9 @@ int parse_options(int argc, char *argv[],
                   unsigned int n_type_options, SeqTypeOption *type_options,
                   const char *short_options, const struct option *long_options,
                   unsigned int *n_format_args, char ***format_args_ptr,
-                  unsigned int *n_type_args, char ***type_args_ptr);
+                  unsigned int *n_type_args, char ***type_args_ptr,
+                  bool *write_index, bool *write_cache, unsigned int *njobs, bool *follow, bool *pack,
+                  bool *profile, char **identity_path, bool *frame_stats);
 int prepare_options(unsigned int noptions, Option *options,
                     char **short_options_ptr, struct option *long_options);
 
@@ -20,6 +20,7 @@ int array_init(Array *array, size_t size);
 void array_free(Array *array);
 int array_append(Array *array, const void *value);
 int array_extend(Array *array, const void *values, size_t len);
+int array_reserve(Array *array, size_t capacity);
 void *array_get(Array *array, size_t index);
 int array_shrink(Array *array);
 
@@ -0,0 +1,471 @@
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+
+#include "array.h"
+#include "bgzf.h"
+
+const int BGZF_ERROR_INVALID_FORMAT = -1;
+const int BGZF_ERROR_FILE_IO = -2;
+const int BGZF_ERROR_MEMORY_ALLOCATION = -3;
+const int BGZF_ERROR_INVALID_INDEX = -4;
+
+#define HEADER_LEN 12 // Fixed fields preceding extra subfields
+#define FOOTER_LEN 8  // CRC32 and ISIZE
+#define MAX_BLOCK_LEN 65536
+
+typedef struct
+{
+    Bgzf *bgzf;
+    char *data;
+    size_t begin; // Index of first block in range
+    size_t stop;  // Index of first block in next range
+    int code;
+} BlockRange;
+
+static uint32_t read_le16(const unsigned char *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8;
+}
+
+static uint32_t read_le32(const unsigned char *p)
+{
+    return read_le16(p) | read_le16(p + 2) << 16;
+}
+
+static uint64_t read_le64(const unsigned char *p)
+{
+    return (uint64_t)read_le32(p) | (uint64_t)read_le32(p + 4) << 32;
+}
+
+static void write_le64(unsigned char *p, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = (value >> (8 * i)) & 0xff;
+}
+
+static size_t parse_block_size(const unsigned char *p, size_t len)
+{
+    // Returns size of the BGZF block at p, including header and footer, or 0 if p doesn't start a block
+    if (len < HEADER_LEN || !bgzf_is_gzip(p, len) || p[2] != Z_DEFLATED || !(p[3] & 4)) // 4 flags extra field
+        return 0;
+    size_t xlen = read_le16(p + 10);
+    if (HEADER_LEN + xlen > len)
+        return 0;
+
+    // Find BC subfield, which holds the block size minus 1
+    const unsigned char *x = p + HEADER_LEN;
+    const unsigned char *x_end = x + xlen;
+    while (x + 4 <= x_end)
+    {
+        size_t slen = read_le16(x + 2);
+        if (x[0] == 'B' && x[1] == 'C' && slen == 2 && x + 6 <= x_end)
+        {
+            size_t bsize = read_le16(x + 4) + 1;
+            if (bsize < HEADER_LEN + xlen + FOOTER_LEN || bsize > len)
+                return 0;
+            return bsize;
+        }
+        x += 4 + slen;
+    }
+    return 0;
+}
+
+bool bgzf_is_gzip(const unsigned char *data, size_t len)
+{
+    return len >= 2 && data[0] == 0x1f && data[1] == 0x8b;
+}
+
+bool bgzf_is_bgzf(const unsigned char *data, size_t len)
+{
+    return parse_block_size(data, len) != 0;
+}
+
+static int read_index(const char *index_path, const struct stat *sb, Array *blocks)
+{
+    // Reads block starts after the first as pairs of compressed and uncompressed offsets; the first block is implicit
+    struct stat index_sb;
+    if (stat(index_path, &index_sb) != 0)
+        return BGZF_ERROR_FILE_IO;
+    if (index_sb.st_mtime < sb->st_mtime)
+        return BGZF_ERROR_INVALID_INDEX;
+    FILE *fp = fopen(index_path, "rb");
+    if (fp == NULL)
+        return BGZF_ERROR_FILE_IO;
+
+    int code = 0;
+    unsigned char buffer[16];
+    if (fread(buffer, 1, 8, fp) != 8)
+    {
+        code = BGZF_ERROR_INVALID_INDEX;
+        goto cleanup;
+    }
+    uint64_t nentries = read_le64(buffer);
+    BgzfBlock block = {.coffset = 0, .uoffset = 0, .usize = 0};
+    if (array_append(blocks, &block) != 0)
+    {
+        code = BGZF_ERROR_MEMORY_ALLOCATION;
+        goto cleanup;
+    }
+    for (uint64_t i = 0; i < nentries; i++)
+    {
+        if (fread(buffer, 1, 16, fp) != 16)
+        {
+            code = BGZF_ERROR_INVALID_INDEX;
+            goto cleanup;
+        }
+        uint64_t coffset = read_le64(buffer);
+        uint64_t uoffset = read_le64(buffer + 8);
+        BgzfBlock *last = array_get(blocks, blocks->len - 1);
+        if (coffset <= last->coffset || uoffset < last->uoffset || coffset >= (uint64_t)sb->st_size ||
+            uoffset - last->uoffset > MAX_BLOCK_LEN)
+        {
+            code = BGZF_ERROR_INVALID_INDEX;
+            goto cleanup;
+        }
+        last->usize = uoffset - last->uoffset;
+        block.coffset = coffset;
+        block.uoffset = uoffset;
+        if (array_append(blocks, &block) != 0)
+        {
+            code = BGZF_ERROR_MEMORY_ALLOCATION;
+            goto cleanup;
+        }
+    }
+
+cleanup:
+    fclose(fp);
+    return code;
+}
+
+int bgzf_open(Bgzf *bgzf, int fd, const char *index_path)
+{
+    bgzf->cdata = NULL;
+    bgzf->clen = 0;
+    bgzf->blocks = NULL;
+    bgzf->nblocks = 0;
+    bgzf->ulen = 0;
+    bgzf->inflated = NULL;
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode))
+        return BGZF_ERROR_FILE_IO;
+    if (sb.st_size == 0)
+        return BGZF_ERROR_INVALID_FORMAT;
+    if ((uintmax_t)sb.st_size > SIZE_MAX)
+        return BGZF_ERROR_MEMORY_ALLOCATION;
+    size_t clen = sb.st_size;
+    unsigned char *cdata = mmap(NULL, clen, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (cdata == MAP_FAILED)
+        return BGZF_ERROR_FILE_IO;
+    bgzf->cdata = cdata;
+    bgzf->clen = clen;
+    if (!bgzf_is_bgzf(cdata, clen))
+    {
+        bgzf_close(bgzf);
+        return BGZF_ERROR_INVALID_FORMAT;
+    }
+
+    Array blocks;
+    if (array_init(&blocks, sizeof(BgzfBlock)) != 0)
+    {
+        bgzf_close(bgzf);
+        return BGZF_ERROR_MEMORY_ALLOCATION;
+    }
+
+    // Blocks in a fresh index are used as is; blocks after its last entry are found by scanning headers
+    int code = 0;
+    if (index_path != NULL && read_index(index_path, &sb, &blocks) != 0)
+        blocks.len = 0;
+    size_t coffset = 0, uoffset = 0;
+    if (blocks.len > 0)
+    {
+        BgzfBlock *last = array_get(&blocks, blocks.len - 1);
+        coffset = last->coffset;
+        uoffset = last->uoffset;
+        blocks.len--;
+    }
+    while (coffset < clen)
+    {
+        size_t bsize = parse_block_size(cdata + coffset, clen - coffset);
+        if (bsize == 0)
+        {
+            code = BGZF_ERROR_INVALID_FORMAT;
+            goto error;
+        }
+        BgzfBlock block = {.coffset = coffset, .uoffset = uoffset, .usize = read_le32(cdata + coffset + bsize - 4)};
+        if (block.usize > MAX_BLOCK_LEN)
+        {
+            code = BGZF_ERROR_INVALID_FORMAT;
+            goto error;
+        }
+        if (block.usize > 0 && array_append(&blocks, &block) != 0) // Empty blocks, like the EOF marker, hold no data
+        {
+            code = BGZF_ERROR_MEMORY_ALLOCATION;
+            goto error;
+        }
+        coffset += bsize;
+        uoffset += block.usize;
+    }
+
+    bgzf->inflated = calloc(blocks.len > 0 ? blocks.len : 1, sizeof(bool));
+    if (bgzf->inflated == NULL)
+    {
+        code = BGZF_ERROR_MEMORY_ALLOCATION;
+        goto error;
+    }
+    array_shrink(&blocks); // Failure only leaves excess capacity
+    bgzf->blocks = blocks.data;
+    bgzf->nblocks = blocks.len;
+    bgzf->ulen = uoffset;
+    return 0;
+
+error:
+    array_free(&blocks);
+    bgzf_close(bgzf);
+    return code;
+}
+
+void bgzf_close(Bgzf *bgzf)
+{
+    if (bgzf->cdata != NULL)
+        munmap(bgzf->cdata, bgzf->clen);
+    free(bgzf->blocks);
+    free(bgzf->inflated);
+    bgzf->cdata = NULL;
+    bgzf->clen = 0;
+    bgzf->blocks = NULL;
+    bgzf->nblocks = 0;
+    bgzf->ulen = 0;
+    bgzf->inflated = NULL;
+}
+
+static int inflate_block(const Bgzf *bgzf, const BgzfBlock *block, char *data)
+{
+    const unsigned char *p = bgzf->cdata + block->coffset;
+    size_t bsize = parse_block_size(p, bgzf->clen - block->coffset);
+    if (bsize == 0)
+        return BGZF_ERROR_INVALID_FORMAT;
+    size_t xlen = read_le16(p + 10);
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) // Raw deflate data since the header is parsed here
+        return BGZF_ERROR_MEMORY_ALLOCATION;
+    stream.next_in = (unsigned char *)p + HEADER_LEN + xlen;
+    stream.avail_in = bsize - HEADER_LEN - xlen - FOOTER_LEN;
+    stream.next_out = (unsigned char *)data + block->uoffset;
+    stream.avail_out = block->usize;
+    int ret = inflate(&stream, Z_FINISH);
+    size_t written = block->usize - stream.avail_out;
+    inflateEnd(&stream);
+
+    if (ret != Z_STREAM_END || written != block->usize || read_le32(p + bsize - 4) != block->usize)
+        return BGZF_ERROR_INVALID_FORMAT;
+    uLong crc = crc32(crc32(0L, Z_NULL, 0), (unsigned char *)data + block->uoffset, block->usize);
+    if (crc != read_le32(p + bsize - 8))
+        return BGZF_ERROR_INVALID_FORMAT;
+    return 0;
+}
+
+static void *inflate_block_range(void *arg)
+{
+    BlockRange *range = arg;
+    range->code = 0;
+    for (size_t i = range->begin; i < range->stop; i++)
+    {
+        int code = inflate_block(range->bgzf, range->bgzf->blocks + i, range->data);
+        if (code != 0)
+        {
+            range->code = code;
+            break;
+        }
+    }
+    return NULL;
+}
+
+int bgzf_inflate_all(Bgzf *bgzf, char *data, unsigned int nthreads)
+{
+    if (nthreads == 0)
+        nthreads = 1;
+    if (nthreads > bgzf->nblocks)
+        nthreads = bgzf->nblocks > 0 ? bgzf->nblocks : 1;
+    BlockRange *ranges = malloc(nthreads * sizeof(BlockRange));
+    pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+    bool *started = calloc(nthreads, sizeof(bool));
+    if (ranges == NULL || threads == NULL || started == NULL)
+    {
+        free(ranges);
+        free(threads);
+        free(started);
+        return BGZF_ERROR_MEMORY_ALLOCATION;
+    }
+
+    // Split blocks evenly; the first range is inflated on this thread
+    for (unsigned int i = 0; i < nthreads; i++)
+    {
+        BlockRange *range = ranges + i;
+        range->bgzf = bgzf;
+        range->data = data;
+        range->begin = bgzf->nblocks / nthreads * i;
+        range->stop = (i + 1 < nthreads) ? bgzf->nblocks / nthreads * (i + 1) : bgzf->nblocks;
+    }
+    for (unsigned int i = 1; i < nthreads; i++)
+        started[i] = pthread_create(threads + i, NULL, &inflate_block_range, ranges + i) == 0;
+    inflate_block_range(ranges);
+    int code = 0;
+    for (unsigned int i = 0; i < nthreads; i++)
+    {
+        if (i > 0 && started[i])
+            pthread_join(threads[i], NULL);
+        else if (i > 0)
+            inflate_block_range(ranges + i); // Fall back to inflating serially
+        if (code == 0)
+            code = ranges[i].code;
+    }
+    if (code == 0)
+        memset(bgzf->inflated, true, bgzf->nblocks * sizeof(bool));
+
+    free(ranges);
+    free(threads);
+    free(started);
+    return code;
+}
+
+int bgzf_inflate_range(Bgzf *bgzf, char *data, size_t offset, size_t len)
+{
+    if (offset >= bgzf->ulen || len == 0)
+        return 0;
+
+    // Find first block ending after offset
+    size_t lo = 0, hi = bgzf->nblocks;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        BgzfBlock *block = bgzf->blocks + mid;
+        if (block->uoffset + block->usize <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    size_t stop = (len > bgzf->ulen - offset) ? bgzf->ulen : offset + len;
+    for (size_t i = lo; i < bgzf->nblocks && bgzf->blocks[i].uoffset < stop; i++)
+    {
+        if (bgzf->inflated[i])
+            continue;
+        int code = inflate_block(bgzf, bgzf->blocks + i, data);
+        if (code != 0)
+            return code;
+        bgzf->inflated[i] = true;
+    }
+    return 0;
+}
+
+int bgzf_index_write(const Bgzf *bgzf, const char *index_path)
+{
+    FILE *fp = fopen(index_path, "wb");
+    if (fp == NULL)
+        return BGZF_ERROR_FILE_IO;
+
+    int code = 0;
+    unsigned char buffer[16];
+    write_le64(buffer, bgzf->nblocks > 0 ? bgzf->nblocks - 1 : 0);
+    if (fwrite(buffer, 1, 8, fp) != 8)
+        code = BGZF_ERROR_FILE_IO;
+    for (size_t i = 1; i < bgzf->nblocks && code == 0; i++)
+    {
+        write_le64(buffer, bgzf->blocks[i].coffset);
+        write_le64(buffer + 8, bgzf->blocks[i].uoffset);
+        if (fwrite(buffer, 1, 16, fp) != 16)
+            code = BGZF_ERROR_FILE_IO;
+    }
+    if (fclose(fp) != 0)
+        code = BGZF_ERROR_FILE_IO;
+    return code;
+}
+
+int bgzf_inflate_gzip(const unsigned char *cdata, size_t clen, char **data_ptr, size_t *len_ptr)
+{
+    // Inflates all members of a plain gzip file serially since member boundaries are unknown
+    size_t capacity = MAX_BLOCK_LEN;
+    if (clen >= 4 && read_le32(cdata + clen - 4) > capacity) // Size of last member mod 2^32, so only a hint
+        capacity = read_le32(cdata + clen - 4);
+    char *data = malloc(capacity);
+    if (data == NULL)
+        return BGZF_ERROR_MEMORY_ALLOCATION;
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, MAX_WBITS + 16) != Z_OK) // +16 expects a gzip header
+    {
+        free(data);
+        return BGZF_ERROR_MEMORY_ALLOCATION;
+    }
+
+    int code = 0;
+    size_t consumed = 0, len = 0;
+    while (1)
+    {
+        if (len == capacity)
+        {
+            if (capacity > SIZE_MAX / 2)
+            {
+                code = BGZF_ERROR_MEMORY_ALLOCATION;
+                break;
+            }
+            char *ptr = realloc(data, 2 * capacity);
+            if (ptr == NULL)
+            {
+                code = BGZF_ERROR_MEMORY_ALLOCATION;
+                break;
+            }
+            data = ptr;
+            capacity *= 2;
+        }
+        size_t avail_in = (clen - consumed > UINT_MAX) ? UINT_MAX : clen - consumed;
+        size_t avail_out = (capacity - len > UINT_MAX) ? UINT_MAX : capacity - len;
+        stream.next_in = (unsigned char *)cdata + consumed;
+        stream.avail_in = avail_in;
+        stream.next_out = (unsigned char *)data + len;
+        stream.avail_out = avail_out;
+        int ret = inflate(&stream, Z_NO_FLUSH);
+        consumed += avail_in - stream.avail_in;
+        len += avail_out - stream.avail_out;
+
+        if (ret == Z_STREAM_END)
+        {
+            // Continue into following members; anything else after a member is ignored like gzip does
+            if (!bgzf_is_gzip(cdata + consumed, clen - consumed))
+                break;
+            inflateReset(&stream);
+        }
+        else if (ret == Z_BUF_ERROR && consumed == clen) // Truncated member
+        {
+            code = BGZF_ERROR_INVALID_FORMAT;
+            break;
+        }
+        else if (ret != Z_OK && ret != Z_BUF_ERROR)
+        {
+            code = (ret == Z_MEM_ERROR) ? BGZF_ERROR_MEMORY_ALLOCATION : BGZF_ERROR_INVALID_FORMAT;
+            break;
+        }
+    }
+    inflateEnd(&stream);
+
+    if (code != 0)
+    {
+        free(data);
+        return code;
+    }
+    *data_ptr = data;
+    *len_ptr = len;
+    return 0;
+}
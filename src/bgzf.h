@@ -0,0 +1,47 @@
+#ifndef BGZF_H
+#define BGZF_H
+
+/*
+ * Gzip and BGZF decompression
+ *
+ * BGZF files are series of independently compressed gzip blocks, so blocks can be inflated in parallel or on demand at
+ * their offsets in the uncompressed data.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define BGZF_INDEX_EXT ".gzi"
+
+typedef struct
+{
+    size_t coffset; // Offset of block in compressed file
+    size_t uoffset; // Offset of block's data in uncompressed data
+    size_t usize;   // Size of block's data
+} BgzfBlock;
+
+typedef struct
+{
+    unsigned char *cdata; // Mapped compressed file
+    size_t clen;
+    BgzfBlock *blocks;
+    size_t nblocks;
+    size_t ulen;
+    bool *inflated; // Blocks already written to uncompressed data
+} Bgzf;
+
+extern const int BGZF_ERROR_INVALID_FORMAT;
+extern const int BGZF_ERROR_FILE_IO;
+extern const int BGZF_ERROR_MEMORY_ALLOCATION;
+extern const int BGZF_ERROR_INVALID_INDEX;
+
+bool bgzf_is_gzip(const unsigned char *data, size_t len);
+bool bgzf_is_bgzf(const unsigned char *data, size_t len);
+int bgzf_open(Bgzf *bgzf, int fd, const char *index_path);
+void bgzf_close(Bgzf *bgzf);
+int bgzf_inflate_all(Bgzf *bgzf, char *data, unsigned int nthreads);
+int bgzf_inflate_range(Bgzf *bgzf, char *data, size_t offset, size_t len);
+int bgzf_index_write(const Bgzf *bgzf, const char *index_path);
+int bgzf_inflate_gzip(const unsigned char *cdata, size_t clen, char **data_ptr, size_t *len_ptr);
+
+#endif // BGZF_H
@@ -0,0 +1,376 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "fasta.h"
+#include "sequences.h"
+
+const int CACHE_ERROR_INVALID_FORMAT = -1;
+const int CACHE_ERROR_FILE_IO = -2;
+const int CACHE_ERROR_MEMORY_ALLOCATION = -3;
+const int CACHE_ERROR_STALE = -4;
+
+#define CACHE_MAGIC 0x3243564c41414c41 // Spells "ALAALVC2" in little-endian order; also rejects other byte orders
+#define CACHE_DIR "aalv"
+#define CACHE_EXT ".cache"
+#define WRITE_BUFFER_SIZE (1 << 20)
+
+// All fields are 64-bit, so structs are laid out without padding
+typedef struct
+{
+    uint64_t magic;
+    uint64_t source_size;
+    uint64_t source_mtime;
+    uint64_t forced_type;
+    uint64_t nucleic_tiebreak_len;
+    uint64_t type_sample_len;
+    uint64_t nrecords;
+    uint64_t maxlen;
+    uint64_t nonascii;
+    uint64_t path_len;  // Absolute path of source follows header, padded to 8 bytes
+    uint64_t data_len;  // Headers and residues follow entries
+} CacheHeader;
+
+typedef struct
+{
+    uint64_t header_offset; // Offsets are from start of data
+    uint64_t header_len;
+    uint64_t id_offset;
+    uint64_t id_len;
+    uint64_t seq_offset;
+    uint64_t len;
+    uint64_t type;
+} CacheEntry;
+
+static size_t pad8(size_t len)
+{
+    return (len + 7) & ~(size_t)7;
+}
+
+static uint64_t hash_path(const char *path)
+{
+    // 64-bit FNV-1a
+    uint64_t hash = 0xcbf29ce484222325;
+    for (const unsigned char *p = (const unsigned char *)path; *p != '\0'; p++)
+    {
+        hash ^= *p;
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+static char *get_cache_dir(void)
+{
+    const char *xdg_cache_home = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    const char *base, *suffix;
+    if (xdg_cache_home != NULL && xdg_cache_home[0] == '/') // Relative paths are invalid per the XDG spec
+    {
+        base = xdg_cache_home;
+        suffix = "/" CACHE_DIR;
+    }
+    else if (home != NULL && home[0] != '\0')
+    {
+        base = home;
+        suffix = "/.cache/" CACHE_DIR;
+    }
+    else
+        return NULL;
+
+    size_t base_len = strlen(base);
+    size_t suffix_len = strlen(suffix);
+    char *dir = malloc(base_len + suffix_len + 1);
+    if (dir == NULL)
+        return NULL;
+    memcpy(dir, base, base_len);
+    memcpy(dir + base_len, suffix, suffix_len + 1);
+    return dir;
+}
+
+static int make_dirs(char *dir)
+{
+    // Creates dir and any missing parents; dir is modified while its parents are created
+    for (char *p = dir + 1; *p != '\0'; p++)
+    {
+        if (*p != '/')
+            continue;
+        *p = '\0';
+        int code = mkdir(dir, 0700);
+        *p = '/';
+        if (code != 0 && errno != EEXIST)
+            return CACHE_ERROR_FILE_IO;
+    }
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST)
+        return CACHE_ERROR_FILE_IO;
+    return 0;
+}
+
+char *cache_get_path(const char *file_path)
+{
+    char *abs_path = realpath(file_path, NULL);
+    if (abs_path == NULL)
+        return NULL;
+    char *dir = get_cache_dir();
+    if (dir == NULL)
+    {
+        free(abs_path);
+        return NULL;
+    }
+
+    size_t len = strlen(dir) + 1 + 16 + sizeof(CACHE_EXT);
+    char *cache_path = malloc(len);
+    if (cache_path != NULL)
+        snprintf(cache_path, len, "%s/%016llx%s", dir, (unsigned long long)hash_path(abs_path), CACHE_EXT);
+    free(abs_path);
+    free(dir);
+    return cache_path;
+}
+
+int cache_read(const char *file_path, const struct stat *sb, CacheInfo *info, FastaMap *map, SeqRecord **records_ptr)
+{
+    /* Return codes
+        >0: number of records
+        CACHE_ERROR_STALE: cache was written from a different file, version of the file, or type settings
+        <0: other errors
+    */
+    int code = 0;
+    map->data = NULL;
+    map->len = 0;
+    map->index = NULL;
+    map->bgzf = NULL;
+    map->allocated = false;
+    char *abs_path = realpath(file_path, NULL);
+    char *cache_path = cache_get_path(file_path);
+    if (abs_path == NULL || cache_path == NULL)
+    {
+        free(abs_path);
+        free(cache_path);
+        return CACHE_ERROR_FILE_IO;
+    }
+    int fd = open(cache_path, O_RDONLY);
+    free(cache_path);
+    if (fd == -1)
+    {
+        free(abs_path);
+        return CACHE_ERROR_FILE_IO;
+    }
+    struct stat cache_sb;
+    if (fstat(fd, &cache_sb) != 0 || (uintmax_t)cache_sb.st_size < sizeof(CacheHeader) ||
+        (uintmax_t)cache_sb.st_size > SIZE_MAX)
+    {
+        close(fd);
+        free(abs_path);
+        return CACHE_ERROR_INVALID_FORMAT;
+    }
+    size_t len = cache_sb.st_size;
+    char *data = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // Mapping keeps file open
+    if (data == MAP_FAILED)
+    {
+        free(abs_path);
+        return CACHE_ERROR_FILE_IO;
+    }
+
+    // Check key and layout
+    CacheHeader header;
+    memcpy(&header, data, sizeof(header));
+    size_t abs_path_len = strlen(abs_path);
+    if (header.magic != CACHE_MAGIC)
+    {
+        code = CACHE_ERROR_INVALID_FORMAT;
+        goto error;
+    }
+    if (header.source_size != (uint64_t)sb->st_size || header.source_mtime != (uint64_t)sb->st_mtime ||
+        header.forced_type != info->forced_type ||
+        header.nucleic_tiebreak_len != info->nucleic_tiebreak_len || header.type_sample_len != info->type_sample_len ||
+        header.path_len != abs_path_len ||
+        header.path_len > len - sizeof(header) || memcmp(data + sizeof(header), abs_path, abs_path_len) != 0)
+    {
+        code = CACHE_ERROR_STALE;
+        goto error;
+    }
+    size_t entries_offset = sizeof(header) + pad8(header.path_len);
+    if (header.nrecords == 0 || header.nrecords > INT_MAX || entries_offset > len ||
+        header.nrecords > (len - entries_offset) / sizeof(CacheEntry) ||
+        header.data_len != len - entries_offset - header.nrecords * sizeof(CacheEntry))
+    {
+        code = CACHE_ERROR_INVALID_FORMAT;
+        goto error;
+    }
+
+    // Point records into mapping
+    size_t nrecords = header.nrecords;
+    char *seq_data = data + entries_offset + nrecords * sizeof(CacheEntry);
+    SeqRecord *records = malloc(nrecords * sizeof(SeqRecord));
+    if (records == NULL)
+    {
+        code = CACHE_ERROR_MEMORY_ALLOCATION;
+        goto error;
+    }
+    for (size_t i = 0; i < nrecords; i++)
+    {
+        CacheEntry entry;
+        memcpy(&entry, data + entries_offset + i * sizeof(CacheEntry), sizeof(entry));
+        if (entry.header_offset > header.data_len || entry.header_len > header.data_len - entry.header_offset ||
+            entry.id_offset < entry.header_offset || entry.id_len > entry.header_len ||
+            entry.id_offset - entry.header_offset > entry.header_len - entry.id_len ||
+            entry.seq_offset > header.data_len || entry.len > header.data_len - entry.seq_offset ||
+            entry.type >= SEQ_TYPE_ERROR)
+        {
+            free(records);
+            code = CACHE_ERROR_INVALID_FORMAT;
+            goto error;
+        }
+        // Residues are compacted and unpacked, so records are never modified in the read-only mapping
+        records[i] = (SeqRecord){
+            .header = seq_data + entry.header_offset,
+            .id = seq_data + entry.id_offset,
+            .seq = seq_data + entry.seq_offset,
+            .header_len = entry.header_len,
+            .id_len = entry.id_len,
+            .len = entry.len,
+            .span = entry.len,
+            .type = entry.type,
+        };
+    }
+    free(abs_path);
+
+    map->data = data;
+    map->len = len;
+    info->maxlen = header.maxlen;
+    info->nonascii = header.nonascii != 0;
+    *records_ptr = records;
+    return nrecords;
+
+error:
+    munmap(data, len);
+    free(abs_path);
+    return code;
+}
+
+int cache_write(const char *file_path, const struct stat *sb, const CacheInfo *info,
+                SeqRecord *records, const size_t nrecords)
+{
+    char *abs_path = realpath(file_path, NULL);
+    char *dir = get_cache_dir();
+    char *cache_path = cache_get_path(file_path);
+    char *tmp_path = NULL;
+    FILE *fp = NULL;
+    int code = 0;
+    if (abs_path == NULL || dir == NULL || cache_path == NULL)
+    {
+        code = CACHE_ERROR_FILE_IO;
+        goto cleanup;
+    }
+    if ((code = make_dirs(dir)) != 0)
+        goto cleanup;
+
+    // Write to a temporary file, so other viewers never map a partial cache
+    size_t cache_path_len = strlen(cache_path);
+    tmp_path = malloc(cache_path_len + sizeof(".XXXXXX"));
+    if (tmp_path == NULL)
+    {
+        code = CACHE_ERROR_MEMORY_ALLOCATION;
+        goto cleanup;
+    }
+    memcpy(tmp_path, cache_path, cache_path_len);
+    memcpy(tmp_path + cache_path_len, ".XXXXXX", sizeof(".XXXXXX"));
+    int fd = mkstemp(tmp_path);
+    if (fd == -1 || (fp = fdopen(fd, "wb")) == NULL)
+    {
+        if (fd != -1)
+            close(fd);
+        free(tmp_path);
+        tmp_path = NULL;
+        code = CACHE_ERROR_FILE_IO;
+        goto cleanup;
+    }
+    setvbuf(fp, NULL, _IOFBF, WRITE_BUFFER_SIZE);
+
+    // Header and path
+    uint64_t data_len = 0;
+    for (size_t i = 0; i < nrecords; i++)
+    {
+        SeqRecord *record = records + i;
+        data_len += (record->header != NULL ? record->header_len : record->id_len) + record->len;
+    }
+    CacheHeader header = {
+        .magic = CACHE_MAGIC,
+        .source_size = sb->st_size,
+        .source_mtime = sb->st_mtime,
+        .forced_type = info->forced_type,
+        .nucleic_tiebreak_len = info->nucleic_tiebreak_len,
+        .type_sample_len = info->type_sample_len,
+        .nrecords = nrecords,
+        .maxlen = info->maxlen,
+        .nonascii = info->nonascii,
+        .path_len = strlen(abs_path),
+        .data_len = data_len,
+    };
+    const char padding[8] = {0};
+    fwrite(&header, sizeof(header), 1, fp);
+    fwrite(abs_path, 1, header.path_len, fp);
+    fwrite(padding, 1, pad8(header.path_len) - header.path_len, fp);
+
+    // Entries then data, with each record's header directly followed by its residues
+    uint64_t offset = 0;
+    for (size_t i = 0; i < nrecords; i++)
+    {
+        SeqRecord *record = records + i;
+        CacheEntry entry;
+        entry.header_offset = offset;
+        if (record->header != NULL)
+        {
+            size_t id_len;
+            char *id = fasta_find_id(record->header, record->header_len, &id_len);
+            entry.header_len = record->header_len;
+            entry.id_offset = offset + (id - record->header);
+            entry.id_len = id_len;
+        }
+        else // Unresolved headers from an index
+        {
+            entry.header_len = record->id_len;
+            entry.id_offset = offset;
+            entry.id_len = record->id_len;
+        }
+        entry.seq_offset = offset + entry.header_len;
+        entry.len = record->len;
+        entry.type = record->type;
+        offset = entry.seq_offset + entry.len;
+        fwrite(&entry, sizeof(entry), 1, fp);
+    }
+    for (size_t i = 0; i < nrecords; i++)
+    {
+        SeqRecord *record = records + i;
+        sequences_compact_seq(record);
+        if (record->header != NULL)
+            fwrite(record->header, 1, record->header_len, fp);
+        else
+            fwrite(record->id, 1, record->id_len, fp);
+        fwrite(record->seq, 1, record->len, fp);
+    }
+    if (ferror(fp))
+        code = CACHE_ERROR_FILE_IO;
+    if (fclose(fp) != 0)
+        code = CACHE_ERROR_FILE_IO;
+    if (code == 0 && rename(tmp_path, cache_path) != 0)
+        code = CACHE_ERROR_FILE_IO;
+    if (code != 0)
+        unlink(tmp_path);
+
+cleanup:
+    free(abs_path);
+    free(dir);
+    free(cache_path);
+    free(tmp_path);
+    return code;
+}
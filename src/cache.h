@@ -0,0 +1,38 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+/*
+ * Binary record caches
+ *
+ * A cache holds the headers, compacted residues, and inferred types of a file's records, so re-opening the file maps
+ * the cache rather than parsing and typing the text. Caches live in the user cache directory, are named by a hash of
+ * the file's absolute path, and are only used if the file's size and modification time match the ones they were
+ * written from. They are mapped shared and read-only, so viewers opening the same file share one copy in memory.
+ */
+
+#include <stdbool.h>
+#include <sys/stat.h>
+
+#include "fasta.h"
+#include "sequences.h"
+
+extern const int CACHE_ERROR_INVALID_FORMAT;
+extern const int CACHE_ERROR_FILE_IO;
+extern const int CACHE_ERROR_MEMORY_ALLOCATION;
+extern const int CACHE_ERROR_STALE;
+
+typedef struct
+{
+    SeqType forced_type;         // Types depend on these settings, so they are part of the key
+    size_t nucleic_tiebreak_len;
+    size_t type_sample_len;
+    size_t maxlen;
+    bool nonascii;
+} CacheInfo;
+
+char *cache_get_path(const char *file_path);
+int cache_read(const char *file_path, const struct stat *sb, CacheInfo *info, FastaMap *map, SeqRecord **records_ptr);
+int cache_write(const char *file_path, const struct stat *sb, const CacheInfo *info,
+                SeqRecord *records, const size_t nrecords);
+
+#endif // CACHE_H
@@ -1,7 +1,21 @@
+#include <stdio.h>
 #include <stdlib.h>
 
 #include "color.h"
 
+#define PARAMS_SIZE 9 // Bytes of the longest parameters setting one color, 38;5;255, and a null
+
+const ColorEntry color_default_entry = {
+    .fg = COLOR_DEFAULT,
+    .bg = COLOR_DEFAULT,
+    .sgr_len = sizeof("\x1b[39;49m") - 1,
+    .fg_sgr_len = sizeof("\x1b[39m") - 1,
+    .bg_sgr_len = sizeof("\x1b[49m") - 1,
+    .sgr = "\x1b[39;49m",
+    .fg_sgr = "\x1b[39m",
+    .bg_sgr = "\x1b[49m",
+};
+
 int color_init_color_scheme(ColorScheme *color_scheme, ColorType type, const char *name, unsigned int len)
 {
     if (color_scheme == NULL || name == NULL || len == 0)
@@ -52,6 +66,8 @@ int color_init_color_scheme(ColorScheme *color_scheme, ColorType type, const cha
     }
     color_scheme->mask.fg = fg_mask;
     color_scheme->mask.bg = bg_mask;
+    for (unsigned int i = 0; i < COLOR_TABLE_LEN; i++)
+        color_scheme->table[i] = color_default_entry;
 
     // Union members
     switch (type)
@@ -105,3 +121,57 @@ void color_free_color_scheme(ColorScheme *color_scheme)
         free(color_scheme->map.b8.bg);
     }
 }
+
+static int format_color(char *s, ColorType type, int color, bool foreground)
+{
+    // Formats the parameters of an SGR sequence setting a color
+    if (color == COLOR_DEFAULT)
+        return sprintf(s, foreground ? "39" : "49");
+    if (type == COLOR_8_BIT)
+        return sprintf(s, foreground ? "38;5;%d" : "48;5;%d", color);
+    return sprintf(s, "%d", color);
+}
+
+void color_compile_entry(ColorEntry *entry, ColorType type, int fg, int bg)
+{
+    char fg_params[PARAMS_SIZE], bg_params[PARAMS_SIZE];
+    format_color(fg_params, type, fg, true);
+    format_color(bg_params, type, bg, false);
+    int tag = (type == COLOR_8_BIT) ? COLOR_TAG_8_BIT : COLOR_TAG_4_BIT;
+    entry->fg = (fg == COLOR_DEFAULT) ? COLOR_DEFAULT : (tag | fg);
+    entry->bg = (bg == COLOR_DEFAULT) ? COLOR_DEFAULT : (tag | bg);
+    entry->sgr_len = sprintf(entry->sgr, "\x1b[%s;%sm", fg_params, bg_params);
+    entry->fg_sgr_len = sprintf(entry->fg_sgr, "\x1b[%sm", fg_params);
+    entry->bg_sgr_len = sprintf(entry->bg_sgr, "\x1b[%sm", bg_params);
+}
+
+void color_compile_color_scheme(ColorScheme *color_scheme, const int *index_map)
+{
+    // Compiles an entry for each byte through the index map of the scheme's alphabet, so cases share entries as needed
+    for (unsigned int i = 0; i < COLOR_TABLE_LEN; i++)
+    {
+        int index = index_map[i];
+        if (index < 0 || (unsigned int)index >= color_scheme->len)
+        {
+            color_scheme->table[i] = color_default_entry;
+            continue;
+        }
+        int fg = COLOR_DEFAULT;
+        int bg = COLOR_DEFAULT;
+        if (color_scheme->type == COLOR_4_BIT)
+        {
+            if (color_scheme->mask.fg[index])
+                fg = color_scheme->map.b4.fg[index];
+            if (color_scheme->mask.bg[index])
+                bg = color_scheme->map.b4.bg[index];
+        }
+        else
+        {
+            if (color_scheme->mask.fg[index])
+                fg = color_scheme->map.b8.fg[index];
+            if (color_scheme->mask.bg[index])
+                bg = color_scheme->map.b8.bg[index];
+        }
+        color_compile_entry(color_scheme->table + i, color_scheme->type, fg, bg);
+    }
+}
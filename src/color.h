@@ -3,6 +3,10 @@
 
 /*
  * Color representations
+ *
+ * Schemes are compiled into tables indexed by raw byte, where each entry holds the colors of the symbol and the SGR
+ * sequences that set them, so symbols are colored by lookups alone. Symbols a scheme leaves without a color are shown
+ * in the terminal's default.
  */
 
 #include <stdbool.h>
@@ -11,6 +15,13 @@
 #include "array.h"
 #include "terminal.h"
 
+#define COLOR_DEFAULT -1       // Code of the terminal's default color in compiled entries
+#define COLOR_TAG_4_BIT 0x100  // Tags of codes in compiled entries, so equal codes of different types differ
+#define COLOR_TAG_8_BIT 0x200
+#define COLOR_TABLE_LEN 128    // Entries of compiled tables, one per ASCII byte
+#define COLOR_SGR_SIZE 24      // Bytes of the longest sequence, \x1b[38;5;255;48;5;255m, and a null
+#define COLOR_SGR_PART_SIZE 12 // Bytes of the longest sequence setting one color, \x1b[38;5;255m, and a null
+
 typedef enum
 {
     COLOR_4_BIT,
@@ -41,6 +52,18 @@ typedef union
     ColorMap8Bit b8;
 } ColorMap;
 
+typedef struct
+{
+    int16_t fg; // Color code tagged with its type, or COLOR_DEFAULT
+    int16_t bg;
+    uint8_t sgr_len;
+    uint8_t fg_sgr_len;
+    uint8_t bg_sgr_len;
+    char sgr[COLOR_SGR_SIZE]; // Sets both colors
+    char fg_sgr[COLOR_SGR_PART_SIZE];
+    char bg_sgr[COLOR_SGR_PART_SIZE];
+} ColorEntry;
+
 typedef struct
 {
     const char *name;
@@ -48,9 +71,14 @@ typedef struct
     ColorMap map;
     ColorMask mask;
     unsigned int len;
+    ColorEntry table[COLOR_TABLE_LEN]; // Compiled from the map and mask by color_compile_color_scheme
 } ColorScheme;
 
+extern const ColorEntry color_default_entry;
+
 int color_init_color_scheme(ColorScheme *color_scheme, ColorType type, const char *name, unsigned int len);
 void color_free_color_scheme(ColorScheme *color_scheme);
+void color_compile_entry(ColorEntry *entry, ColorType type, int fg, int bg);
+void color_compile_color_scheme(ColorScheme *color_scheme, const int *index_map);
 
 #endif // COLOR_H
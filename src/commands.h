@@ -36,4 +36,8 @@ typedef enum
     CMD_DECREASE_RULER_PANE_HEIGHT,
     CMD_INCREASE_TICK_SPACING,
     CMD_DECREASE_TICK_SPACING,
+    CMD_TOGGLE_PROFILE,
+    CMD_TOGGLE_DOTS,
+    CMD_TOGGLE_IDENTITIES,
+    CMD_TOGGLE_IDENTITY_SORT,
 } Command;
@@ -1,30 +1,99 @@
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <wchar.h>
 
 #include "color.h"
 #include "display.h"
+#include "identity.h"
+#include "profile.h"
+#include "screen.h"
 #include "state.h"
 #include "terminal.h"
 
 extern State state;
 
+typedef struct
+{
+    const FileState *file;
+    size_t record_index;
+    size_t reference_index;
+    size_t start;
+    size_t len;
+    Array residues;
+} DottedWindow;
+
+static Screen screen;
+static Array frame;                                  // Panes rendered by a refresh
+static Array reference_buffer;                       // Window of the pinned reference
+static Array window_buffer;                          // Window of a record
+static DottedWindow windows[DISPLAY_DOTS_CACHE_SIZE]; // Dotted windows kept by record
+static struct
+{
+    int fg; // Tagged color code, or COLOR_DEFAULT
+    int bg;
+} frame_colors = {COLOR_DEFAULT, COLOR_DEFAULT}; // Colors residues left the frame in, so runs across rows share them
+
+static void display_move_panes(Array *buffer)
+{
+    /* Scrolls the record panes and shifts the sequence panes on the terminal by the change in offsets since the last
+       refresh, so the flush writes only the rows and columns exposed; anything else that changed is still diffed */
+    static const FileState *last_file = NULL;
+    static size_t last_offset_record, last_offset_sequence;
+    static unsigned int last_geometry[5];
+
+    FileState *active_file = state.active_file;
+    unsigned int pinned_height = state_get_pinned_height(&state);
+    unsigned int record_panes_height = state_get_record_panes_height(&state);
+    unsigned int sequence_pane_width = state_get_sequence_pane_width(&state);
+    unsigned int geometry[5] = {state.terminal_rows, state.terminal_cols, active_file->header_pane_width,
+                                active_file->ruler_pane_height, pinned_height};
+    bool moved = active_file == last_file && memcmp(geometry, last_geometry, sizeof(geometry)) == 0;
+    size_t offset_record = active_file->offset_record;
+    size_t offset_sequence = active_file->offset_sequence;
+    if (moved && record_panes_height > 0 && state.scroll_rows && offset_record != last_offset_record)
+    {
+        size_t delta = (offset_record > last_offset_record) ? offset_record - last_offset_record
+                                                            : last_offset_record - offset_record;
+        unsigned int top = active_file->ruler_pane_height + pinned_height;
+        if (delta < record_panes_height)
+            screen_scroll_rows(&screen, buffer, top, top + record_panes_height - 1,
+                               (offset_record > last_offset_record) ? (int)delta : -(int)delta);
+    }
+    if (moved && sequence_pane_width > 0 && state.shift_columns && offset_sequence != last_offset_sequence)
+    {
+        size_t delta = (offset_sequence > last_offset_sequence) ? offset_sequence - last_offset_sequence
+                                                                : last_offset_sequence - offset_sequence;
+        unsigned int bottom = active_file->ruler_pane_height + pinned_height + record_panes_height - 1;
+        if (delta < sequence_pane_width)
+            screen_shift_columns(&screen, buffer, 0, bottom, active_file->header_pane_width,
+                                 (offset_sequence > last_offset_sequence) ? (int)delta : -(int)delta);
+    }
+    last_file = active_file;
+    last_offset_record = offset_record;
+    last_offset_sequence = offset_sequence;
+    memcpy(last_geometry, geometry, sizeof(geometry));
+}
+
 void display_refresh(Array *buffer)
 {
-    terminal_cursor_hide(buffer);
+    // Panes are rendered into a frame, and only the cells of it that changed on screen are written to buffer
+    if (frame.data == NULL && array_init(&frame, sizeof(char)) != 0)
+        return;
+    frame.len = 0;
+    terminal_cursor_hide(&frame);
     state.refresh_command_pane = true;
 
-    unsigned int rows, cols;
-    terminal_get_window_size(&rows, &cols);
-    if (state.terminal_rows != rows || state.terminal_cols != cols)
+    if (screen.front == NULL || screen.rows != state.terminal_rows || screen.cols != state.terminal_cols)
     {
-        state.terminal_rows = rows;
-        state.terminal_cols = cols;
-        state.refresh_window = true;
+        int code = (screen.front == NULL) ? screen_init(&screen, state.terminal_rows, state.terminal_cols)
+                                          : screen_resize(&screen, state.terminal_rows, state.terminal_cols);
+        if (code != 0)
+            return;
     }
     if (state.refresh_window)
     {
-        terminal_clear_screen(buffer);
+        terminal_clear_screen(&frame);
         state_set_header_pane_width(&state, state.active_file->header_pane_width); // Triggers automatic re-sizes
         state_set_ruler_pane_height(&state, state.active_file->ruler_pane_height);
         state.refresh_ruler_pane = true;
@@ -35,70 +104,128 @@ void display_refresh(Array *buffer)
     }
     if (state.refresh_ruler_pane)
     {
-        display_ruler_pane(buffer);
-        display_ruler_pane_ticks(buffer);
+        display_ruler_pane(&frame);
+        display_ruler_pane_ticks(&frame);
+        display_ruler_pane_profile(&frame);
         state.refresh_ruler_pane = false;
     }
     if (state.refresh_header_pane)
     {
-        display_header_pane(buffer);
+        display_header_pane(&frame);
         state.refresh_header_pane = false;
     }
     if (state.refresh_sequence_pane)
     {
-        display_sequence_pane(buffer);
+        display_sequence_pane(&frame);
         state.refresh_sequence_pane = false;
     }
     if (state.refresh_command_pane)
     {
-        display_command_pane(buffer);
+        display_command_pane(&frame);
         state.refresh_command_pane = false;
     }
-    display_cursor(buffer);
+    display_cursor(&frame);
+
+    display_move_panes(buffer);
+    screen_render(&screen, frame.data, frame.len);
+    screen_flush(&screen, buffer);
+}
+
+void display_free(void)
+{
+    // Frees the screen and the buffers kept between refreshes
+    screen_free(&screen);
+    array_free(&frame);
+    array_free(&reference_buffer);
+    array_free(&window_buffer);
+    for (unsigned int i = 0; i < DISPLAY_DOTS_CACHE_SIZE; i++)
+    {
+        array_free(&windows[i].residues);
+        windows[i].file = NULL;
+    }
+}
+
+void display_get_frame_stats(size_t *nframes, size_t *nbytes, size_t *nbytes_frame)
+{
+    // Frames count refreshes that wrote to the terminal, and bytes are those written by refreshes
+    *nframes = screen.nframes;
+    *nbytes = screen.nbytes;
+    *nbytes_frame = screen.nbytes_frame;
 }
 
 void display_all_panes(Array *buffer)
 {
     display_ruler_pane(buffer);
     display_ruler_pane_ticks(buffer);
+    display_ruler_pane_profile(buffer);
     display_header_pane(buffer);
     display_sequence_pane(buffer);
 }
 
+static void display_header(Array *buffer, size_t record_index)
+{
+    // Identities take the right of the pane if it leaves room for some of the header
+    FileState *active_file = state.active_file;
+    unsigned int ellipses_width = wcswidth(DISPLAY_HEADER_PANE_ELLIPSES, sizeof(DISPLAY_HEADER_PANE_ELLIPSES));
+    unsigned int identity_width = 0;
+    if (active_file->show_identities && active_file->header_pane_width > DISPLAY_IDENTITY_WIDTH + ellipses_width + 1)
+        identity_width = DISPLAY_IDENTITY_WIDTH;
+    unsigned int width = active_file->header_pane_width - identity_width;
+    state_resolve_record(&state, record_index);
+    SeqRecord record = active_file->records[record_index];
+    size_t len = record.header_len;
+    if (len > width)
+        len = width;
+    if (len < width)
+    {
+        array_extend(buffer, record.header, len);
+        for (unsigned int j = len; j < width - 1; j++)
+            array_append(buffer, " ");
+    }
+    else
+    {
+        array_extend(buffer, record.header, width - ellipses_width - 1);
+        array_extend(buffer, DISPLAY_HEADER_PANE_ELLIPSES, sizeof(DISPLAY_HEADER_PANE_ELLIPSES) - 1);
+    }
+    if (identity_width == 0)
+        return;
+
+    char s[DISPLAY_IDENTITY_WIDTH + 1];
+    float identity = (active_file->identities != NULL) ? active_file->identities[record_index] : IDENTITY_PENDING;
+    if (identity == IDENTITY_PENDING)
+        snprintf(s, sizeof(s), "%*s", DISPLAY_IDENTITY_WIDTH, "...");
+    else if (isnan(identity))
+        snprintf(s, sizeof(s), "%*s", DISPLAY_IDENTITY_WIDTH, "n/a");
+    else
+        snprintf(s, sizeof(s), "%*.1f%%", DISPLAY_IDENTITY_WIDTH - 1, identity);
+    array_extend(buffer, s, DISPLAY_IDENTITY_WIDTH);
+}
+
 void display_header_pane(Array *buffer)
 {
     FileState *active_file = state.active_file;
+    unsigned int pinned_height = state_get_pinned_height(&state);
     unsigned int record_panes_height = state_get_record_panes_height(&state);
 
-    unsigned int ellipses_width = wcswidth(DISPLAY_HEADER_PANE_ELLIPSES, sizeof(DISPLAY_HEADER_PANE_ELLIPSES));
+    char s[] = "┃\n\b";
+    if (pinned_height > 0)
+    {
+        terminal_cursor_ij(buffer, active_file->ruler_pane_height + 1, 1);
+        display_header(buffer, active_file->reference_index);
+        array_extend(buffer, s, sizeof(s) - 1);
+    }
     for (unsigned int i = 0; i < record_panes_height; i++)
     {
-        size_t record_index = i + active_file->offset_record;
-        terminal_cursor_ij(buffer, i + active_file->ruler_pane_height + 1, 1);
-        if (record_index < active_file->nrecords)
-        {
-            SeqRecord record = active_file->records[record_index];
-            size_t len = strnlen(record.header, active_file->header_pane_width);
-            if (len < active_file->header_pane_width)
-            {
-                array_extend(buffer, record.header, len);
-                for (unsigned int j = len; j < active_file->header_pane_width - 1; j++)
-                    array_append(buffer, " ");
-            }
-            else
-            {
-                array_extend(buffer, record.header, active_file->header_pane_width - ellipses_width - 1);
-                array_extend(buffer, DISPLAY_HEADER_PANE_ELLIPSES, sizeof(DISPLAY_HEADER_PANE_ELLIPSES) - 1);
-            }
-        }
+        size_t row = i + active_file->offset_record;
+        terminal_cursor_ij(buffer, i + active_file->ruler_pane_height + pinned_height + 1, 1);
+        if (row < active_file->nrecords)
+            display_header(buffer, state_get_row_record(active_file, row));
         else
         {
             array_extend(buffer, "~", sizeof("~") - 1);
             for (unsigned int j = 1; j < active_file->header_pane_width - 1; j++)
                 array_append(buffer, " ");
         }
-
-        char s[] = "┃\n\b";
         array_extend(buffer, s, sizeof(s) - 1);
     }
 }
@@ -140,6 +267,7 @@ void display_ruler_pane_ticks(Array *buffer)
     size_t j;
     unsigned int sequence_pane_width = state_get_sequence_pane_width(&state);
     unsigned int ellipses_width = wcswidth(DISPLAY_RULER_PANE_ELLIPSES, sizeof(DISPLAY_RULER_PANE_ELLIPSES));
+    unsigned int top = active_file->show_profile ? DISPLAY_PROFILE_HEIGHT : 0; // Digits go below the profile
     while ((j = x - active_file->offset_sequence - active_file->records_offset) < sequence_pane_width)
     {
         terminal_cursor_ij(buffer, active_file->ruler_pane_height, j + active_file->header_pane_width + 1);
@@ -156,11 +284,11 @@ void display_ruler_pane_ticks(Array *buffer)
             n = n / 10;
             snprintf(c, 2, "%d", d);
             array_append(buffer, c); // Excludes null in c
-            if (i == 0 && n != 0)
+            if (i == top && n != 0)
             {
                 for (i = 0; i < ellipses_width; i++)
                 {
-                    terminal_cursor_ij(buffer, i + 1, j + active_file->header_pane_width + 1);
+                    terminal_cursor_ij(buffer, top + i + 1, j + active_file->header_pane_width + 1);
                     array_extend(buffer, "·", sizeof("·"));
                 }
                 break;
@@ -171,58 +299,156 @@ void display_ruler_pane_ticks(Array *buffer)
     }
 }
 
-void display_sequence_pane(Array *buffer)
+void display_ruler_pane_profile(Array *buffer)
 {
     FileState *active_file = state.active_file;
-    unsigned int record_panes_height = state_get_record_panes_height(&state);
-    unsigned int sequence_pane_width = state_get_sequence_pane_width(&state);
+    if (!active_file->show_profile)
+        return;
 
-    for (unsigned int i = 0; i < record_panes_height; i++)
+    // Conservation is drawn in eighths; columns not yet counted are left blank
+    static const char *levels[] = {"▁", "▂", "▃", "▄", "▅", "▆", "▇", "█"};
+    static const char *labels[] = {"conservation", "consensus"};
+    const Profile *profile = &active_file->profile;
+    unsigned int sequence_pane_width = state_get_sequence_pane_width(&state);
+    for (unsigned int i = 0; i < DISPLAY_PROFILE_HEIGHT; i++)
     {
-        size_t record_index = i + active_file->offset_record;
+        terminal_cursor_ij(buffer, i + 1, 1);
+        size_t len = strlen(labels[i]);
+        if (len > active_file->header_pane_width - 1)
+            len = active_file->header_pane_width - 1;
+        array_extend(buffer, labels[i], len);
 
-        terminal_cursor_ij(buffer, i + active_file->ruler_pane_height + 1, active_file->header_pane_width + 1);
-        if (record_index < active_file->nrecords)
+        terminal_cursor_ij(buffer, i + 1, active_file->header_pane_width + 1);
+        for (unsigned int j = 0; j < sequence_pane_width; j++)
         {
-            SeqRecord record = active_file->records[record_index];
-            unsigned int left_continuation = 0;
-            unsigned int right_continuation = 0;
-            size_t start = active_file->offset_sequence;
-            unsigned int len;
-            if (active_file->offset_sequence > 0)
-            {
-                left_continuation = 1;
-                start++;
-            }
-            if (record.len <= active_file->offset_sequence)
-                len = 0;
-            else if ((record.len > active_file->offset_sequence + sequence_pane_width))
+            size_t column = active_file->offset_sequence + j;
+            if (column >= profile->ncols || profile->chunks_done == NULL ||
+                !profile->chunks_done[column / PROFILE_CHUNK_NCOLS])
+                array_append(buffer, " ");
+            else if (i == 0)
             {
-                right_continuation = 1;
-                len = sequence_pane_width - left_continuation - right_continuation; // Difference should always fit into int
+                const char *level = levels[(unsigned int)(profile->conservations[column] * 7 + 0.5f)];
+                array_extend(buffer, level, strlen(level));
             }
             else
-                len = record.len - active_file->offset_sequence - left_continuation;
-
-            if (left_continuation)
-                array_append(buffer, "<");
-            if (len > 0)
-                display_sequence(buffer, &record, start, len);
-            if (right_continuation)
-                array_append(buffer, ">");
-            else
-                for (unsigned int j = left_continuation + len; j < sequence_pane_width; j++)
-                    array_append(buffer, " ");
+                array_append(buffer, profile->consensus + column);
         }
+    }
+}
+
+static void display_set_colors(Array *buffer, const ColorEntry *entry)
+{
+    // Writes only the colors that differ from those the frame was left in
+    bool set_fg = entry->fg != frame_colors.fg;
+    bool set_bg = entry->bg != frame_colors.bg;
+    if (set_fg && set_bg)
+        array_extend(buffer, entry->sgr, entry->sgr_len);
+    else if (set_fg)
+        array_extend(buffer, entry->fg_sgr, entry->fg_sgr_len);
+    else if (set_bg)
+        array_extend(buffer, entry->bg_sgr, entry->bg_sgr_len);
+    frame_colors.fg = entry->fg;
+    frame_colors.bg = entry->bg;
+}
+
+static void display_reset_colors(Array *buffer)
+{
+    display_set_colors(buffer, &color_default_entry);
+}
+
+static void display_sequence_row(Array *buffer, size_t record_index, const char *reference, size_t reference_len)
+{
+    // Rows other than the reference's are shown with dots if reference is set
+    FileState *active_file = state.active_file;
+    unsigned int sequence_pane_width = state_get_sequence_pane_width(&state);
+    state_resolve_record(&state, record_index);
+    SeqRecord record = active_file->records[record_index];
+    unsigned int left_continuation = 0;
+    unsigned int right_continuation = 0;
+    size_t start = active_file->offset_sequence;
+    unsigned int len;
+    if (active_file->offset_sequence > 0)
+    {
+        left_continuation = 1;
+        start++;
+    }
+    if (record.len <= active_file->offset_sequence)
+        len = 0;
+    else if ((record.len > active_file->offset_sequence + sequence_pane_width))
+    {
+        right_continuation = 1;
+        len = sequence_pane_width - left_continuation - right_continuation; // Difference should always fit into int
+    }
+    else
+        len = record.len - active_file->offset_sequence - left_continuation;
+
+    if (left_continuation)
+    {
+        display_reset_colors(buffer);
+        array_append(buffer, "<");
+    }
+    if (len > 0 && reference != NULL && record_index != active_file->reference_index)
+        display_dotted_sequence(buffer, &record, record_index, start, len, reference, reference_len);
+    else if (len > 0)
+        display_sequence(buffer, &record, start, len);
+    if (left_continuation + len < sequence_pane_width) // Markers and padding are left in default colors
+        display_reset_colors(buffer);
+    if (right_continuation)
+        array_append(buffer, ">");
+    else
+        for (unsigned int j = left_continuation + len; j < sequence_pane_width; j++)
+            array_append(buffer, " ");
+}
+
+void display_sequence_pane(Array *buffer)
+{
+    FileState *active_file = state.active_file;
+    unsigned int pinned_height = state_get_pinned_height(&state);
+    unsigned int record_panes_height = state_get_record_panes_height(&state);
+    unsigned int sequence_pane_width = state_get_sequence_pane_width(&state);
+
+    // The reference's window is fetched once for all rows
+    const char *reference = NULL;
+    size_t reference_len = 0;
+    if (pinned_height > 0)
+    {
+        size_t start = active_file->offset_sequence + (active_file->offset_sequence > 0);
+        state_resolve_record(&state, active_file->reference_index);
+        SeqRecord *record = active_file->records + active_file->reference_index;
+        if (record->len > start)
+            reference_len = record->len - start;
+        if (reference_len > sequence_pane_width)
+            reference_len = sequence_pane_width;
+        if (reference_buffer.data == NULL && array_init(&reference_buffer, sizeof(char)) != 0)
+            return;
+        if (array_reserve(&reference_buffer, reference_len) != 0)
+            return;
+        reference = sequences_get_window(record, start, reference_len, reference_buffer.data);
+
+        terminal_cursor_ij(buffer, active_file->ruler_pane_height + 1, active_file->header_pane_width + 1);
+        display_sequence_row(buffer, active_file->reference_index, NULL, 0);
+    }
+
+    for (unsigned int i = 0; i < record_panes_height; i++)
+    {
+        size_t row = i + active_file->offset_record;
+        terminal_cursor_ij(buffer, i + active_file->ruler_pane_height + pinned_height + 1,
+                           active_file->header_pane_width + 1);
+        if (row < active_file->nrecords)
+            display_sequence_row(buffer, state_get_row_record(active_file, row), reference, reference_len);
         else
+        {
+            display_reset_colors(buffer); // Erases blank in the current colors
             terminal_clear_line_right(buffer);
+        }
     }
+    display_reset_colors(buffer);
 }
 
 void display_command_pane(Array *buffer)
 {
     FileState *active_file = state.active_file;
-    unsigned int record_panes_height = state_get_record_panes_height(&state);
+    unsigned int record_panes_height = state_get_record_panes_height(&state) + state_get_pinned_height(&state);
     unsigned int sequence_pane_width = state_get_sequence_pane_width(&state);
 
     if (state.terminal_rows <= active_file->ruler_pane_height)
@@ -237,9 +463,38 @@ void display_command_pane(Array *buffer)
     if (state.terminal_rows <= active_file->ruler_pane_height + 1)
         return;
 
+    char loading_status[64] = "";
+    if (active_file->nonascii && !active_file->nonascii_confirmed) // Keys answer the prompt until it is answered
+        snprintf(loading_status, sizeof(loading_status), "non-ASCII symbols; continue? (y/n)  ");
+    else if (active_file->loading)
+        snprintf(loading_status, sizeof(loading_status), "loading %zu records...  ", active_file->nrecords);
+    else if (active_file->loader_code < 0)
+        snprintf(loading_status, sizeof(loading_status), "loading failed (code %d)  ", active_file->loader_code);
+    else if (active_file->resolve_code < 0)
+        snprintf(loading_status, sizeof(loading_status), "reading failed (code %d)  ", active_file->resolve_code);
+    else if (active_file->index_failed)
+        snprintf(loading_status, sizeof(loading_status), "index failed  ");
+    else if (active_file->cache_failed)
+        snprintf(loading_status, sizeof(loading_status), "cache failed  ");
+    else if (active_file->show_profile && active_file->profiling)
+        snprintf(loading_status, sizeof(loading_status), "profiling...  ");
+    else if (active_file->show_profile && active_file->profile_code == PROFILE_ERROR_TOO_LARGE)
+        snprintf(loading_status, sizeof(loading_status), "profile too large  ");
+    else if (active_file->show_profile && active_file->profile_code < 0)
+        snprintf(loading_status, sizeof(loading_status), "profiling failed  ");
+    else if (active_file->show_identities && active_file->identity_failed)
+        snprintf(loading_status, sizeof(loading_status), "identities failed  ");
+    else if (active_file->sort_identities && active_file->row_records == NULL)
+        snprintf(loading_status, sizeof(loading_status), "sorting by identity...  ");
+    else if (active_file->show_identities && active_file->identifying)
+        snprintf(loading_status, sizeof(loading_status), "identities...  ");
+    else if (active_file->nonascii)
+        snprintf(loading_status, sizeof(loading_status), "non-ASCII symbols  ");
+
     char cursor_position[256];
     int n = snprintf(cursor_position, sizeof(cursor_position),
-                     "ROW %zu/%zu  COL %zu/%zu",
+                     "%sROW %zu/%zu  COL %zu/%zu",
+                     loading_status,
                      active_file->offset_record + active_file->cursor_record_i + 1, // 1-based indexing
                      active_file->nrecords,
                      active_file->offset_sequence + active_file->cursor_sequence_j + active_file->records_offset,
@@ -279,9 +534,9 @@ void display_cursor(Array *buffer)
         render_index_i = record_panes_height - 1;
     else
         render_index_i = active_file->cursor_record_i;
-    unsigned int cursor_i = render_index_i + active_file->ruler_pane_height + 1;
+    unsigned int cursor_i = render_index_i + active_file->ruler_pane_height + state_get_pinned_height(&state) + 1;
 
-    size_t record_index = render_index_i + active_file->offset_record;
+    size_t record_index = state_get_row_record(active_file, render_index_i + active_file->offset_record);
     size_t sequence_index = active_file->cursor_sequence_j + active_file->offset_sequence;
     SeqRecord record = active_file->records[record_index];
     unsigned int render_index_j;
@@ -301,70 +556,67 @@ void display_cursor(Array *buffer)
     terminal_cursor_show(buffer);
 }
 
-void display_sequence(Array *buffer, SeqRecord *record, size_t start, size_t len)
+static void display_residues(Array *buffer, SeqType seq_type, const char *seq, size_t len)
 {
-    SeqTypeState *type = state.types + record->type;
-    const Alphabet *alphabet = type->alphabet;
-    ColorScheme *color_scheme = type->color_scheme;
-    if (state.ncolors > 1 && color_scheme != NULL)
+    // Colors are written only where they change, so a run of residues of one color is extended at once
+    const ColorScheme *color_scheme = state.types[seq_type].color_scheme;
+    if (state.ncolors <= 1 || color_scheme == NULL)
     {
-        if (color_scheme->type == COLOR_4_BIT)
+        array_extend(buffer, seq, len);
+        return;
+    }
+
+    const ColorEntry *table = color_scheme->table;
+    size_t run_start = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char sym = seq[i];
+        const ColorEntry *entry = (sym < COLOR_TABLE_LEN) ? table + sym : &color_default_entry;
+        if (entry->fg != frame_colors.fg || entry->bg != frame_colors.bg)
         {
-            for (size_t i = start; i < start + len; i++)
-            {
-                char sym = record->seq[i];
-                int index = alphabet->index_map[(unsigned int)sym]; // Skip negativity check b/c already checked type
-                if (color_scheme->mask.fg[index] && color_scheme->mask.bg[index])
-                {
-                    Color4Bit fg_color = color_scheme->map.b4.fg[index];
-                    Color4Bit bg_color = color_scheme->map.b4.bg[index];
-                    terminal_set_color_4bit(buffer, fg_color, bg_color);
-                }
-                else if (color_scheme->mask.fg[index])
-                {
-                    Color4Bit fg_color = color_scheme->map.b4.fg[index];
-                    terminal_set_foreground_color_4bit(buffer, fg_color);
-                }
-                else if (color_scheme->mask.bg[index])
-                {
-                    Color4Bit bg_color = color_scheme->map.b4.bg[index];
-                    terminal_set_background_color_4bit(buffer, bg_color);
-                }
-                else
-                    terminal_set_color_default(buffer);
-                array_append(buffer, &sym);
-            }
-            terminal_set_color_default(buffer);
-        }
-        else if (color_scheme->type == COLOR_8_BIT)
-        {
-            for (size_t i = start; i < start + len; i++)
-            {
-                char sym = record->seq[i];
-                int index = alphabet->index_map[(unsigned int)sym]; // Skip negativity check b/c already checked type
-                if (color_scheme->mask.fg[index] && color_scheme->mask.bg[index])
-                {
-                    Color8Bit fg_color = color_scheme->map.b8.fg[index];
-                    Color8Bit bg_color = color_scheme->map.b8.bg[index];
-                    terminal_set_color_8bit(buffer, fg_color, bg_color);
-                }
-                else if (color_scheme->mask.fg[index])
-                {
-                    Color8Bit fg_color = color_scheme->map.b8.fg[index];
-                    terminal_set_foreground_color_8bit(buffer, fg_color);
-                }
-                else if (color_scheme->mask.bg[index])
-                {
-                    Color8Bit bg_color = color_scheme->map.b8.bg[index];
-                    terminal_set_background_color_8bit(buffer, bg_color);
-                }
-                else
-                    terminal_set_color_default(buffer);
-                array_append(buffer, &sym);
-            }
-            terminal_set_color_default(buffer);
+            array_extend(buffer, seq + run_start, i - run_start);
+            display_set_colors(buffer, entry);
+            run_start = i;
         }
     }
-    else
-        array_extend(buffer, record->seq + start, len);
+    array_extend(buffer, seq + run_start, len - run_start);
+}
+
+void display_sequence(Array *buffer, SeqRecord *record, size_t start, size_t len)
+{
+    // Fetch only the displayed residues
+    if (window_buffer.data == NULL && array_init(&window_buffer, sizeof(char)) != 0)
+        return;
+    if (array_reserve(&window_buffer, len) != 0)
+        return;
+    const char *seq = sequences_get_window(record, start, len, window_buffer.data);
+    display_residues(buffer, record->type, seq, len);
+}
+
+void display_dotted_sequence(Array *buffer, SeqRecord *record, size_t record_index, size_t start, size_t len,
+                             const char *reference, size_t reference_len)
+{
+    // Dotted windows are kept by record, so rows scrolled back into view are not compared again
+    FileState *active_file = state.active_file;
+    DottedWindow *window = windows + record_index % DISPLAY_DOTS_CACHE_SIZE;
+    if (window->file != active_file || window->record_index != record_index ||
+        window->reference_index != active_file->reference_index || window->start != start || window->len != len)
+    {
+        if (window->residues.data == NULL && array_init(&window->residues, sizeof(char)) != 0)
+            return;
+        if (array_reserve(&window->residues, len) != 0)
+            return;
+        char *residues = window->residues.data;
+        const char *seq = sequences_get_window(record, start, len, residues);
+        size_t n = (len < reference_len) ? len : reference_len;
+        sequences_dot_identities(residues, seq, reference, n);
+        if (seq != residues)
+            memcpy(residues + n, seq + n, len - n);
+        window->file = active_file;
+        window->record_index = record_index;
+        window->reference_index = active_file->reference_index;
+        window->start = start;
+        window->len = len;
+    }
+    display_residues(buffer, record->type, window->residues.data, len);
 }
@@ -13,15 +13,23 @@
 
 #define DISPLAY_HEADER_PANE_ELLIPSES L"..."
 #define DISPLAY_RULER_PANE_ELLIPSES L"···" // Re-oriented vertically
+#define DISPLAY_PROFILE_HEIGHT 2            // Rows of the column profile atop the ruler pane
+#define DISPLAY_DOTS_CACHE_SIZE 256         // Dotted windows kept by record
+#define DISPLAY_IDENTITY_WIDTH 7            // Columns of identities at the right of the header pane
 
 void display_refresh(Array *buffer);
+void display_free(void);
+void display_get_frame_stats(size_t *nframes, size_t *nbytes, size_t *nbytes_frame);
 void display_all_panes(Array *buffer);
 void display_header_pane(Array *buffer);
 void display_ruler_pane(Array *buffer);
 void display_ruler_pane_ticks(Array *buffer);
+void display_ruler_pane_profile(Array *buffer);
 void display_sequence_pane(Array *buffer);
 void display_command_pane(Array *buffer);
 void display_cursor(Array *buffer);
 void display_sequence(Array *buffer, SeqRecord *record, size_t start, size_t len);
+void display_dotted_sequence(Array *buffer, SeqRecord *record, size_t record_index, size_t start, size_t len,
+                             const char *reference, size_t reference_len);
 
 #endif // DISPLAY_H
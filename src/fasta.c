@@ -1,11 +1,20 @@
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 #include "array.h"
+#include "bgzf.h"
 #include "fasta.h"
 #include "sequences.h"
 
@@ -14,136 +23,812 @@ const int FASTA_ERROR_RECORD_OVERFLOW = -2;
 const int FASTA_ERROR_SEQUENCE_OVERFLOW = -3;
 const int FASTA_ERROR_FILE_IO = -4;
 const int FASTA_ERROR_MEMORY_ALLOCATION = -5;
+const int FASTA_ERROR_INVALID_INDEX = -6;
 
-int fasta_fread(FILE *fp, SeqRecord **records_ptr)
+#define CHUNK_SIZE (1 << 18)
+#define MIN_RANGE_LEN (1 << 24) // Bytes per parsing thread for mapped files
+#define MAX_THREADS 16
+#define WRITE_BLOCK_SIZE (1 << 20)
+#define MIN_DIRECT_LEN (1 << 12) // Longer runs are written from records rather than copied into the block
+#define MAX_IOVECS 16            // POSIX minimum for IOV_MAX
+
+static unsigned int fasta_nthreads = 0; // Threads for parsing mapped files; 0 picks from input size and processors
+
+typedef struct
+{
+    FILE *fp;
+    int fd; // Read directly if valid; otherwise through fp
+    char *data;
+    size_t capacity;
+    size_t start; // Start of unconsumed bytes
+    size_t end;   // End of read bytes
+    bool eof;
+} ChunkReader;
+
+typedef struct
+{
+    int fd;
+    char *block;
+    size_t block_len;
+    size_t block_start; // Start of copied bytes not yet queued in iov
+    struct iovec iov[MAX_IOVECS];
+    int niov;
+    int code;
+} BlockWriter;
+
+typedef struct
 {
-    // Declarations
+    char *data;
+    size_t len;
+    size_t begin; // Offset of first header in range
+    size_t stop;  // Offset of first header in next range
+    Array records;
     int code;
+} SpanRange;
 
-    void *ptr = NULL; // A generic temporary pointer for allocations
+static int append_record(SeqRecord *record, void *data)
+{
+    Array *records = data;
+    if (records->len >= INT_MAX - 1) // Ensures fit into return type
+        return FASTA_ERROR_RECORD_OVERFLOW;
+    if (array_append(records, record) != 0)
+        return FASTA_ERROR_RECORD_OVERFLOW;
+    return 0;
+}
 
-    int nrecords = 0;
+int fasta_fread(FILE *fp, Arena *arena, SeqRecord **records_ptr)
+{
     Array new_records;
-    array_init(&new_records, sizeof(SeqRecord));
+    if (array_init(&new_records, sizeof(SeqRecord)) != 0)
+        return FASTA_ERROR_MEMORY_ALLOCATION;
 
-    char *line = NULL;
-    size_t capacity = 0;
-    ssize_t linelen = 0;
+    int code = fasta_fread_records(fp, arena, &append_record, &new_records);
+    if (code >= 0 && array_shrink(&new_records) != 0)
+        code = FASTA_ERROR_MEMORY_ALLOCATION;
+    if (code < 0)
+    {
+        array_free(&new_records);
+        return code;
+    }
 
-    ssize_t trimlen = 0;
-    char *header = NULL;
-    char *seq = NULL;
-    char *id = NULL;
-    size_t seqlen = 0;
+    *records_ptr = new_records.data;
+    return new_records.len; // Will always fit--see check in append_record
+}
 
-    size_t bufferlen = 256;
-    char *buffer = NULL;
-    ptr = malloc(bufferlen);
+static int chunk_fill(ChunkReader *reader)
+{
+    /* Return codes
+        0: success, including at end of file
+        <0: FASTA error code
+    */
+    // Shift unconsumed bytes to front
+    size_t remaining = reader->end - reader->start;
+    if (reader->start > 0)
+    {
+        memmove(reader->data, reader->data + reader->start, remaining);
+        reader->start = 0;
+        reader->end = remaining;
+    }
 
-    if (ptr == NULL)
+    // Expand if a single line fills the chunk
+    if (reader->end == reader->capacity)
     {
-        code = FASTA_ERROR_MEMORY_ALLOCATION;
-        goto error;
+        if (reader->capacity > SIZE_MAX / 2)
+            return FASTA_ERROR_MEMORY_ALLOCATION;
+        char *ptr = realloc(reader->data, 2 * reader->capacity);
+        if (ptr == NULL)
+            return FASTA_ERROR_MEMORY_ALLOCATION;
+        reader->data = ptr;
+        reader->capacity *= 2;
+    }
+
+    size_t n;
+    if (reader->fd >= 0) // Partial reads from pipes return as soon as data is available
+    {
+        ssize_t m;
+        while ((m = read(reader->fd, reader->data + reader->end, reader->capacity - reader->end)) < 0 && errno == EINTR)
+            ;
+        if (m < 0)
+            return FASTA_ERROR_FILE_IO;
+        n = m;
+    }
+    else
+    {
+        n = fread(reader->data + reader->end, sizeof(char), reader->capacity - reader->end, reader->fp);
+        if (n == 0 && ferror(reader->fp))
+            return FASTA_ERROR_FILE_IO;
     }
-    buffer = ptr;
+    reader->end += n;
+    if (n == 0)
+        reader->eof = true;
+    return 0;
+}
+
+static int chunk_next_line(ChunkReader *reader, char **line_ptr, size_t *len)
+{
+    /* Return codes
+        1: line read; the line is valid until the next call and excludes its line break
+        0: end of file
+        <0: FASTA error code
+    */
+    size_t scanned = 0; // Bytes already searched for a line break
+    while (1)
+    {
+        char *line = reader->data + reader->start;
+        size_t available = reader->end - reader->start;
+        char *stop = memchr(line + scanned, '\n', available - scanned);
+        if (stop != NULL)
+        {
+            *line_ptr = line;
+            *len = stop - line;
+            reader->start += *len + 1;
+            return 1;
+        }
+        if (reader->eof)
+        {
+            if (available == 0)
+                return 0;
+            *line_ptr = line;
+            *len = available;
+            reader->start = reader->end;
+            return 1;
+        }
+        scanned = available;
+        int code = chunk_fill(reader);
+        if (code < 0)
+            return code;
+    }
+}
+
+static size_t find_record_end(const char *data, size_t len, size_t from)
+{
+    // Returns offset of the first > starting a line at or after from, or len if none; offset 0 starts a line
+    while (from < len)
+    {
+        const char *p = memchr(data + from, '>', len - from);
+        if (p == NULL)
+            return len;
+        size_t offset = p - data;
+        if (offset == 0 || data[offset - 1] == '\n')
+            return offset;
+        from = offset + 1;
+    }
+    return len;
+}
+
+int fasta_fread_records(FILE *fp, Arena *arena, SeqRecordCallback callback, void *data)
+{
+    /* Return codes
+        >=0: number of records passed to callback
+        <0: FASTA error code or non-zero callback return
+
+    Record members are allocated from arena, which the caller releases even on error.
+    */
+    int code;
+    int nrecords = 0;
+
+    ChunkReader reader = {.fp = fp, .fd = fileno(fp), .data = NULL, .capacity = CHUNK_SIZE, .start = 0, .end = 0, .eof = false};
+    if ((reader.data = malloc(reader.capacity)) == NULL)
+        return FASTA_ERROR_MEMORY_ALLOCATION;
+
+    char *line;
+    size_t linelen;
 
     // Read until first non-empty line
-    while ((linelen = getline(&line, &capacity, fp)) == 1 && line[0] == '\n')
+    while ((code = chunk_next_line(&reader, &line, &linelen)) == 1 && linelen == 0)
         ;
 
     // Check for empty files and improper formatting
-    if (linelen <= 0)
-    {
-        code = 0;
-        goto error;
-    }
+    if (code <= 0)
+        goto cleanup;
     if (line[0] != '>')
     {
         code = FASTA_ERROR_INVALID_FORMAT;
-        goto error;
+        goto cleanup;
     }
 
-    // Read records
-    while (linelen > 0)
+    // Read records; each pass starts on a header line
+    while (code == 1)
     {
         // Get header
-        if (line[0] == '\n')
+        while (linelen > 1 && line[linelen - 1] == '\r')
+            linelen--;
+        size_t header_len = linelen - 1; // Excludes >
+        char *header = arena_alloc(arena, header_len + 1);
+        if (header == NULL)
         {
-            linelen = getline(&line, &capacity, fp);
-            continue;
+            code = FASTA_ERROR_MEMORY_ALLOCATION;
+            goto cleanup;
         }
+        memcpy(header, line + 1, header_len);
+        header[header_len] = '\0';
 
-        trimlen = linelen;
-        while (line[trimlen - 1] == '\n' || line[trimlen - 1] == '\r')
-            trimlen--;
+        // Get id
+        size_t id_len;
+        char *id = fasta_find_id(header, header_len, &id_len);
 
-        header = malloc(trimlen); // +1 for null; -1 for excluding >
-        if (header == NULL)
+        // Get seq span by reading until the next header is in the chunk
+        size_t span = 0;
+        while ((span = find_record_end(reader.data + reader.start, reader.end - reader.start, span)) ==
+                   reader.end - reader.start &&
+               !reader.eof)
+        {
+            if ((code = chunk_fill(&reader)) < 0)
+                goto cleanup;
+        }
+
+        // Get seq by copying lines without their breaks
+        char *seq = arena_alloc(arena, span + 1); // Line breaks make this an upper bound
+        if (seq == NULL)
         {
             code = FASTA_ERROR_MEMORY_ALLOCATION;
-            goto error;
+            goto cleanup;
         }
-        memcpy(header, line + 1, trimlen - 1);
-        header[trimlen - 1] = '\0';
+        size_t seqlen = 0;
+        char *p = reader.data + reader.start;
+        char *end = p + span;
+        while (p < end)
+        {
+            char *stop = memchr(p, '\n', end - p);
+            if (stop == NULL)
+                stop = end;
+            size_t n = stop - p;
+            while (n > 0 && p[n - 1] == '\r')
+                n--;
+            memcpy(seq + seqlen, p, n);
+            seqlen += n;
+            p = stop + 1;
+        }
+        seq[seqlen] = '\0';
+        reader.start += span;
 
-        // Get id
-        id = fasta_get_id(header);
-        if (id == NULL)
+        SeqRecord new_record = {
+            .header = header,
+            .id = id,
+            .seq = seq,
+            .header_len = header_len,
+            .id_len = id_len,
+            .len = seqlen,
+            .span = seqlen,
+            .type = SEQ_TYPE_UNSPECIFIED,
+        };
+        if (nrecords >= INT_MAX - 1) // Ensures fit into return type
+        {
+            code = FASTA_ERROR_RECORD_OVERFLOW;
+            goto cleanup;
+        }
+        int callback_code = callback(&new_record, data);
+        if (callback_code != 0)
+        {
+            code = callback_code;
+            goto cleanup;
+        }
+        nrecords++;
+
+        code = chunk_next_line(&reader, &line, &linelen);
+    }
+    if (code == 0)
+        code = nrecords;
+
+cleanup:
+    free(reader.data);
+    return code;
+}
+
+int fasta_read(const char *path, Arena *arena, SeqRecord **records_ptr)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return FASTA_ERROR_FILE_IO;
+
+    SeqRecord *ptr = NULL;
+    int nrecords = fasta_fread(fp, arena, &ptr);
+
+    if (fclose(fp) != 0)
+        return FASTA_ERROR_FILE_IO;
+
+    *records_ptr = ptr;
+
+    return nrecords;
+}
+
+static char *next_line(char *p, char *end)
+{
+    char *line_end = memchr(p, '\n', end - p);
+    return (line_end == NULL) ? end : line_end + 1;
+}
+
+static void parse_span_record(char **p_ptr, char *end, SeqRecord *record)
+{
+    char *p = *p_ptr;
+
+    // Get header
+    char *header = p + 1;
+    char *header_end = next_line(p, end);
+    p = header_end;
+    while (header_end > header && (header_end[-1] == '\n' || header_end[-1] == '\r'))
+        header_end--;
+    size_t header_len = header_end - header;
+
+    // Get id
+    size_t id_len;
+    char *id = fasta_find_id(header, header_len, &id_len);
+
+    // Get seq and check if lines are uniformly wrapped
+    char *seq = p;
+    size_t seqlen = 0;
+    size_t line_bases = 0, line_width = 0;
+    bool regular = true, last_line = false;
+    while (p < end && *p != '>')
+    {
+        char *line = p;
+        p = next_line(p, end);
+        char *line_end = p;
+        while (line_end > line && (line_end[-1] == '\n' || line_end[-1] == '\r'))
+            line_end--;
+        size_t bases = line_end - line;
+        size_t width = p - line;
+        bool unterminated = p == end && width == bases; // The last line of the data may lack a line break
+        if (line == seq)
+        {
+            line_bases = bases;
+            line_width = width;
+        }
+        else if (last_line || bases > line_bases || (bases == line_bases && width != line_width && !unterminated))
+            regular = false;
+        if (bases < line_bases) // Only the last line may be short
+            last_line = true;
+        seqlen += bases; // Bounded by len, so can't overflow
+    }
+    if (!regular || line_bases == 0)
+    {
+        line_bases = 0;
+        line_width = 0;
+    }
+
+    SeqRecord new_record = {
+        .header = header,
+        .id = id,
+        .seq = seq,
+        .header_len = header_len,
+        .id_len = id_len,
+        .len = seqlen,
+        .span = p - seq,
+        .line_bases = line_bases,
+        .line_width = line_width,
+        .type = SEQ_TYPE_UNSPECIFIED,
+    };
+    *record = new_record;
+    *p_ptr = p;
+}
+
+static void *parse_span_range(void *arg)
+{
+    SpanRange *range = arg;
+    char *p = range->data + range->begin;
+    char *stop = range->data + range->stop;
+    char *end = range->data + range->len; // Records may extend past stop
+
+    range->code = 0;
+    while (p < stop)
+    {
+        if (*p == '\n')
+        {
+            p++;
+            continue;
+        }
+        SeqRecord new_record;
+        parse_span_record(&p, end, &new_record);
+        if (range->records.len >= INT_MAX - 1 || array_append(&range->records, &new_record) != 0)
+        {
+            range->code = FASTA_ERROR_RECORD_OVERFLOW;
+            break;
+        }
+    }
+    return NULL;
+}
+
+void fasta_set_nthreads(unsigned int nthreads)
+{
+    fasta_nthreads = nthreads;
+}
+
+static unsigned int get_span_nthreads(size_t len)
+{
+    if (fasta_nthreads > 0)
+        return fasta_nthreads;
+
+    // Small inputs parse faster than threads start
+    long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t nthreads = len / MIN_RANGE_LEN;
+    if (nprocs > 0 && nthreads > (size_t)nprocs)
+        nthreads = nprocs;
+    if (nthreads > MAX_THREADS)
+        nthreads = MAX_THREADS;
+    return nthreads > 0 ? nthreads : 1;
+}
+
+static int fasta_parse_spans(char *data, size_t len, SeqRecord **records_ptr)
+{
+    char *p = data;
+    char *end = data + len;
+
+    // Skip blank lines and check for empty files and improper formatting
+    while (p < end && *p == '\n')
+        p++;
+    if (p == end)
+    {
+        *records_ptr = NULL;
+        return 0;
+    }
+    if (*p != '>')
+        return FASTA_ERROR_INVALID_FORMAT;
+
+    // Split into ranges which begin at headers, so each range is parsed independently
+    unsigned int nranges = get_span_nthreads(len);
+    SpanRange *ranges = malloc(nranges * sizeof(SpanRange));
+    if (ranges == NULL)
+        return FASTA_ERROR_MEMORY_ALLOCATION;
+    size_t first = p - data;
+    for (unsigned int i = 0; i < nranges; i++)
+    {
+        SpanRange *range = ranges + i;
+        range->data = data;
+        range->len = len;
+        range->begin = (i == 0) ? first : find_record_end(data, len, first + (len - first) / nranges * i);
+        range->code = 0;
+    }
+    for (unsigned int i = 0; i < nranges; i++)
+        ranges[i].stop = (i + 1 < nranges) ? ranges[i + 1].begin : len;
+
+    // Parse ranges; the first is parsed on this thread
+    int code = 0;
+    unsigned int ninit = 0;
+    for (; ninit < nranges; ninit++)
+    {
+        if (array_init(&ranges[ninit].records, sizeof(SeqRecord)) != 0)
         {
             code = FASTA_ERROR_MEMORY_ALLOCATION;
+            goto cleanup;
+        }
+    }
+    pthread_t *threads = malloc(nranges * sizeof(pthread_t));
+    bool *started = calloc(nranges, sizeof(bool));
+    for (unsigned int i = 1; i < nranges && threads != NULL && started != NULL; i++)
+        started[i] = pthread_create(threads + i, NULL, &parse_span_range, ranges + i) == 0;
+    parse_span_range(ranges);
+    for (unsigned int i = 1; i < nranges; i++)
+    {
+        if (threads != NULL && started != NULL && started[i])
+            pthread_join(threads[i], NULL);
+        else
+            parse_span_range(ranges + i); // Fall back to parsing serially
+    }
+    free(threads);
+    free(started);
+
+    // Stitch ranges in order
+    size_t nrecords = 0;
+    for (unsigned int i = 0; i < nranges; i++)
+    {
+        if (ranges[i].code != 0)
+        {
+            code = ranges[i].code;
+            goto cleanup;
+        }
+        nrecords += ranges[i].records.len;
+    }
+    if (nrecords >= INT_MAX - 1) // Ensures fit into return type
+    {
+        code = FASTA_ERROR_RECORD_OVERFLOW;
+        goto cleanup;
+    }
+    Array *new_records = &ranges[0].records;
+    if (array_reserve(new_records, nrecords) != 0)
+    {
+        code = FASTA_ERROR_MEMORY_ALLOCATION;
+        goto cleanup;
+    }
+    for (unsigned int i = 1; i < nranges; i++)
+        array_extend(new_records, ranges[i].records.data, ranges[i].records.len); // Reserved above, so can't fail
+    if (array_shrink(new_records) != 0)
+    {
+        code = FASTA_ERROR_MEMORY_ALLOCATION;
+        goto cleanup;
+    }
+    *records_ptr = new_records->data;
+    new_records->data = NULL; // Transfer ownership
+    code = nrecords;
+
+cleanup:
+    for (unsigned int i = 0; i < ninit; i++)
+        array_free(&ranges[i].records);
+    free(ranges);
+    return code;
+}
+
+static int map_file(int fd, FastaMap *map)
+{
+    map->data = NULL;
+    map->len = 0;
+    map->index = NULL;
+    map->bgzf = NULL;
+    map->allocated = false;
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode))
+        return FASTA_ERROR_FILE_IO;
+    if (sb.st_size == 0) // Zero-length mappings are invalid, so leave empty
+        return 0;
+    if ((uintmax_t)sb.st_size > SIZE_MAX)
+        return FASTA_ERROR_MEMORY_ALLOCATION;
+
+    // Private mappings are copy-on-write, so sequences can be compacted in place without changing the file
+    size_t len = sb.st_size;
+    char *data = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+        return FASTA_ERROR_FILE_IO;
+    map->data = data;
+    map->len = len;
+    return 0;
+}
+
+static int map_compressed(int fd, const char *gzi_path, bool lazy, FastaMap *map)
+{
+    map->data = NULL;
+    map->len = 0;
+    map->index = NULL;
+    map->bgzf = NULL;
+    map->allocated = false;
+
+    Bgzf *bgzf = malloc(sizeof(Bgzf));
+    if (bgzf == NULL)
+        return FASTA_ERROR_MEMORY_ALLOCATION;
+    int code = bgzf_open(bgzf, fd, gzi_path);
+    if (code == BGZF_ERROR_INVALID_FORMAT && !lazy) // Plain gzip, which is only readable from the start
+    {
+        free(bgzf);
+        struct stat sb;
+        if (fstat(fd, &sb) != 0 || sb.st_size == 0 || (uintmax_t)sb.st_size > SIZE_MAX)
+            return FASTA_ERROR_FILE_IO;
+        size_t clen = sb.st_size;
+        unsigned char *cdata = mmap(NULL, clen, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (cdata == MAP_FAILED)
+            return FASTA_ERROR_FILE_IO;
+        code = bgzf_inflate_gzip(cdata, clen, &map->data, &map->len);
+        munmap(cdata, clen);
+        if (code != 0)
+            return (code == BGZF_ERROR_MEMORY_ALLOCATION) ? FASTA_ERROR_MEMORY_ALLOCATION : FASTA_ERROR_INVALID_FORMAT;
+        map->allocated = true;
+        return 0;
+    }
+    if (code != 0)
+    {
+        free(bgzf);
+        if (lazy && code == BGZF_ERROR_INVALID_FORMAT)
+            return FASTA_ERROR_INVALID_INDEX; // Plain gzip can't be read at record offsets
+        return (code == BGZF_ERROR_MEMORY_ALLOCATION) ? FASTA_ERROR_MEMORY_ALLOCATION : FASTA_ERROR_FILE_IO;
+    }
+
+    // Anonymous mappings are only backed by memory as pages are written, so lazily inflated files cost little up front
+    map->bgzf = bgzf;
+    if (bgzf->ulen == 0)
+        return 0;
+    char *data = mmap(NULL, bgzf->ulen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED)
+    {
+        fasta_munmap(map);
+        return FASTA_ERROR_MEMORY_ALLOCATION;
+    }
+    map->data = data;
+    map->len = bgzf->ulen;
+    if (!lazy && bgzf_inflate_all(bgzf, data, get_span_nthreads(bgzf->ulen)) != 0)
+    {
+        fasta_munmap(map);
+        return FASTA_ERROR_INVALID_FORMAT;
+    }
+    return 0;
+}
+
+static int read_mapped(FastaMap *map, SeqRecord **records_ptr)
+{
+    SeqRecord *records = NULL;
+    int nrecords = fasta_parse_spans(map->data, map->len, &records);
+    if (nrecords <= 0)
+    {
+        fasta_munmap(map);
+        *records_ptr = NULL;
+        return nrecords;
+    }
+    *records_ptr = records;
+    return nrecords;
+}
+
+int fasta_mmap_read(int fd, FastaMap *map, SeqRecord **records_ptr)
+{
+    int code = map_file(fd, map);
+    if (code != 0)
+        return code;
+    return read_mapped(map, records_ptr);
+}
+
+int fasta_gz_read(int fd, FastaMap *map, SeqRecord **records_ptr)
+{
+    int code = map_compressed(fd, NULL, false, map);
+    if (code != 0)
+        return code;
+    return read_mapped(map, records_ptr);
+}
+
+void fasta_munmap(FastaMap *map)
+{
+    if (map->allocated)
+        free(map->data);
+    else if (map->data != NULL)
+        munmap(map->data, map->len);
+    free(map->index);
+    if (map->bgzf != NULL)
+    {
+        bgzf_close(map->bgzf);
+        free(map->bgzf);
+    }
+    map->data = NULL;
+    map->len = 0;
+    map->index = NULL;
+    map->bgzf = NULL;
+    map->allocated = false;
+}
+
+static int parse_index_field(char **field_ptr, char d, size_t *value)
+{
+    char *field = *field_ptr;
+    if (!isdigit((unsigned char)*field))
+        return 1;
+    errno = 0;
+    char *field_end;
+    unsigned long long x = strtoull(field, &field_end, 10);
+    if (errno != 0 || *field_end != d || x > SIZE_MAX)
+        return 1;
+    *value = x;
+    *field_ptr = field_end + 1;
+    return 0;
+}
+
+static char *replace_ext(const char *path, const char *ext, const char *new_ext)
+{
+    // Returns path with ext replaced by new_ext, or with new_ext appended if path doesn't end in ext
+    size_t path_len = strlen(path);
+    size_t ext_len = strlen(ext);
+    size_t new_ext_len = strlen(new_ext);
+    if (path_len >= ext_len && strcmp(path + path_len - ext_len, ext) == 0)
+        path_len -= ext_len;
+    char *new_path = malloc(path_len + new_ext_len + 1);
+    if (new_path == NULL)
+        return NULL;
+    memcpy(new_path, path, path_len);
+    memcpy(new_path + path_len, new_ext, new_ext_len + 1);
+    return new_path;
+}
+
+static int index_read(const char *index_path, int fd, bool compressed, FastaMap *map, SeqRecord **records_ptr)
+{
+    // Indices older than their files are considered stale
+    struct stat index_sb, sb;
+    if (stat(index_path, &index_sb) != 0 || fstat(fd, &sb) != 0)
+        return FASTA_ERROR_FILE_IO;
+    if (index_sb.st_mtime < sb.st_mtime)
+        return FASTA_ERROR_INVALID_INDEX;
+    if ((uintmax_t)index_sb.st_size >= SIZE_MAX)
+        return FASTA_ERROR_MEMORY_ALLOCATION;
+
+    // Read index into a single buffer which backs the record ids
+    FILE *fp = fopen(index_path, "r");
+    if (fp == NULL)
+        return FASTA_ERROR_FILE_IO;
+    size_t index_len = index_sb.st_size;
+    char *index = malloc(index_len + 1);
+    if (index == NULL)
+    {
+        fclose(fp);
+        return FASTA_ERROR_MEMORY_ALLOCATION;
+    }
+    size_t nread = fread(index, 1, index_len, fp);
+    fclose(fp);
+    if (nread != index_len)
+    {
+        free(index);
+        return FASTA_ERROR_FILE_IO;
+    }
+    index[index_len] = '\0';
+
+    // Compressed files are inflated as records are resolved, so the index replaces a full read
+    int code;
+    if (compressed)
+    {
+        char *gzi_path = replace_ext(index_path, FASTA_INDEX_EXT, BGZF_INDEX_EXT);
+        code = map_compressed(fd, gzi_path, true, map);
+        free(gzi_path);
+    }
+    else
+        code = map_file(fd, map);
+    if (code != 0)
+    {
+        free(index);
+        return code;
+    }
+    map->index = index;
+
+    Array new_records;
+    if (array_init(&new_records, sizeof(SeqRecord)) != 0)
+    {
+        code = FASTA_ERROR_MEMORY_ALLOCATION;
+        goto error;
+    }
+
+    // Parse lines of NAME LENGTH OFFSET LINEBASES LINEWIDTH
+    char *p = index;
+    char *end = index + index_len;
+    while (p < end)
+    {
+        char *name = p;
+        char *name_end = memchr(p, '\t', end - p);
+        if (name_end == NULL)
+        {
+            code = FASTA_ERROR_INVALID_INDEX;
             goto error;
         }
+        *name_end = '\0';
+        p = name_end + 1;
 
-        // Get seq
-        seqlen = 0;
-        while ((linelen = getline(&line, &capacity, fp)) > 0 && (line[0] != '>'))
+        size_t len, offset, line_bases, line_width;
+        char *line_end = memchr(p, '\n', end - p);
+        if (line_end != NULL)
+            *line_end = '\0'; // Terminates final field
+        if (parse_index_field(&p, '\t', &len) != 0 ||
+            parse_index_field(&p, '\t', &offset) != 0 ||
+            parse_index_field(&p, '\t', &line_bases) != 0 ||
+            parse_index_field(&p, '\0', &line_width) != 0)
         {
-            // Trim line
-            trimlen = linelen;
-            while (trimlen > 0 && (line[trimlen - 1] == '\n' || line[trimlen - 1] == '\r'))
-                trimlen--;
+            code = FASTA_ERROR_INVALID_INDEX;
+            goto error;
+        }
+        if (line_end == NULL)
+            p = end;
 
-            // Check for sequence overflow
-            if (seqlen >= SIZE_MAX - trimlen - 1)
+        // Check record fits in file
+        size_t span = 0;
+        if (len > 0)
+        {
+            if (line_bases == 0 || line_width < line_bases)
             {
-                code = FASTA_ERROR_SEQUENCE_OVERFLOW;
+                code = FASTA_ERROR_INVALID_INDEX;
                 goto error;
             }
-
-            // Check for buffer capacity
-            while (bufferlen <= seqlen + trimlen + 1)
+            size_t nlines = (len - 1) / line_bases;
+            if (nlines > (SIZE_MAX - line_bases) / line_width)
             {
-                if (bufferlen > SIZE_MAX / 2)
-                {
-                    code = FASTA_ERROR_MEMORY_ALLOCATION;
-                    goto error;
-                }
-                ptr = realloc(buffer, 2 * bufferlen);
-                if (ptr == NULL)
-                {
-                    code = FASTA_ERROR_MEMORY_ALLOCATION;
-                    goto error;
-                }
-                buffer = ptr;
-                bufferlen *= 2;
+                code = FASTA_ERROR_INVALID_INDEX;
+                goto error;
             }
-            memcpy(buffer + seqlen, line, trimlen);
-            seqlen += trimlen;
-            buffer[seqlen] = '\0';
+            span = nlines * line_width + (len - nlines * line_bases);
         }
-        seq = malloc(seqlen + 1);
-        if (seq == NULL)
+        if (offset > map->len || span > map->len - offset)
         {
-            code = FASTA_ERROR_MEMORY_ALLOCATION;
+            code = FASTA_ERROR_INVALID_INDEX;
             goto error;
         }
-        memcpy(seq, buffer, seqlen + 1);
 
+        // Headers are resolved from the file only when needed
         SeqRecord new_record = {
-            .header = header,
-            .id = id,
-            .seq = seq,
-            .len = seqlen,
+            .header = NULL,
+            .id = name,
+            .seq = map->data + offset,
+            .header_len = 0,
+            .id_len = name_end - name,
+            .len = len,
+            .span = span,
+            .line_bases = line_bases,
+            .line_width = line_width,
             .type = SEQ_TYPE_UNSPECIFIED,
         };
         if (new_records.len >= INT_MAX - 1) // Ensures fit into return type
@@ -157,9 +842,11 @@ int fasta_fread(FILE *fp, SeqRecord **records_ptr)
             goto error;
         }
     }
-
-    free(line);
-    free(buffer);
+    if (new_records.len == 0)
+    {
+        code = FASTA_ERROR_INVALID_INDEX;
+        goto error;
+    }
 
     if (array_shrink(&new_records) != 0)
     {
@@ -167,46 +854,217 @@ int fasta_fread(FILE *fp, SeqRecord **records_ptr)
         goto error;
     }
     *records_ptr = new_records.data;
-    nrecords = new_records.len; // Will always fit--see check above
-    return nrecords;
+    return new_records.len; // Will always fit--see check above
 
 error:
-    free(line);
-    free(buffer);
-    free(header);
-    free(id);
-    free(seq);
+    array_free(&new_records);
+    fasta_munmap(map);
+    return code;
+}
+
+int fasta_index_write(const char *index_path, const FastaMap *map, SeqRecord *records, const size_t nrecords)
+{
+    // Plain gzip files can't be read at record offsets
+    if (map->allocated)
+        return FASTA_ERROR_INVALID_FORMAT;
+
+    // Check all records are addressable by an index before writing anything
+    for (size_t i = 0; i < nrecords; i++)
+    {
+        SeqRecord *record = records + i;
+        if (record->len > 0 && record->line_bases == 0)
+            return FASTA_ERROR_INVALID_FORMAT;
+        if (record->seq < map->data || record->seq > map->data + map->len)
+            return FASTA_ERROR_INVALID_FORMAT;
+    }
 
-    header = NULL; // To guard against double frees
-    id = NULL;
-    seq = NULL;
-    for (size_t i = 0; i < new_records.len; i++)
+    FILE *fp = fopen(index_path, "w");
+    if (fp == NULL)
+        return FASTA_ERROR_FILE_IO;
+    for (size_t i = 0; i < nrecords; i++)
     {
-        SeqRecord *new_record = array_get(&new_records, i);
-        free(new_record->header);
-        free(new_record->id);
-        free(new_record->seq);
+        SeqRecord *record = records + i;
+        fprintf(fp, "%.*s\t%zu\t%zu\t%zu\t%zu\n",
+                (int)record->id_len, record->id,
+                record->len,
+                (size_t)(record->seq - map->data),
+                record->line_bases,
+                record->line_width);
     }
+    if (fclose(fp) != 0)
+        return FASTA_ERROR_FILE_IO;
 
-    array_free(&new_records);
+    // Offsets are into uncompressed data, so BGZF files also need their block offsets
+    if (map->bgzf != NULL)
+    {
+        char *gzi_path = replace_ext(index_path, FASTA_INDEX_EXT, BGZF_INDEX_EXT);
+        int code = (gzi_path == NULL) ? FASTA_ERROR_MEMORY_ALLOCATION : bgzf_index_write(map->bgzf, gzi_path);
+        free(gzi_path);
+        if (code != 0)
+            return FASTA_ERROR_FILE_IO;
+    }
+    return 0;
+}
+
+int fasta_index_read(const char *index_path, int fd, FastaMap *map, SeqRecord **records_ptr)
+{
+    return index_read(index_path, fd, false, map, records_ptr);
+}
+
+int fasta_gz_index_read(const char *index_path, int fd, FastaMap *map, SeqRecord **records_ptr)
+{
+    return index_read(index_path, fd, true, map, records_ptr);
+}
+
+static int inflate_span(const FastaMap *map, const char *p, size_t len)
+{
+    // Failed blocks are left as null bytes
+    if (map->bgzf == NULL)
+        return 0;
+    int code = bgzf_inflate_range(map->bgzf, map->data, p - map->data, len);
+    if (code == 0)
+        return 0;
+    return (code == BGZF_ERROR_MEMORY_ALLOCATION) ? FASTA_ERROR_MEMORY_ALLOCATION : FASTA_ERROR_INVALID_FORMAT;
+}
+
+static char inflate_byte(const FastaMap *map, const char *p, int *code)
+{
+    // Returns the byte at p, keeping the first error inflating any byte in code
+    int inflate_code = inflate_span(map, p, 1);
+    if (*code == 0)
+        *code = inflate_code;
+    return *p;
+}
+
+int fasta_resolve_record(const FastaMap *map, SeqRecord *record)
+{
+    /* Return codes
+        0: success
+        <0: error inflating the record, which is still resolved with its failed blocks as null bytes
+    */
+    if (record->header != NULL)
+        return 0;
+    int code = inflate_span(map, record->seq, record->span);
+
+    // Header line directly precedes the sequence
+    char *line_end = record->seq;
+    if (line_end > map->data && inflate_byte(map, line_end - 1, &code) == '\n')
+        line_end--;
+    while (line_end > map->data && inflate_byte(map, line_end - 1, &code) == '\r')
+        line_end--;
+    char *line = line_end;
+    while (line > map->data && inflate_byte(map, line - 1, &code) != '\n')
+        line--;
+    if (line < line_end && *line == '>')
+    {
+        record->header = line + 1;
+        record->header_len = line_end - line - 1;
+    }
+    else // Index doesn't match file, so fall back to id
+    {
+        record->header = record->id;
+        record->header_len = record->id_len;
+    }
     return code;
 }
 
-int fasta_read(const char *path, SeqRecord **records_ptr)
+static void writer_queue_block(BlockWriter *writer)
 {
-    FILE *fp = fopen(path, "r");
-    if (fp == NULL)
-        return FASTA_ERROR_FILE_IO;
+    if (writer->block_len > writer->block_start)
+    {
+        writer->iov[writer->niov].iov_base = writer->block + writer->block_start;
+        writer->iov[writer->niov].iov_len = writer->block_len - writer->block_start;
+        writer->niov++;
+        writer->block_start = writer->block_len;
+    }
+}
 
-    SeqRecord *ptr = NULL;
-    int nrecords = fasta_fread(fp, &ptr);
+static void writer_flush(BlockWriter *writer)
+{
+    writer_queue_block(writer);
+    struct iovec *iov = writer->iov;
+    int niov = writer->niov;
+    while (niov > 0 && writer->code == 0)
+    {
+        ssize_t nbytes = writev(writer->fd, iov, niov);
+        if (nbytes < 0 && errno == EINTR)
+            continue;
+        if (nbytes <= 0)
+        {
+            writer->code = FASTA_ERROR_FILE_IO;
+            break;
+        }
 
-    if (fclose(fp) != 0)
-        return FASTA_ERROR_FILE_IO;
+        // Skip fully written vectors and trim a partially written one
+        while (niov > 0 && (size_t)nbytes >= iov->iov_len)
+        {
+            nbytes -= iov->iov_len;
+            iov++;
+            niov--;
+        }
+        if (niov > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + nbytes;
+            iov->iov_len -= nbytes;
+        }
+    }
+    writer->niov = 0;
+    writer->block_len = 0;
+    writer->block_start = 0;
+}
 
-    *records_ptr = ptr;
+static void writer_write(BlockWriter *writer, const char *data, size_t len)
+{
+    if (len >= MIN_DIRECT_LEN)
+    {
+        if (writer->niov + 3 > MAX_IOVECS) // Room for the pending block, this run, and the block after it
+            writer_flush(writer);
+        writer_queue_block(writer);
+        writer->iov[writer->niov].iov_base = (char *)data;
+        writer->iov[writer->niov].iov_len = len;
+        writer->niov++;
+        return;
+    }
+    if (len > WRITE_BLOCK_SIZE - writer->block_len)
+        writer_flush(writer);
+    memcpy(writer->block + writer->block_len, data, len);
+    writer->block_len += len;
+}
 
-    return nrecords;
+static void writer_putc(BlockWriter *writer, char c)
+{
+    if (writer->block_len == WRITE_BLOCK_SIZE)
+        writer_flush(writer);
+    writer->block[writer->block_len++] = c;
+}
+
+int fasta_fdwrite(int fd, SeqRecord *records, const size_t nrecords, const size_t line_len)
+{
+    // Directly written runs point into records, so they must stay valid until the writer is flushed
+    BlockWriter writer = {.fd = fd, .block_len = 0, .block_start = 0, .niov = 0, .code = 0};
+    writer.block = malloc(WRITE_BLOCK_SIZE);
+    if (writer.block == NULL)
+        return FASTA_ERROR_MEMORY_ALLOCATION;
+    for (size_t i = 0; i < nrecords && writer.code == 0; i++)
+    {
+        SeqRecord *record = records + i;
+        sequences_compact_seq(record);
+        writer_putc(&writer, '>');
+        if (record->header != NULL)
+            writer_write(&writer, record->header, record->header_len);
+        else // Unresolved headers from an index
+            writer_write(&writer, record->id, record->id_len);
+        writer_putc(&writer, '\n');
+        size_t step = (line_len > 0) ? line_len : record->len;
+        for (size_t j = 0; j < record->len; j += step)
+        {
+            writer_write(&writer, record->seq + j, (record->len - j < step) ? record->len - j : step);
+            writer_putc(&writer, '\n');
+        }
+    }
+    writer_flush(&writer);
+    free(writer.block);
+    return writer.code;
 }
 
 int fasta_fwrite(FILE *fp, SeqRecord *records, const int nrecords, const int maxlen)
@@ -214,22 +1072,77 @@ int fasta_fwrite(FILE *fp, SeqRecord *records, const int nrecords, const int max
     for (int i = 0; i < nrecords; i++)
     {
         SeqRecord *record = records + i;
-        fprintf(fp, ">%s\n", record->header);
+        sequences_compact_seq(record);
+        if (record->header != NULL)
+            fprintf(fp, ">%.*s\n", (int)record->header_len, record->header);
+        else // Unresolved headers from an index
+            fprintf(fp, ">%.*s\n", (int)record->id_len, record->id);
         fasta_wrap_string(fp, record->seq, record->len, maxlen);
     }
     return 0;
 }
 
-int fasta_write(const char *path, SeqRecord *records, const int nrecords, const int maxlen)
+int fasta_write(const char *path, SeqRecord *records, const size_t nrecords, const size_t line_len, const bool atomic)
 {
-    FILE *fp = fopen(path, "w");
-    int code = fasta_fwrite(fp, records, nrecords, maxlen);
-    fclose(fp);
+    if (!atomic)
+    {
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd == -1)
+            return FASTA_ERROR_FILE_IO;
+        int code = fasta_fdwrite(fd, records, nrecords, line_len);
+        if (close(fd) != 0 && code == 0)
+            code = FASTA_ERROR_FILE_IO;
+        return code;
+    }
+
+    // Write to a temporary file in the same directory, so a rename replaces the original only once complete
+    size_t path_len = strlen(path);
+    char *tmp_path = malloc(path_len + sizeof(".XXXXXX"));
+    if (tmp_path == NULL)
+        return FASTA_ERROR_MEMORY_ALLOCATION;
+    memcpy(tmp_path, path, path_len);
+    memcpy(tmp_path + path_len, ".XXXXXX", sizeof(".XXXXXX"));
+    int fd = mkstemp(tmp_path);
+    if (fd == -1)
+    {
+        free(tmp_path);
+        return FASTA_ERROR_FILE_IO;
+    }
+
+    // Match permissions of the original or of a newly created file, since mkstemp creates files as private
+    struct stat sb;
+    mode_t mode;
+    if (stat(path, &sb) == 0)
+        mode = sb.st_mode & 07777;
+    else
+    {
+        mode_t mask = umask(0);
+        umask(mask);
+        mode = 0666 & ~mask;
+    }
+    int code = fasta_fdwrite(fd, records, nrecords, line_len);
+    if (code == 0 && (fchmod(fd, mode) != 0 || fsync(fd) != 0))
+        code = FASTA_ERROR_FILE_IO;
+    if (close(fd) != 0 && code == 0)
+        code = FASTA_ERROR_FILE_IO;
+    if (code == 0 && rename(tmp_path, path) != 0)
+        code = FASTA_ERROR_FILE_IO;
+    if (code != 0)
+        unlink(tmp_path);
+    free(tmp_path);
     return code;
 }
 
 void fasta_wrap_string(FILE *fp, const char *s, const size_t len, const int maxlen)
 {
+    if (maxlen <= 0) // Unwrapped
+    {
+        if (len == 0)
+            return;
+        fwrite(s, sizeof(char), len, fp);
+        fputc('\n', fp);
+        return;
+    }
     size_t nlines = len / maxlen;
     size_t j;
     for (j = 0; j < nlines; j++)
@@ -246,15 +1159,29 @@ void fasta_wrap_string(FILE *fp, const char *s, const size_t len, const int maxl
 }
 
 char *fasta_get_id(const char *header)
+{
+    size_t len;
+    char *start = fasta_find_id(header, strlen(header), &len);
+
+    // Allocate memory
+    char *id = malloc(len + 1);
+    if (id == NULL)
+        return id;
+    memcpy(id, start, len);
+    *(id + len) = '\0';
+    return id;
+}
+
+char *fasta_find_id(const char *header, const size_t header_len, size_t *id_len)
 {
     size_t start = SIZE_MAX, stop = SIZE_MAX;
     size_t i = 0;
 
     // Check for start and stop
-    // A string in memory without the null terminator will always be less than SIZE_MAX, so no need to check
-    char c;
-    while ((c = header[i]) != '\0')
+    // A string in memory will always be less than SIZE_MAX, so no need to check
+    while (i < header_len)
     {
+        char c = header[i];
         if (start == SIZE_MAX && !isspace(c))
             start = i;
         else if (start != SIZE_MAX && isspace(c))
@@ -265,19 +1192,14 @@ char *fasta_get_id(const char *header)
         i++;
     }
 
-    size_t len;
     if (start == SIZE_MAX) // No start
-        len = 0;
+    {
+        *id_len = 0;
+        return (char *)header + header_len;
+    }
     else if (stop == SIZE_MAX) // Start but no stop
-        len = i - start;
+        *id_len = i - start;
     else // Start and stop
-        len = stop - start;
-
-    // Allocate memory
-    char *id = malloc(len + 1);
-    if (id == NULL)
-        return id;
-    strncpy(id, header + start, len);
-    *(id + len) = '\0';
-    return id;
+        *id_len = stop - start;
+    return (char *)header + start;
 }
@@ -5,21 +5,47 @@
  * FASTA format IO
  */
 
+#include <stdbool.h>
 #include <stdio.h>
 
+#include "arena.h"
+#include "bgzf.h"
 #include "sequences.h"
 
+#define FASTA_INDEX_EXT ".fai"
+
+typedef struct
+{
+    char *data;
+    size_t len;
+    char *index;    // Backs ids of records read from an index
+    Bgzf *bgzf;     // Inflates data as records are resolved if set
+    bool allocated; // Data is allocated rather than mapped
+} FastaMap;
+
 extern const int FASTA_ERROR_INVALID_FORMAT;
 extern const int FASTA_ERROR_RECORD_OVERFLOW;
 extern const int FASTA_ERROR_SEQUENCE_OVERFLOW;
 extern const int FASTA_ERROR_FILE_IO;
 extern const int FASTA_ERROR_MEMORY_ALLOCATION;
+extern const int FASTA_ERROR_INVALID_INDEX;
 
-int fasta_fread(FILE *fp, SeqRecord **records_ptr);
-int fasta_read(const char *path, SeqRecord **records_ptr);
+int fasta_fread(FILE *fp, Arena *arena, SeqRecord **records_ptr);
+int fasta_fread_records(FILE *fp, Arena *arena, SeqRecordCallback callback, void *data);
+int fasta_read(const char *path, Arena *arena, SeqRecord **records_ptr);
+int fasta_mmap_read(int fd, FastaMap *map, SeqRecord **records_ptr);
+int fasta_gz_read(int fd, FastaMap *map, SeqRecord **records_ptr);
+void fasta_set_nthreads(unsigned int nthreads);
+void fasta_munmap(FastaMap *map);
+int fasta_index_read(const char *index_path, int fd, FastaMap *map, SeqRecord **records_ptr);
+int fasta_gz_index_read(const char *index_path, int fd, FastaMap *map, SeqRecord **records_ptr);
+int fasta_index_write(const char *index_path, const FastaMap *map, SeqRecord *records, const size_t nrecords);
+int fasta_resolve_record(const FastaMap *map, SeqRecord *record);
+int fasta_fdwrite(int fd, SeqRecord *records, const size_t nrecords, const size_t line_len);
 int fasta_fwrite(FILE *fp, SeqRecord *records, const int nrecords, const int maxlen);
-int fasta_write(const char *path, SeqRecord *records, const int nrecords, const int maxlen);
+int fasta_write(const char *path, SeqRecord *records, const size_t nrecords, const size_t line_len, const bool atomic);
 void fasta_wrap_string(FILE *fp, const char *s, const size_t len, const int maxlen);
 char *fasta_get_id(const char *header);
+char *fasta_find_id(const char *header, const size_t header_len, size_t *id_len);
 
 #endif // FASTA_H
@@ -0,0 +1,405 @@
+#include <ctype.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+#include "identity.h"
+
+#define WINDOW_LEN 4096 // Residues fetched at a time, so packed records are decoded in pieces
+#define RESIDUE_SHIFT 8 // Symbol codes are below 256, so a flag marking residues fits above them
+#define RESIDUE_FLAG (1u << RESIDUE_SHIFT)
+#define MAX_NPLANES 8
+#define BIT_MASK_1 0x5555555555555555
+#define BIT_MASK_2 0x3333333333333333
+#define BIT_MASK_4 0x0F0F0F0F0F0F0F0F
+#define BYTE_ONES 0x0101010101010101
+
+const int IDENTITY_ERROR_MEMORY_ALLOCATION = -1;
+const int IDENTITY_ERROR_FILE_IO = -2;
+
+typedef struct
+{
+    const IdentityCodes *codes;
+    SeqRecord *records;
+    size_t start;   // First row of the band
+    size_t nrows;   // Rows in the band
+    size_t i_start; // Rows of the band formatted by the job
+    size_t i_end;
+    size_t j_start; // Columns of the band computed by the job
+    size_t j_end;
+    float *identities;
+    Array *text;
+} IdentityJob;
+
+static bool is_gap(unsigned char sym)
+{
+    return sym == '-' || sym == '.';
+}
+
+int identity_encode(IdentityCodes *codes, SeqRecord *records, size_t nrecords)
+{
+    codes->words = NULL;
+    codes->nrows = nrecords;
+    codes->nwords = 0;
+    codes->nplanes = 0;
+    size_t maxlen = 0;
+    for (size_t i = 0; i < nrecords; i++)
+    {
+        if (records[i].len > maxlen)
+            maxlen = records[i].len;
+    }
+
+    // Codes are only given to symbols present, so small alphabets take few planes
+    bool present[256] = {false};
+    char window[WINDOW_LEN];
+    for (size_t i = 0; i < nrecords; i++)
+    {
+        SeqRecord *record = records + i;
+        for (size_t start = 0; start < record->len; start += WINDOW_LEN)
+        {
+            size_t n = (record->len - start < WINDOW_LEN) ? record->len - start : WINDOW_LEN;
+            const unsigned char *seq = (const unsigned char *)sequences_get_window(record, start, n, window);
+            for (size_t k = 0; k < n; k++)
+                present[seq[k]] = true;
+        }
+    }
+    for (unsigned int c = 0; c < 256; c++)
+        present[toupper(c)] |= present[c];
+    unsigned int symbol_codes[256]; // Code of the case-folded symbol with RESIDUE_FLAG set, or 0 for gaps
+    unsigned int ncodes = 0;
+    for (unsigned int c = 0; c < 256; c++)
+    {
+        if (present[c] && !is_gap(c) && c == (unsigned int)toupper(c))
+            symbol_codes[c] = RESIDUE_FLAG | ncodes++;
+    }
+    for (unsigned int c = 0; c < 256; c++)
+        symbol_codes[c] = (present[c] && !is_gap(c)) ? symbol_codes[toupper(c)] : 0;
+    while ((1u << codes->nplanes) < ncodes)
+        codes->nplanes++;
+
+    codes->nwords = (maxlen + 63) / 64;
+    unsigned int ngroup_words = codes->nplanes + 1;
+    size_t stride = codes->nwords * ngroup_words;
+    if (stride > 0 && nrecords > SIZE_MAX / sizeof(uint64_t) / stride)
+        return IDENTITY_ERROR_MEMORY_ALLOCATION;
+    if (stride > 0 && nrecords > 0 && (codes->words = malloc(nrecords * stride * sizeof(uint64_t))) == NULL)
+        return IDENTITY_ERROR_MEMORY_ALLOCATION;
+
+    // Windows start on word boundaries, so each group is assembled in registers and stored once
+    for (size_t i = 0; i < nrecords; i++)
+    {
+        SeqRecord *record = records + i;
+        uint64_t *group = codes->words + i * stride;
+        for (size_t start = 0; start < record->len; start += WINDOW_LEN)
+        {
+            size_t n = (record->len - start < WINDOW_LEN) ? record->len - start : WINDOW_LEN;
+            const unsigned char *seq = (const unsigned char *)sequences_get_window(record, start, n, window);
+            for (size_t word_start = 0; word_start < n; word_start += 64, group += ngroup_words)
+            {
+                size_t word_len = (n - word_start < 64) ? n - word_start : 64;
+                uint64_t words[MAX_NPLANES + 1] = {0};
+                for (size_t k = 0; k < word_len; k++)
+                {
+                    unsigned int code = symbol_codes[seq[word_start + k]];
+                    words[0] |= (uint64_t)(code >> RESIDUE_SHIFT) << k;
+                    for (unsigned int p = 0; p < codes->nplanes; p++)
+                        words[p + 1] |= (uint64_t)(code >> p & 1) << k;
+                }
+                memcpy(group, words, ngroup_words * sizeof(uint64_t));
+            }
+        }
+        memset(group, 0, (codes->words + (i + 1) * stride - group) * sizeof(uint64_t)); // Past the record's length
+    }
+    return 0;
+}
+
+void identity_free(IdentityCodes *codes)
+{
+    free(codes->words);
+    codes->words = NULL;
+    codes->nrows = 0;
+}
+
+static inline uint64_t count_bits(uint64_t x)
+{
+    x -= (x >> 1) & BIT_MASK_1;
+    x = (x & BIT_MASK_2) + ((x >> 2) & BIT_MASK_2);
+    x = (x + (x >> 4)) & BIT_MASK_4;
+    return (x * BYTE_ONES) >> 56;
+}
+
+static float compare_rows(const uint64_t *x, const uint64_t *y, size_t nwords, unsigned int nplanes)
+{
+    // Columns with residues in both rows are aligned, and aligned columns whose codes agree in every plane are identical
+    uint64_t naligned = 0, nidentical = 0;
+    for (size_t w = 0; w < nwords; w++, x += nplanes + 1, y += nplanes + 1)
+    {
+        uint64_t aligned = x[0] & y[0];
+        uint64_t diff = 0;
+        for (unsigned int p = 1; p <= nplanes; p++)
+            diff |= x[p] ^ y[p];
+        naligned += count_bits(aligned);
+        nidentical += count_bits(aligned & ~diff);
+    }
+    return (naligned > 0) ? 100.0f * nidentical / naligned : NAN;
+}
+
+float identity_get_pair(const IdentityCodes *codes, size_t i, size_t j)
+{
+    size_t stride = codes->nwords * (codes->nplanes + 1);
+    return compare_rows(codes->words + i * stride, codes->words + j * stride, codes->nwords, codes->nplanes);
+}
+
+static inline unsigned int fold_symbol(unsigned char sym)
+{
+    // Returns the upper case of letters, 0 for gaps, and other symbols as is
+    if ('a' <= sym && sym <= 'z')
+        return sym - ('a' - 'A');
+    return is_gap(sym) ? 0 : sym;
+}
+
+float identity_compare_records(SeqRecord *x, SeqRecord *y)
+{
+    // Compares a single pair bytewise, which avoids encoding all rows when only one row's identities are needed
+    char x_window[WINDOW_LEN], y_window[WINDOW_LEN];
+    size_t len = (x->len < y->len) ? x->len : y->len;
+    uint64_t naligned = 0, nidentical = 0;
+    for (size_t start = 0; start < len; start += WINDOW_LEN)
+    {
+        size_t n = (len - start < WINDOW_LEN) ? len - start : WINDOW_LEN;
+        const unsigned char *x_seq = (const unsigned char *)sequences_get_window(x, start, n, x_window);
+        const unsigned char *y_seq = (const unsigned char *)sequences_get_window(y, start, n, y_window);
+        for (size_t k = 0; k < n; k++)
+        {
+            unsigned int a = fold_symbol(x_seq[k]), b = fold_symbol(y_seq[k]);
+            unsigned int aligned = (a != 0) & (b != 0);
+            naligned += aligned;
+            nidentical += aligned & (a == b);
+        }
+    }
+    return (naligned > 0) ? 100.0f * nidentical / naligned : NAN;
+}
+
+static void *compute_columns(void *arg)
+{
+    // Compares the band's rows against blocks of rows in the job's columns, so a block is read once per band
+    IdentityJob *job = arg;
+    const IdentityCodes *codes = job->codes;
+    size_t stride = codes->nwords * (codes->nplanes + 1);
+    for (size_t j_block = job->j_start; j_block < job->j_end; j_block += IDENTITY_BLOCK_NROWS)
+    {
+        size_t j_end = (job->j_end - j_block < IDENTITY_BLOCK_NROWS) ? job->j_end : j_block + IDENTITY_BLOCK_NROWS;
+        for (size_t i = 0; i < job->nrows; i++)
+        {
+            const uint64_t *x = codes->words + (job->start + i) * stride;
+            float *identities = job->identities + i * codes->nrows;
+            for (size_t j = j_block; j < j_end; j++)
+                identities[j] = compare_rows(x, codes->words + j * stride, codes->nwords, codes->nplanes);
+        }
+    }
+    return NULL;
+}
+
+static void run_jobs(void *(*function)(void *), IdentityJob *jobs, unsigned int njobs)
+{
+    // Runs the first job on the calling thread, and any job whose thread fails to start as well
+    pthread_t *threads = malloc(njobs * sizeof(pthread_t));
+    bool *started = calloc(njobs, sizeof(bool));
+    for (unsigned int t = 1; t < njobs && threads != NULL && started != NULL; t++)
+        started[t] = pthread_create(threads + t, NULL, function, jobs + t) == 0;
+    for (unsigned int t = 0; t < njobs; t++)
+    {
+        if (t == 0 || started == NULL || !started[t])
+            function(jobs + t);
+    }
+    for (unsigned int t = 1; t < njobs && started != NULL; t++)
+    {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+    }
+    free(threads);
+    free(started);
+}
+
+int identity_compute_rows(const IdentityCodes *codes, size_t start, size_t nrows, float *identities,
+                          unsigned int nthreads)
+{
+    // Fills identities with nrows rows of identities to all rows, splitting columns by blocks over threads
+    size_t nblocks = (codes->nrows + IDENTITY_BLOCK_NROWS - 1) / IDENTITY_BLOCK_NROWS;
+    if (nthreads > nblocks)
+        nthreads = nblocks;
+    if (nthreads == 0)
+        return 0;
+    IdentityJob *jobs = malloc(nthreads * sizeof(IdentityJob));
+    if (jobs == NULL)
+        return IDENTITY_ERROR_MEMORY_ALLOCATION;
+    for (unsigned int t = 0; t < nthreads; t++)
+    {
+        IdentityJob *job = jobs + t;
+        job->codes = codes;
+        job->start = start;
+        job->nrows = nrows;
+        job->j_start = nblocks * t / nthreads * IDENTITY_BLOCK_NROWS;
+        job->j_end = nblocks * (t + 1) / nthreads * IDENTITY_BLOCK_NROWS;
+        if (job->j_end > codes->nrows)
+            job->j_end = codes->nrows;
+        job->identities = identities;
+    }
+    run_jobs(&compute_columns, jobs, nthreads);
+    free(jobs);
+    return 0;
+}
+
+static size_t format_identity(char *s, float identity)
+{
+    // Writes a tab then the identity to two decimal places; returns the number of bytes written
+    if (isnan(identity))
+    {
+        memcpy(s, "\tnan", 4);
+        return 4;
+    }
+    unsigned int x = identity * 100 + 0.5f;
+    char digits[8];
+    unsigned int ndigits = 0;
+    for (unsigned int q = x / 100; ndigits == 0 || q > 0; q /= 10)
+        digits[ndigits++] = '0' + q % 10;
+    size_t n = 0;
+    s[n++] = '\t';
+    while (ndigits > 0)
+        s[n++] = digits[--ndigits];
+    s[n++] = '.';
+    s[n++] = '0' + x / 10 % 10;
+    s[n++] = '0' + x % 10;
+    return n;
+}
+
+static void *format_rows(void *arg)
+{
+    // Formats the job's rows of the band as lines of TSV
+    IdentityJob *job = arg;
+    size_t ncols = job->codes->nrows;
+    job->text->len = 0;
+    for (size_t i = job->i_start; i < job->i_end; i++)
+    {
+        SeqRecord *record = job->records + job->start + i;
+        if (array_reserve(job->text, job->text->len + record->id_len + 8 * ncols + 1) != 0)
+        {
+            job->text->len = SIZE_MAX; // Marks the failure for the caller
+            return NULL;
+        }
+        char *s = job->text->data;
+        memcpy(s + job->text->len, record->id, record->id_len);
+        job->text->len += record->id_len;
+        const float *identities = job->identities + i * ncols;
+        for (size_t j = 0; j < ncols; j++)
+            job->text->len += format_identity(s + job->text->len, identities[j]);
+        s[job->text->len++] = '\n';
+    }
+    return NULL;
+}
+
+int identity_write(FILE *fp, SeqRecord *records, size_t nrecords, bool tsv, unsigned int nthreads)
+{
+    /* Return codes
+        0: success
+        <0: identity error code
+    */
+    int code = 0;
+    if (nthreads == 0)
+        nthreads = 1;
+    IdentityCodes codes;
+    float *identities = NULL;
+    IdentityJob *jobs = NULL;
+    Array *texts = NULL;
+    if ((code = identity_encode(&codes, records, nrecords)) != 0)
+        return code;
+    if (nrecords > SIZE_MAX / sizeof(float) / IDENTITY_BLOCK_NROWS)
+    {
+        code = IDENTITY_ERROR_MEMORY_ALLOCATION;
+        goto cleanup;
+    }
+    identities = malloc(IDENTITY_BLOCK_NROWS * nrecords * sizeof(float) + 1); // Never 0 bytes
+    jobs = malloc(nthreads * sizeof(IdentityJob));
+    texts = calloc(nthreads, sizeof(Array));
+    if (identities == NULL || jobs == NULL || texts == NULL)
+    {
+        code = IDENTITY_ERROR_MEMORY_ALLOCATION;
+        goto cleanup;
+    }
+    for (unsigned int t = 0; t < nthreads; t++)
+    {
+        if (array_init(texts + t, sizeof(char)) != 0)
+        {
+            code = IDENTITY_ERROR_MEMORY_ALLOCATION;
+            goto cleanup;
+        }
+    }
+
+    // Header
+    if (tsv)
+    {
+        fputs("id", fp);
+        for (size_t j = 0; j < nrecords; j++)
+        {
+            fputc('\t', fp);
+            fwrite(records[j].id, 1, records[j].id_len, fp);
+        }
+        fputc('\n', fp);
+    }
+    else
+    {
+        uint64_t nrows = nrecords;
+        fwrite(IDENTITY_MAGIC, 1, sizeof(IDENTITY_MAGIC) - 1, fp);
+        fwrite(&nrows, sizeof(nrows), 1, fp);
+    }
+
+    // Rows are computed and written a band at a time, so memory stays proportional to the number of records
+    for (size_t start = 0; start < nrecords && !ferror(fp); start += IDENTITY_BLOCK_NROWS)
+    {
+        size_t nrows = (nrecords - start < IDENTITY_BLOCK_NROWS) ? nrecords - start : IDENTITY_BLOCK_NROWS;
+        if ((code = identity_compute_rows(&codes, start, nrows, identities, nthreads)) != 0)
+            goto cleanup;
+        if (!tsv)
+        {
+            fwrite(identities, sizeof(float), nrows * nrecords, fp);
+            continue;
+        }
+
+        // Formatting is as costly as comparing, so rows are split over threads too
+        for (unsigned int t = 0; t < nthreads; t++)
+        {
+            IdentityJob *job = jobs + t;
+            job->codes = &codes;
+            job->records = records;
+            job->start = start;
+            job->nrows = nrows;
+            job->i_start = nrows * t / nthreads;
+            job->i_end = nrows * (t + 1) / nthreads;
+            job->identities = identities;
+            job->text = texts + t;
+        }
+        run_jobs(&format_rows, jobs, nthreads);
+        for (unsigned int t = 0; t < nthreads; t++)
+        {
+            if (texts[t].len == SIZE_MAX)
+            {
+                code = IDENTITY_ERROR_MEMORY_ALLOCATION;
+                goto cleanup;
+            }
+            fwrite(texts[t].data, 1, texts[t].len, fp);
+        }
+    }
+    if (ferror(fp))
+        code = IDENTITY_ERROR_FILE_IO;
+
+cleanup:
+    for (unsigned int t = 0; t < nthreads && texts != NULL; t++)
+        array_free(texts + t);
+    free(texts);
+    free(jobs);
+    free(identities);
+    identity_free(&codes);
+    return code;
+}
@@ -0,0 +1,44 @@
+#ifndef IDENTITY_H
+#define IDENTITY_H
+
+/*
+ * Pairwise identities of records
+ *
+ * The identity of a pair is the percent of columns where both records have residues in which the residues are the
+ * same, ignoring case; it is NaN if no columns have residues in both. Records are encoded as bit planes, so a pair is
+ * compared 64 columns at a time. Matrices are written row by row: as TSV with record ids labeling rows and columns, or
+ * as binary with the 8 bytes of IDENTITY_MAGIC, the number of rows as a uint64_t, then rows of floats, all in the
+ * byte order of the host.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sequences.h"
+
+#define IDENTITY_MAGIC "AALVIDM1"
+#define IDENTITY_BLOCK_NROWS 64 // Rows compared against a block of as many rows at a time, so both stay in cache
+#define IDENTITY_PENDING -1.0f  // Marks identities not yet computed
+
+extern const int IDENTITY_ERROR_MEMORY_ALLOCATION;
+extern const int IDENTITY_ERROR_FILE_IO;
+
+typedef struct
+{
+    uint64_t *words; // Per row, nwords groups of a mask of residues followed by nplanes bit planes of their codes
+    size_t nrows;
+    size_t nwords;
+    unsigned int nplanes;
+} IdentityCodes;
+
+int identity_encode(IdentityCodes *codes, SeqRecord *records, size_t nrecords);
+void identity_free(IdentityCodes *codes);
+float identity_get_pair(const IdentityCodes *codes, size_t i, size_t j);
+int identity_compute_rows(const IdentityCodes *codes, size_t start, size_t nrows, float *identities,
+                          unsigned int nthreads);
+float identity_compare_records(SeqRecord *x, SeqRecord *y);
+int identity_write(FILE *fp, SeqRecord *records, size_t nrecords, bool tsv, unsigned int nthreads);
+
+#endif // IDENTITY_H
@@ -5,6 +5,7 @@
 #include <unistd.h>
 
 #include "array.h"
+#include "display.h"
 #include "input.h"
 #include "state.h"
 #include "terminal.h"
@@ -204,6 +205,18 @@ int input_parse_keys(Array *buffer, int *count, Command *cmd)
     case '-':
         *cmd = CMD_DECREASE_TICK_SPACING;
         break;
+    case 'P':
+        *cmd = CMD_TOGGLE_PROFILE;
+        break;
+    case '.':
+        *cmd = CMD_TOGGLE_DOTS;
+        break;
+    case 'I':
+        *cmd = CMD_TOGGLE_IDENTITIES;
+        break;
+    case 'O':
+        *cmd = CMD_TOGGLE_IDENTITY_SORT;
+        break;
     default:
         return 2;
     }
@@ -313,6 +326,18 @@ int input_execute_command(int count, Command cmd)
     case CMD_DECREASE_TICK_SPACING:
         input_decrease_tick_spacing();
         break;
+    case CMD_TOGGLE_PROFILE:
+        input_toggle_profile();
+        break;
+    case CMD_TOGGLE_DOTS:
+        input_toggle_dots();
+        break;
+    case CMD_TOGGLE_IDENTITIES:
+        input_toggle_identities();
+        break;
+    case CMD_TOGGLE_IDENTITY_SORT:
+        input_toggle_identity_sort();
+        break;
     }
 
     return 0;
@@ -340,6 +365,18 @@ void input_previous_file(void)
     state.refresh_window = true;
 }
 
+void input_answer_nonascii(char answer)
+{
+    // Declining returns to the previous file, or exits from the first as the prompt before the viewer starts does
+    if (answer == 'y' || answer == 'Y')
+        state.active_file->nonascii_confirmed = true;
+    else if (state.active_file_index == 0)
+        exit(0);
+    else
+        input_previous_file();
+    state.refresh_window = true;
+}
+
 void input_cursor_clamp(void)
 {
     FileState *active_file = state.active_file;
@@ -410,7 +447,7 @@ void input_move_right(size_t x)
     unsigned int sequence_pane_width = state_get_sequence_pane_width(&state);
 
     size_t record_index = active_file->cursor_record_i + active_file->offset_record;
-    SeqRecord record = active_file->records[record_index];
+    SeqRecord record = active_file->records[state_get_row_record(active_file, record_index)];
     size_t sequence_index = active_file->cursor_sequence_j + active_file->offset_sequence;
 
     // Snap to end
@@ -450,7 +487,7 @@ void input_move_left(size_t x)
         return;
 
     size_t record_index = active_file->cursor_record_i + active_file->offset_record;
-    SeqRecord record = active_file->records[record_index];
+    SeqRecord record = active_file->records[state_get_row_record(active_file, record_index)];
     size_t sequence_index = active_file->cursor_sequence_j + active_file->offset_sequence;
 
     // Snap to end
@@ -581,7 +618,7 @@ void input_move_line_end(void)
         return;
 
     size_t record_index = active_file->cursor_record_i + active_file->offset_record;
-    SeqRecord record = active_file->records[record_index];
+    SeqRecord record = active_file->records[state_get_row_record(active_file, record_index)];
     size_t sequence_index = active_file->cursor_sequence_j + active_file->offset_sequence;
     size_t x = (record.len > 0) ? record.len - 1 - sequence_index : 0;
     input_move_right(x);
@@ -737,3 +774,73 @@ void input_decrease_tick_spacing(void)
     FileState *active_file = state.active_file;
     state_set_tick_spacing(&state, active_file->tick_spacing - 1);
 }
+
+void input_toggle_profile(void)
+{
+    // The profile takes rows atop the ruler pane, so the pane grows and shrinks with it
+    // Only the rows the pane grew by are returned, as the height is clamped to the terminal
+    FileState *active_file = state.active_file;
+    unsigned int height = active_file->ruler_pane_height;
+    active_file->show_profile = !active_file->show_profile;
+    if (active_file->show_profile)
+    {
+        state_set_ruler_pane_height(&state, height + DISPLAY_PROFILE_HEIGHT);
+        unsigned int new_height = active_file->ruler_pane_height;
+        active_file->profile_height = (new_height > height) ? new_height - height : 0;
+    }
+    else
+    {
+        unsigned int profile_height = active_file->profile_height;
+        state_set_ruler_pane_height(&state, (height > profile_height) ? height - profile_height : 0);
+        active_file->profile_height = 0;
+    }
+    state.refresh_ruler_pane = true;
+}
+
+void input_toggle_dots(void)
+{
+    // The record under the cursor becomes the reference
+    FileState *active_file = state.active_file;
+    if (!active_file->show_dots)
+    {
+        if (active_file->nrecords == 0 || state_get_record_panes_height(&state) == 0)
+            return;
+        active_file->reference_index = state_get_cursor_record(&state);
+    }
+    active_file->show_dots = !active_file->show_dots;
+    state.refresh_header_pane = true;
+    state.refresh_sequence_pane = true;
+    state.refresh_command_pane = true;
+}
+
+void input_toggle_identities(void)
+{
+    // Identities are computed by the main loop as the column shows, and sorted rows are restored with it
+    FileState *active_file = state.active_file;
+    if (active_file->show_identities && active_file->sort_identities)
+        input_toggle_identity_sort();
+    active_file->show_identities = !active_file->show_identities;
+    state.refresh_header_pane = true;
+    state.refresh_command_pane = true;
+}
+
+void input_toggle_identity_sort(void)
+{
+    // Rows are sorted by the main loop once all identities are in, and unsorting keeps the cursor on its record
+    FileState *active_file = state.active_file;
+    if (active_file->sort_identities)
+    {
+        size_t record_index = state_get_cursor_record(&state);
+        active_file->sort_identities = false;
+        state_unsort_rows(active_file);
+        input_move_to_record(record_index);
+    }
+    else
+    {
+        active_file->sort_identities = true;
+        active_file->show_identities = true;
+    }
+    state.refresh_header_pane = true;
+    state.refresh_sequence_pane = true;
+    state.refresh_command_pane = true;
+}
@@ -23,6 +23,7 @@ int input_execute_command(int count, Command cmd);
 void input_buffer_flush(Array *buffer);
 void input_next_file(void);
 void input_previous_file(void);
+void input_answer_nonascii(char answer);
 void input_move_up(size_t x);
 void input_move_down(size_t x);
 void input_move_right(size_t x);
@@ -48,5 +49,9 @@ void input_increase_ruler_pane_height(void);
 void input_decrease_ruler_pane_height(void);
 void input_increase_tick_spacing(void);
 void input_decrease_tick_spacing(void);
+void input_toggle_profile(void);
+void input_toggle_dots(void);
+void input_toggle_identities(void);
+void input_toggle_identity_sort(void);
 
 #endif // INPUT_H
@@ -0,0 +1,600 @@
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "array.h"
+#include "fasta.h"
+#include "identity.h"
+#include "loader.h"
+#include "profile.h"
+#include "tiles.h"
+
+#define IDENTITY_BATCH_LEN 64 // Records compared between holds of the state lock
+
+typedef struct
+{
+    State *state;
+    FileState *file;
+    FILE *fp;
+    int (*record_reader)(FILE *, Arena *, SeqRecordCallback, void *);
+    Array records; // Backs file->records until loading finishes
+} Loader;
+
+typedef struct
+{
+    State *state;
+    LoaderJob job;
+    void *data;
+    unsigned int next_index; // Next file to load; guarded by state lock
+    unsigned int nthreads;   // Running threads; the last to exit frees the pool
+} LoaderPool;
+
+typedef struct
+{
+    State *state;
+    FileState *file;
+    unsigned int nthreads; // Threads to start, then running threads; the last to exit frees the builder
+    size_t max_size;
+    Tiles tiles;
+    size_t *nbands_claimed; // Per tile column; bands are claimed in order
+    size_t *nbands_filled;  // Per tile column
+    bool *chunks_claimed;
+    size_t next_tile_col; // Tile columns before are fully claimed
+    size_t next_chunk;    // Chunks before are claimed
+    size_t nchunks_done;
+} ProfileBuilder;
+
+typedef struct
+{
+    State *state;
+    FileState *file;
+} IdentityWorker;
+
+static int publish_record(SeqRecord *record, void *data)
+{
+    Loader *loader = data;
+    State *state = loader->state;
+    FileState *file = loader->file;
+
+    // Typing is the costliest step, so it runs before taking the lock
+    int type_code = sequences_assign_seq_type(record, file->forced_type, file->nucleic_tiebreak_len,
+                                              file->type_sample_len);
+
+    // Residues are packed in place, and seq is the arena's latest allocation, so the arena can take back the rest
+    size_t packed_size;
+    if (file->pack && sequences_pack_seq(record, &packed_size) == 0)
+        record->seq = arena_shrink(&file->arena, record->seq, packed_size);
+
+    pthread_mutex_lock(&state->lock);
+    if (loader->records.len >= INT_MAX - 1 || array_append(&loader->records, record) != 0)
+    {
+        pthread_mutex_unlock(&state->lock);
+        return FASTA_ERROR_RECORD_OVERFLOW;
+    }
+    size_t record_index = loader->records.len - 1;
+    file->records = loader->records.data; // Appends may move the array
+    file->nrecords = loader->records.len;
+    if (record->len > file->records_maxlen)
+        file->records_maxlen = record->len;
+    if (type_code >= 2)
+        file->nonascii = true;
+    if (file == state->active_file)
+    {
+        // Following continues while the view is where it was last scrolled or the previous record is in view
+        unsigned int record_panes_height = state_get_record_panes_height(state);
+        if (file->follow && record_panes_height > 0 && record_index >= file->offset_record + record_panes_height &&
+            (file->offset_record == file->follow_offset || record_index <= file->offset_record + record_panes_height))
+        {
+            state_set_offset_record(state, record_index - record_panes_height + 1);
+            file->follow_offset = file->offset_record;
+        }
+        else if (record_index >= file->offset_record && record_index - file->offset_record < record_panes_height)
+        {
+            state->refresh_header_pane = true;
+            state->refresh_sequence_pane = true;
+        }
+    }
+    pthread_cond_broadcast(&state->loaded);
+    state_wake(state);
+    pthread_mutex_unlock(&state->lock);
+
+    return 0;
+}
+
+static void *load_records(void *arg)
+{
+    Loader *loader = arg;
+    State *state = loader->state;
+    FileState *file = loader->file;
+
+    int code = loader->record_reader(loader->fp, &file->arena, &publish_record, loader);
+    if (loader->fp != stdin)
+        fclose(loader->fp);
+
+    pthread_mutex_lock(&state->lock);
+    array_shrink(&loader->records); // Failure only leaves excess capacity
+    file->records = loader->records.data;
+    file->loader_code = code;
+    file->loading = false;
+    state->nworkers--;
+    pthread_cond_broadcast(&state->loaded);
+    state_wake(state);
+    pthread_mutex_unlock(&state->lock);
+
+    free(loader);
+    return NULL;
+}
+
+int loader_start(State *state, FileState *file, FILE *fp, int (*record_reader)(FILE *, Arena *, SeqRecordCallback, void *))
+{
+    Loader *loader = malloc(sizeof(Loader));
+    if (loader == NULL)
+        return 1;
+    loader->state = state;
+    loader->file = file;
+    loader->fp = fp;
+    loader->record_reader = record_reader;
+    if (array_init(&loader->records, sizeof(SeqRecord)) != 0)
+    {
+        free(loader);
+        return 1;
+    }
+
+    pthread_mutex_lock(&state->lock);
+    file->loading = true;
+    file->loader_code = 0;
+    state->nworkers++;
+    pthread_mutex_unlock(&state->lock);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, &load_records, loader) != 0)
+    {
+        pthread_mutex_lock(&state->lock);
+        state->nworkers--;
+        pthread_mutex_unlock(&state->lock);
+        array_free(&loader->records);
+        free(loader);
+        return 1;
+    }
+    pthread_detach(thread);
+
+    return 0;
+}
+
+static void *run_pool(void *arg)
+{
+    LoaderPool *pool = arg;
+    State *state = pool->state;
+
+    while (1)
+    {
+        pthread_mutex_lock(&state->lock);
+        if (pool->next_index >= state->nfiles)
+        {
+            bool last = --pool->nthreads == 0;
+            state->nworkers--;
+            pthread_mutex_unlock(&state->lock);
+            if (last)
+                free(pool);
+            return NULL;
+        }
+        unsigned int file_index = pool->next_index++; // Claimed in order, so earlier files are ready first
+        pthread_mutex_unlock(&state->lock);
+
+        pool->job(state, file_index, pool->data);
+    }
+}
+
+int loader_start_pool(State *state, unsigned int nthreads, LoaderJob job, void *data)
+{
+    LoaderPool *pool = malloc(sizeof(LoaderPool));
+    if (pool == NULL)
+        return 1;
+    pool->state = state;
+    pool->job = job;
+    pool->data = data;
+    pool->next_index = 0;
+    pool->nthreads = 0;
+
+    // Threads wait on the lock until all are started, so none can free the pool early
+    pthread_mutex_lock(&state->lock);
+    for (unsigned int i = 0; i < nthreads; i++)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, &run_pool, pool) != 0)
+            break;
+        pthread_detach(thread);
+        pool->nthreads++;
+        state->nworkers++;
+    }
+    bool started = pool->nthreads > 0;
+    pthread_mutex_unlock(&state->lock);
+    if (!started)
+        free(pool);
+
+    return started ? 0 : 1;
+}
+
+int loader_wait(State *state, FileState *file, size_t nrecords)
+{
+    /* Return codes
+        >=0: number of records loaded
+        <0: reader error code
+    */
+    pthread_mutex_lock(&state->lock);
+    while (file->loading && file->nrecords < nrecords)
+        pthread_cond_wait(&state->loaded, &state->lock);
+    int code = file->loader_code < 0 ? file->loader_code : (int)file->nrecords;
+    pthread_mutex_unlock(&state->lock);
+
+    return code;
+}
+
+static bool claim_chunk_work(ProfileBuilder *builder, size_t chunk, size_t *tile_col, size_t *band)
+{
+    // Claims the chunk if its tile column is filled, else the next tile it needs; returns false if neither is free
+    if (builder->chunks_claimed[chunk])
+        return false;
+    *tile_col = chunk * PROFILE_CHUNK_NCOLS / TILES_NCOLS;
+    if (builder->nbands_filled[*tile_col] == builder->tiles.nbands)
+    {
+        builder->chunks_claimed[chunk] = true;
+        *band = SIZE_MAX;
+        return true;
+    }
+    if (builder->nbands_claimed[*tile_col] < builder->tiles.nbands)
+    {
+        *band = builder->nbands_claimed[*tile_col]++;
+        return true;
+    }
+    return false;
+}
+
+static bool claim_work(ProfileBuilder *builder, size_t *chunk, size_t *tile_col, size_t *band)
+{
+    /* Claims a chunk to count or, if band is set to other than SIZE_MAX, a tile to fill; returns false if no work is
+       free. Work for visible columns is claimed first. */
+    State *state = builder->state;
+    FileState *file = builder->file;
+    Profile *profile = &file->profile;
+    if (file == state->active_file && file->show_profile)
+    {
+        size_t start = file->offset_sequence;
+        size_t end = start + state_get_sequence_pane_width(state);
+        if (end > profile->ncols)
+            end = profile->ncols;
+        for (*chunk = start / PROFILE_CHUNK_NCOLS; *chunk * PROFILE_CHUNK_NCOLS < end; (*chunk)++)
+        {
+            if (claim_chunk_work(builder, *chunk, tile_col, band))
+                return true;
+        }
+    }
+
+    while (builder->next_chunk < profile->nchunks && builder->chunks_claimed[builder->next_chunk])
+        builder->next_chunk++;
+    *chunk = builder->next_chunk;
+    if (*chunk < profile->nchunks && claim_chunk_work(builder, *chunk, tile_col, band))
+        return true;
+    while (builder->next_tile_col < builder->tiles.ntile_cols &&
+           builder->nbands_claimed[builder->next_tile_col] == builder->tiles.nbands)
+        builder->next_tile_col++;
+    if (builder->next_tile_col < builder->tiles.ntile_cols)
+    {
+        *tile_col = builder->next_tile_col;
+        *band = builder->nbands_claimed[*tile_col]++;
+        return true;
+    }
+    return false;
+}
+
+static void *run_profile_builder(void *arg)
+{
+    ProfileBuilder *builder = arg;
+    State *state = builder->state;
+    FileState *file = builder->file;
+    Profile *profile = &file->profile;
+
+    pthread_mutex_lock(&state->lock);
+    while (builder->nchunks_done < profile->nchunks)
+    {
+        size_t chunk, tile_col, band;
+        if (!claim_work(builder, &chunk, &tile_col, &band))
+        {
+            pthread_cond_wait(&state->loaded, &state->lock); // Remaining work waits on tiles others are filling
+            continue;
+        }
+        pthread_mutex_unlock(&state->lock);
+
+        // Tiles and chunks are written by one thread each, so the work runs outside the lock
+        if (band != SIZE_MAX)
+            tiles_fill_tile(&builder->tiles, band, tile_col, file->records + band * TILES_NROWS);
+        else
+            profile_count_chunk(profile, &builder->tiles, chunk);
+
+        pthread_mutex_lock(&state->lock);
+        if (band != SIZE_MAX)
+            builder->nbands_filled[tile_col]++;
+        else
+        {
+            profile->chunks_done[chunk] = true;
+            builder->nchunks_done++;
+            size_t start = chunk * PROFILE_CHUNK_NCOLS;
+            if (file == state->active_file && start < file->offset_sequence + state_get_sequence_pane_width(state) &&
+                start + PROFILE_CHUNK_NCOLS > file->offset_sequence)
+                state->refresh_ruler_pane = true;
+        }
+        pthread_cond_broadcast(&state->loaded);
+        state_wake(state);
+    }
+
+    bool last = --builder->nthreads == 0;
+    if (last)
+    {
+        file->profiling = false;
+        pthread_cond_broadcast(&state->loaded);
+        state_wake(state);
+    }
+    state->nworkers--;
+    pthread_mutex_unlock(&state->lock);
+    if (last)
+    {
+        tiles_free(&builder->tiles);
+        free(builder->nbands_claimed);
+        free(builder->nbands_filled);
+        free(builder->chunks_claimed);
+        free(builder);
+    }
+    return NULL;
+}
+
+static void *build_profile(void *arg)
+{
+    ProfileBuilder *builder = arg;
+    State *state = builder->state;
+    FileState *file = builder->file;
+
+    // Columns are counted over all records, so the profile waits for loading to finish
+    loader_wait(state, file, SIZE_MAX);
+    pthread_mutex_lock(&state->lock);
+    size_t nrows = file->nrecords;
+    size_t ncols = file->records_maxlen;
+    pthread_mutex_unlock(&state->lock);
+    Profile profile;
+    int code = 0;
+    if (profile_get_size(nrows, ncols) > builder->max_size)
+    {
+        code = PROFILE_ERROR_TOO_LARGE;
+        goto error;
+    }
+
+    // Records are prepared in bands under the lock, so the display is never held up for long
+    bool nucleic = true;
+    for (size_t i = 0; i < nrows; i += TILES_NROWS)
+    {
+        pthread_mutex_lock(&state->lock);
+        for (size_t j = i; j < nrows && j < i + TILES_NROWS; j++)
+        {
+            state_prepare_record(file, j);
+            SeqType type = file->records[j].type;
+            if (type != SEQ_TYPE_NUCLEIC && type != SEQ_TYPE_INDETERMINATE)
+                nucleic = false;
+        }
+        pthread_mutex_unlock(&state->lock);
+    }
+
+    float max_entropy = nucleic ? PROFILE_NUCLEIC_MAX_ENTROPY : PROFILE_PROTEIN_MAX_ENTROPY;
+    if (profile_init(&profile, nrows, ncols, max_entropy) != 0)
+    {
+        code = PROFILE_ERROR_MEMORY_ALLOCATION;
+        goto error;
+    }
+    if (tiles_init(&builder->tiles, nrows, ncols) != 0)
+    {
+        profile_free(&profile);
+        code = PROFILE_ERROR_MEMORY_ALLOCATION;
+        goto error;
+    }
+    size_t ntile_cols = builder->tiles.ntile_cols;
+    builder->nbands_claimed = calloc(ntile_cols, sizeof(size_t));
+    builder->nbands_filled = calloc(ntile_cols, sizeof(size_t));
+    builder->chunks_claimed = calloc(profile.nchunks, sizeof(bool));
+    if ((ntile_cols > 0 && (builder->nbands_claimed == NULL || builder->nbands_filled == NULL)) ||
+        (profile.nchunks > 0 && builder->chunks_claimed == NULL))
+    {
+        free(builder->nbands_claimed);
+        free(builder->nbands_filled);
+        free(builder->chunks_claimed);
+        tiles_free(&builder->tiles);
+        profile_free(&profile);
+        code = PROFILE_ERROR_MEMORY_ALLOCATION;
+        goto error;
+    }
+    builder->next_tile_col = 0;
+    builder->next_chunk = 0;
+    builder->nchunks_done = 0;
+
+    // Threads wait on the lock until all are started, so none can free the builder early
+    pthread_mutex_lock(&state->lock);
+    file->profile = profile;
+    unsigned int nthreads = builder->nthreads;
+    builder->nthreads = 1;
+    for (unsigned int i = 1; i < nthreads; i++)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, &run_profile_builder, builder) != 0)
+            break;
+        pthread_detach(thread);
+        builder->nthreads++;
+        state->nworkers++;
+    }
+    pthread_mutex_unlock(&state->lock);
+    return run_profile_builder(builder);
+
+error:
+    pthread_mutex_lock(&state->lock);
+    file->profile_code = code;
+    file->profiling = false;
+    state->nworkers--;
+    pthread_cond_broadcast(&state->loaded);
+    state_wake(state);
+    pthread_mutex_unlock(&state->lock);
+    free(builder);
+    return NULL;
+}
+
+int loader_start_profile(State *state, FileState *file, unsigned int nthreads, size_t max_size)
+{
+    ProfileBuilder *builder = malloc(sizeof(ProfileBuilder));
+    if (builder == NULL)
+        return 1;
+    builder->state = state;
+    builder->file = file;
+    builder->nthreads = (nthreads > 0) ? nthreads : 1;
+    builder->max_size = max_size;
+
+    pthread_mutex_lock(&state->lock);
+    file->profile_requested = true;
+    file->profiling = true;
+    file->profile_code = 0;
+    state->nworkers++;
+    pthread_mutex_unlock(&state->lock);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, &build_profile, builder) != 0)
+    {
+        pthread_mutex_lock(&state->lock);
+        state->nworkers--;
+        file->profiling = false;
+        file->profile_code = PROFILE_ERROR_MEMORY_ALLOCATION;
+        pthread_mutex_unlock(&state->lock);
+        free(builder);
+        return 1;
+    }
+    pthread_detach(thread);
+
+    return 0;
+}
+
+static size_t claim_identities(State *state, FileState *file, size_t *next_index, size_t *record_indices)
+{
+    // Claims pending records in view first, then in order from next_index; returns the number claimed
+    size_t n = 0;
+    if (file == state->active_file)
+    {
+        size_t end = file->offset_record + state_get_record_panes_height(state);
+        for (size_t row = file->offset_record; row < end && row < file->nrecords && n < IDENTITY_BATCH_LEN; row++)
+        {
+            size_t record_index = state_get_row_record(file, row);
+            if (file->identities[record_index] == IDENTITY_PENDING)
+                record_indices[n++] = record_index;
+        }
+    }
+    for (; *next_index < file->nrecords && n < IDENTITY_BATCH_LEN; (*next_index)++)
+    {
+        if (file->identities[*next_index] == IDENTITY_PENDING)
+            record_indices[n++] = *next_index;
+    }
+    return n;
+}
+
+static void *compute_identities(void *arg)
+{
+    IdentityWorker *worker = arg;
+    State *state = worker->state;
+    FileState *file = worker->file;
+    SeqRecord reference;
+    SeqRecord records[IDENTITY_BATCH_LEN];
+    size_t record_indices[IDENTITY_BATCH_LEN];
+    float identities[IDENTITY_BATCH_LEN];
+    size_t generation = 0;
+    size_t next_index = 0;
+    bool started = false;
+
+    pthread_mutex_lock(&state->lock);
+    while (file->nidentities_done < file->nrecords)
+    {
+        // A new reference restarts the scan; records are prepared under the lock so they are read without it
+        if (!started || generation != file->identity_generation)
+        {
+            started = true;
+            generation = file->identity_generation;
+            next_index = 0;
+            state_prepare_record(file, file->identity_reference);
+            reference = file->records[file->identity_reference];
+        }
+        size_t n = claim_identities(state, file, &next_index, record_indices);
+        if (n == 0)
+            break;
+        for (size_t k = 0; k < n; k++)
+        {
+            state_prepare_record(file, record_indices[k]);
+            records[k] = file->records[record_indices[k]];
+        }
+        pthread_mutex_unlock(&state->lock);
+
+        for (size_t k = 0; k < n; k++)
+            identities[k] = identity_compare_records(&reference, records + k);
+
+        pthread_mutex_lock(&state->lock);
+        if (generation != file->identity_generation)
+            continue;
+        for (size_t k = 0; k < n; k++)
+        {
+            if (file->identities[record_indices[k]] != IDENTITY_PENDING)
+                continue; // Claimed twice when in view and next in order
+            file->identities[record_indices[k]] = identities[k];
+            file->nidentities_done++;
+        }
+        if (file == state->active_file)
+            state->refresh_header_pane = true;
+        state_wake(state);
+    }
+    file->identifying = false;
+    if (file == state->active_file)
+        state->refresh_command_pane = true;
+    state->nworkers--;
+    state_wake(state);
+    pthread_mutex_unlock(&state->lock);
+
+    free(worker);
+    return NULL;
+}
+
+int loader_start_identities(State *state, FileState *file, size_t reference_index)
+{
+    // Marks identities pending for a new reference, which a running worker takes up at its next batch
+    pthread_mutex_lock(&state->lock);
+    if (file->identities == NULL && (file->identities = malloc(file->nrecords * sizeof(float) + 1)) == NULL)
+        goto error;
+    for (size_t i = 0; i < file->nrecords; i++)
+        file->identities[i] = IDENTITY_PENDING;
+    file->identity_reference = reference_index;
+    file->identity_generation++;
+    file->nidentities_done = 0;
+    if (file == state->active_file)
+        state->refresh_header_pane = true;
+    if (!file->identifying)
+    {
+        IdentityWorker *worker = malloc(sizeof(IdentityWorker));
+        if (worker == NULL)
+            goto error;
+        worker->state = state;
+        worker->file = file;
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, &compute_identities, worker) != 0)
+        {
+            free(worker);
+            goto error;
+        }
+        pthread_detach(thread);
+        file->identifying = true;
+        state->nworkers++;
+    }
+    pthread_mutex_unlock(&state->lock);
+    return 0;
+
+error:
+    file->identity_failed = true;
+    pthread_mutex_unlock(&state->lock);
+    return 1;
+}
@@ -0,0 +1,32 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+/*
+ * Background loading of records
+ *
+ * A loader appends records to a FileState on its own thread while the main loop runs, and a pool runs a load job for
+ * each file in order on a fixed number of threads. Until a file's loading flag clears, its records, nrecords,
+ * records_maxlen, and loader fields may only be accessed under the state lock.
+ *
+ * A profile builder counts a file's column profile once it has loaded. It copies records into tiles and counts chunks
+ * of columns from them on a number of threads, taking work for the columns in view first. Until a file's profiling
+ * flag clears, its profile fields may only be accessed under the state lock.
+ *
+ * An identity worker compares a file's records to its identity reference on its own thread, taking the records in
+ * view first. Identities are written and read under the state lock, and results for a replaced reference are dropped.
+ */
+
+#include <stdio.h>
+
+#include "sequences.h"
+#include "state.h"
+
+typedef void (*LoaderJob)(State *state, unsigned int file_index, void *data);
+
+int loader_start_pool(State *state, unsigned int nthreads, LoaderJob job, void *data);
+int loader_start(State *state, FileState *file, FILE *fp, int (*record_reader)(FILE *, Arena *, SeqRecordCallback, void *));
+int loader_wait(State *state, FileState *file, size_t nrecords);
+int loader_start_profile(State *state, FileState *file, unsigned int nthreads, size_t max_size);
+int loader_start_identities(State *state, FileState *file, size_t reference_index);
+
+#endif // LOADER_H
@@ -1,10 +1,14 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <locale.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/errno.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <curses.h>
@@ -12,10 +16,14 @@
 
 #include "argparse.h"
 #include "array.h"
+#include "bgzf.h"
+#include "cache.h"
 #include "display.h"
 #include "error.h"
 #include "fasta.h"
+#include "identity.h"
 #include "input.h"
+#include "loader.h"
 #include "rcparams.h"
 #include "schemes.h"
 #include "sequences.h"
@@ -27,15 +35,37 @@ const char *INVOCATION_NAME;
 
 State state;
 
+typedef struct
+{
+    FormatOption *format;
+    bool write_index;
+    bool write_cache;
+    int open_errno; // Set if the file failed to open
+} FileJob;
+
+FileJob *file_jobs;
+
 struct termios old_termios;
 struct termios raw_termios;
 bool raw_mode = false;
+bool frame_stats = false;
+volatile sig_atomic_t window_resized = 1; // Set on SIGWINCH, so the size is queried only when it may have changed
 
 void cleanup(void);
+bool confirm_nonascii(const char *file_path);
+bool has_string_capability(const char *name);
+void handle_sigwinch(int sig);
+int get_frame_timeout(const struct timespec *last_frame);
 int read_files(State *state,
                unsigned int n_positional_args, char **positional_args,
                unsigned int n_format_args, char **format_args,
-               unsigned int n_type_args, char **type_args);
+               unsigned int n_type_args, char **type_args,
+               bool write_index, bool write_cache, unsigned int njobs, bool follow, bool pack,
+               bool profile);
+int write_identities(State *state, const char *identity_path);
+const char *get_format_ext(const char *file_path, char *buffer, size_t size);
+void load_file(State *state, unsigned int file_index, void *data);
+void report_file(FileJob *job, FileState *file, char *buffer, size_t len);
 
 // --help option shows in given order (alphabetical except help and version)
 Option options[] = {
@@ -51,12 +81,49 @@ Option options[] = {
      "",
      OMIT,
      no_argument},
+    {"cache",
+     0,
+     "write caches of parsed records for input files read from disk; fresh caches are always used",
+     "",
+     LONG_NAME,
+     no_argument},
+    {"follow",
+     0,
+     "keep the newest record in view while piped input is loading",
+     "",
+     LONG_NAME,
+     no_argument},
     {"format",
      'f',
      "comma-separated list of format extensions for input files",
      "<fmt,...,fmt>",
      SHORT_NAME,
      required_argument},
+    {"frame-stats",
+     0,
+     "print the number of frames drawn and the bytes written to the terminal for them on exit",
+     "",
+     LONG_NAME,
+     no_argument},
+    {"identity",
+     0,
+     "write percent identities of all pairs of records in the first file to a path then exit; "
+     "TSV if the path ends in .tsv or is -, else binary",
+     "<path>",
+     LONG_NAME,
+     required_argument},
+    {"index",
+     0,
+     "write indices for input files read from disk; existing indices are always used",
+     "",
+     LONG_NAME,
+     no_argument},
+    {"jobs",
+     'j',
+     "number of files to load concurrently (default: number of processors)",
+     "<n>",
+     SHORT_NAME,
+     required_argument},
     {"list-formats",
      0,
      "list allowable formats and their recognized extensions then exit",
@@ -69,6 +136,18 @@ Option options[] = {
      "",
      OMIT,
      no_argument},
+    {"pack",
+     0,
+     "pack residues of piped input into 2 (nucleic) or 5 (protein) bits each and drop runs of gaps",
+     "",
+     LONG_NAME,
+     no_argument},
+    {"profile",
+     0,
+     "show conservation and consensus of columns in the ruler pane; toggled with P",
+     "",
+     LONG_NAME,
+     no_argument},
     {"type",
      't',
      "comma-separated list of sequence types for input files",
@@ -80,7 +159,8 @@ Option options[] = {
 #define NOPTIONS sizeof(options) / sizeof(Option)
 
 FormatOption format_options[] = {
-    {"FASTA", "fasta,fa,faa,fna,afa", &fasta_fread},
+    {"FASTA", "fasta,fa,faa,fna,afa", &fasta_fread, &fasta_fread_records, &fasta_mmap_read, &fasta_gz_read,
+     &fasta_index_read, &fasta_gz_index_read, &fasta_index_write, FASTA_INDEX_EXT},
     // CLUSTAL
     // PHYLIP
     // STOCKHOLM
@@ -114,6 +194,11 @@ int main(int argc, char *argv[])
 
     // Initializations
     int code = 0; // Generic return code for various functions
+    if (state_init_sync(&state) != 0)
+    {
+        fprintf(stderr, "%s: Failed to initialize state lock\n", INVOCATION_NAME);
+        return 1;
+    }
     atexit(&cleanup);
     if (sequences_init_base_alphabets() != 0)
     {
@@ -140,7 +225,7 @@ int main(int argc, char *argv[])
     state.types = types;
     state.ntypes = SEQ_TYPE_ERROR + 1;
 
-    // Get terminal color support
+    // Get terminal color and scrolling support
     state.ncolors = 1;
     int errret;
     if (setupterm(NULL, STDOUT_FILENO, &errret) == OK) // Need to set a return code address; otherwise error will cause exit
@@ -148,6 +233,9 @@ int main(int argc, char *argv[])
         int ncolors = tigetnum("colors");
         if (ncolors > 0)
             state.ncolors = ncolors;
+        state.scroll_rows = has_string_capability("csr") && has_string_capability("indn") &&
+                            has_string_capability("rin");
+        state.shift_columns = has_string_capability("dch") && has_string_capability("ich");
     }
 
     // Set color schemes
@@ -174,13 +262,22 @@ int main(int argc, char *argv[])
     char **format_args = NULL;
     unsigned int n_type_args = 0;
     char **type_args = NULL;
+    bool write_index = false;
+    bool write_cache = false;
+    unsigned int njobs = 0;
+    bool follow = false;
+    bool pack = false;
+    bool profile = false;
+    char *identity_path = NULL;
     code = parse_options(argc, argv,
                          NOPTIONS, options,
                          N_FORMAT_OPTIONS, format_options,
                          N_TYPE_OPTIONS, type_options,
                          short_options, long_options,
                          &n_format_args, &format_args,
-                         &n_type_args, &type_args);
+                         &n_type_args, &type_args,
+                         &write_index, &write_cache, &njobs, &follow, &pack,
+                         &profile, &identity_path, &frame_stats);
     free(short_options);
     if (code > 0) // "Expected" exit == 1 and "unexpected" exit > 1; shift -1 for CLI convention
         return code - 1;
@@ -202,7 +299,9 @@ int main(int argc, char *argv[])
         if (n_positional_args == 0)
             nfiles++; // If not a tty, treat stdin as an implicit first file
         input_fd = open("/dev/tty", O_RDONLY);
-        if (input_fd == -1)
+        if (input_fd == -1 && identity_path != NULL) // Commands are not read when only writing identities
+            input_fd = STDIN_FILENO;
+        else if (input_fd == -1)
         {
             error_printf("%s: Failed to open /dev/tty for reading commands\n", INVOCATION_NAME);
             return 1;
@@ -213,12 +312,18 @@ int main(int argc, char *argv[])
         input_fd = STDIN_FILENO;
 
     // Read files
-    FileState *files = malloc(nfiles * sizeof(FileState));
+    FileState *files = calloc(nfiles, sizeof(FileState)); // Zeroed so partially read files are safe to free
     if (files == NULL)
     {
         error_printf("%s: Failed to allocate memory to load files\n", INVOCATION_NAME);
         return 1;
     }
+    file_jobs = calloc(nfiles, sizeof(FileJob));
+    if (file_jobs == NULL)
+    {
+        error_printf("%s: Failed to allocate memory to load files\n", INVOCATION_NAME);
+        return 1;
+    }
     state.files = files;
     state.nfiles = nfiles;
     state.active_file = files;
@@ -227,7 +332,9 @@ int main(int argc, char *argv[])
     code = read_files(&state,
                       n_positional_args, positional_args,
                       n_format_args, format_args,
-                      n_type_args, type_args);
+                      n_type_args, type_args,
+                      write_index, write_cache, njobs, follow, pack,
+                      profile);
     if (code > 0)
         return code - 1;
 
@@ -236,6 +343,10 @@ int main(int argc, char *argv[])
     if (n_type_args > 0)
         str_free_split(type_args, n_type_args);
 
+    // Write identities instead of starting the viewer
+    if (identity_path != NULL)
+        return write_identities(&state, identity_path);
+
     // Set screen and terminal options
     if (terminal_get_termios(&old_termios) != 0)
     {
@@ -252,19 +363,78 @@ int main(int argc, char *argv[])
 
     setlocale(LC_ALL, ""); // Necessary for wcswidth calls
 
+    // Resizes wake the main loop through the state's pipe like background jobs
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = &handle_sigwinch;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGWINCH, &action, NULL);
+
     // Main loop
     int count;
     Command cmd;
+    long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int profile_nthreads = (nprocs > 0) ? nprocs : 1;
 
     Array input_buffer, output_buffer;
     array_init(&input_buffer, sizeof(char));
     array_init(&output_buffer, sizeof(char));
 
+    /* The loop sleeps in poll until keys, a resize, or a wake from a background job. Keys and resizes are drawn at
+       once, and background changes at most once per frame interval, so loading many records draws few frames. */
+    struct pollfd fds[2] = {{.fd = input_fd, .events = POLLIN}, {.fd = state.wake_fds[0], .events = POLLIN}};
+    struct timespec last_frame = {0, 0};
+    bool woken = true; // The first frame is drawn with the first wake
     while (1)
     {
-        input_read_key(&input_buffer, STDIN_FILENO);
+        if (poll(fds, 2, woken ? get_frame_timeout(&last_frame) : -1) < 0)
+        {
+            if (errno == EINTR)
+                continue; // Handlers write to the pipe, so the next poll returns at once
+            error_printf("%s: Failed to wait for input\n", INVOCATION_NAME);
+            exit(1);
+        }
+        bool keys = false;
+        if (fds[0].revents & POLLIN)
+            keys = input_read_key(&input_buffer, input_fd) > 0;
+        else if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+            exit(1); // The terminal is gone, so no commands can follow
+        if (fds[1].revents & POLLIN)
+        {
+            char wakes[64];
+            while (read(state.wake_fds[0], wakes, sizeof(wakes)) > 0)
+                ;
+            woken = true;
+        }
+        if (!keys && !window_resized && !(woken && get_frame_timeout(&last_frame) == 0))
+            continue;
+
+        pthread_mutex_lock(&state.lock); // Commands and displays read records that loaders may be appending
+        state.wake_pending = false;
+        if (window_resized)
+        {
+            window_resized = 0; // Cleared first, so a resize during the query is queried again
+            unsigned int rows, cols;
+            if (terminal_get_window_size(&rows, &cols) == 0 &&
+                (rows != state.terminal_rows || cols != state.terminal_cols))
+            {
+                state.terminal_rows = rows;
+                state.terminal_cols = cols;
+                state.refresh_window = true;
+            }
+        }
 
-        code = input_parse_keys(&input_buffer, &count, &cmd);
+        // Files found to hold non-ASCII symbols after the viewer started take keys as answers to their prompt
+        FileState *active_file = state.active_file;
+        if (keys && active_file->nonascii && !active_file->nonascii_confirmed)
+        {
+            input_answer_nonascii(*(char *)array_get(&input_buffer, 0));
+            input_buffer.len = 0;
+            code = 1;
+        }
+        else
+            code = keys ? input_parse_keys(&input_buffer, &count, &cmd) : 1;
         switch (code)
         {
         case 0:
@@ -278,19 +448,105 @@ int main(int argc, char *argv[])
             break;
         }
 
+        // Profiles are built the first time their files are shown with them
+        active_file = state.active_file;
+        if (active_file->show_profile && !active_file->profile_requested)
+            loader_start_profile(&state, active_file, profile_nthreads, rcparams_profile_max_size);
+
+        // Identities are cached until the cursor's record changes, and the reference stays fixed while rows are sorted
+        if (active_file->show_identities && !active_file->loading && !active_file->identity_failed &&
+            active_file->nrecords > 0)
+        {
+            size_t record_index = state_get_cursor_record(&state);
+            if (active_file->identities == NULL ||
+                (!active_file->sort_identities && record_index != active_file->identity_reference))
+                loader_start_identities(&state, active_file, record_index);
+            if (active_file->sort_identities && active_file->row_records == NULL &&
+                active_file->nidentities_done == active_file->nrecords)
+            {
+                if (state_sort_rows(active_file) != 0)
+                    active_file->sort_identities = false;
+                else
+                {
+                    active_file->cursor_record_i = 0; // The reference is sorted first
+                    state_set_offset_record(&state, 0);
+                }
+                state.refresh_header_pane = true;
+                state.refresh_sequence_pane = true;
+            }
+        }
+
         display_refresh(&output_buffer);
+        pthread_mutex_unlock(&state.lock);
         input_buffer_flush(&output_buffer);
+        clock_gettime(CLOCK_MONOTONIC, &last_frame);
+        woken = false;
+    }
+}
+
+bool confirm_nonascii(const char *file_path)
+{
+    printf("%s contains at least one non-ASCII symbol in its sequence(s). "
+           "The viewer may render incorrectly. Continue? (y/n): ",
+           file_path);
+    fflush(stdout);
+
+    // Read from the terminal since stdin may be an input file
+    char c, answer = '\0';
+    while (read(TERMINAL_FILENO, &c, 1) == 1 && c != '\n')
+    {
+        if (answer == '\0')
+            answer = c;
     }
+    return answer == 'y' || answer == 'Y';
+}
+
+bool has_string_capability(const char *name)
+{
+    // tigetstr takes a char * on some systems, though it does not modify it
+    char capname[8];
+    snprintf(capname, sizeof(capname), "%s", name);
+    char *capability = tigetstr(capname);
+    return capability != NULL && capability != (char *)-1;
+}
+
+void handle_sigwinch(int sig)
+{
+    (void)sig;
+    int saved_errno = errno;
+    window_resized = 1;
+    char c = 0;
+    ssize_t n = write(state.wake_fds[1], &c, 1); // A full pipe wakes the main loop all the same
+    (void)n;
+    errno = saved_errno;
+}
+
+int get_frame_timeout(const struct timespec *last_frame)
+{
+    // Returns the milliseconds until a frame may be drawn for background jobs
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long elapsed = (now.tv_sec - last_frame->tv_sec) * 1000 + (now.tv_nsec - last_frame->tv_nsec) / 1000000;
+    if (elapsed < 0 || elapsed >= (long)rcparams_frame_interval)
+        return 0;
+    return rcparams_frame_interval - elapsed;
 }
 
 void cleanup(void)
 {
+    // Held through exit so loaders cannot append to records as they are freed
+    pthread_mutex_lock(&state.lock);
+
     // Free memory
     for (unsigned int i = 0; i < state.n_color_schemes; i++)
         color_free_color_scheme(state.color_schemes + i);
     for (unsigned int i = 0; i < state.nfiles; i++)
-        sequences_free_seq_records(state.files[i].records, state.files[i].nrecords); // Null if unset, so always safe to free
-    free(state.files);
+    {
+        FileState *file = state.files + i;
+        if (file->loading || file->profiling || file->identifying)
+            continue; // Records are owned by the loader or read by background workers until they finish
+        state_free_file(file);
+    }
 
     // Restore terminal options
     if (raw_mode)
@@ -304,12 +560,60 @@ void cleanup(void)
     // Print error
     if (error_message[0] != '\0')
         fputs(error_message, stderr);
+
+    // Print frame statistics
+    if (frame_stats && raw_mode)
+    {
+        size_t nframes, nbytes, nbytes_frame;
+        display_get_frame_stats(&nframes, &nbytes, &nbytes_frame);
+        fprintf(stderr, "%s: %zu frames, %zu bytes written (%.1f bytes per frame, %zu in the last)\n", INVOCATION_NAME,
+                nframes, nbytes, (nframes > 0) ? (double)nbytes / nframes : 0.0, nbytes_frame);
+    }
+    display_free();
+
+    // Print errors of files loaded after the viewer started in file order
+    for (unsigned int i = 1; i < state.nfiles && raw_mode; i++)
+    {
+        FileState *file = state.files + i;
+        FileJob *job = file_jobs + i;
+        if (file->loading)
+            continue;
+        if (file->loader_code < 0)
+        {
+            char message[ERROR_MESSAGE_LEN];
+            report_file(job, file, message, sizeof(message));
+            fputs(message, stderr);
+        }
+        else
+        {
+            if (file->index_failed)
+                fprintf(stderr, "%s: %s%s: Failed to write index\n", INVOCATION_NAME, file->file_path, job->format->index_ext);
+            if (file->cache_failed)
+                fprintf(stderr, "%s: %s: Failed to write cache\n", INVOCATION_NAME, file->file_path);
+        }
+    }
+
+    if (state.nworkers == 0) // Otherwise left to the exit, since workers blocked on the lock still read them
+    {
+        free(file_jobs);
+        free(state.files);
+    }
+}
+
+void report_file(FileJob *job, FileState *file, char *buffer, size_t len)
+{
+    if (job->open_errno != 0)
+        snprintf(buffer, len, "%s: %s: %s\n", INVOCATION_NAME, file->file_path, strerror(job->open_errno));
+    else
+        snprintf(buffer, len, "%s: %s: Error processing file (code %d)\n", INVOCATION_NAME, file->file_path, file->loader_code);
 }
 
 int read_files(State *state,
                unsigned int n_positional_args, char **positional_args,
                unsigned int n_format_args, char **format_args,
-               unsigned int n_type_args, char **type_args)
+               unsigned int n_type_args, char **type_args,
+               bool write_index, bool write_cache, unsigned int njobs, bool follow, bool pack,
+               bool profile)
 {
     int code = 0;
 
@@ -353,10 +657,11 @@ int read_files(State *state,
         type_identifiers->len = str_split(&type_identifiers->data, type_option->identifiers, ',');
     }
 
-    // Main loop
+    // Resolve formats and types
     for (unsigned int file_index = 0; file_index < state->nfiles; file_index++)
     {
         const char *file_path, *file_ext;
+        char ext_buffer[32];
         if (!isatty(STDIN_FILENO) && n_positional_args == 0)
             file_path = "-";
         else
@@ -366,7 +671,7 @@ int read_files(State *state,
         char *format_arg = "";
         if (file_index < n_format_args)
             format_arg = format_args[file_index];
-        int (*reader)(FILE *, SeqRecord **) = NULL;
+        FormatOption *format = NULL;
 
         if (format_arg[0] != '\0') // From format argument
         {
@@ -376,7 +681,7 @@ int read_files(State *state,
                 StrArray *format_exts = formats_exts + i;
                 if (str_is_in((const char **)format_exts->data, format_exts->len, format_arg)) // Cast to silence warning
                 {
-                    reader = format_option->reader;
+                    format = format_option;
                     break;
                 }
                 error_printf("%s: %s: Error identifying format\n", INVOCATION_NAME, format_arg);
@@ -384,16 +689,15 @@ int read_files(State *state,
                 goto cleanup;
             }
         }
-        else if ((file_ext = strrchr(file_path, '.')) != NULL) // From path extension
+        else if ((file_ext = get_format_ext(file_path, ext_buffer, sizeof(ext_buffer))) != NULL) // From path extension
         {
-            file_ext++; // Exclude dot from comparison
             for (unsigned int i = 0; i < N_FORMAT_OPTIONS; i++)
             {
                 FormatOption *format_option = format_options + i;
                 StrArray *format_exts = formats_exts + i;
                 if (str_is_in((const char **)format_exts->data, format_exts->len, file_ext)) // Cast to silence warning
                 {
-                    reader = format_option->reader;
+                    format = format_option;
                     break;
                 }
                 error_printf("%s: %s: Unknown extension\n", INVOCATION_NAME, file_path);
@@ -408,83 +712,41 @@ int read_files(State *state,
             goto cleanup;
         }
 
-        // Read file
-        FILE *fp;
-        if (strcmp(file_path, "-") == 0)
-            fp = stdin;
-        else if ((fp = fopen(file_path, "r")) == NULL)
-        {
-            error_printf("%s: %s: %s\n", INVOCATION_NAME, file_path, strerror(errno));
-            code = 1;
-            goto cleanup;
-        }
-        SeqRecord *records = NULL;
-        int reader_code = reader(fp, &records);
-        if (reader_code < 0)
-        {
-            error_printf("%s: %s: Error processing file (code %d)\n", INVOCATION_NAME, file_path, reader_code);
-            code = 1;
-            goto cleanup;
-        }
-        unsigned int nrecords = reader_code;
-
-        // Get maxlen
-        size_t maxlen = 0;
-        for (unsigned int i = 0; i < nrecords; i++)
-        {
-            SeqRecord *record = records + i;
-            if (record->len > maxlen)
-                maxlen = record->len;
-        }
-
-        // Set sequence type
+        // Get forced type
         char *type_arg = "";
         if (file_index < n_type_args)
             type_arg = type_args[file_index];
-        for (unsigned int i = 0; i < nrecords; i++)
+        SeqType forced_type = SEQ_TYPE_UNSPECIFIED;
+        for (unsigned int j = 0; j < N_TYPE_OPTIONS && type_arg[0] != '\0'; j++)
         {
-            SeqRecord *record = records + i;
-            if (sequences_infer_seq_type(record) >= 2)
-            {
-                printf("%s contains at least one non-ASCII symbol in its sequence(s). "
-                       "The viewer may render incorrectly. Continue? (y/n): ",
-                       file_path);
-                int c = getchar();
-                if (c != 'y' && c != 'Y')
-                {
-                    code = 1;
-                    goto cleanup;
-                }
-                while ((c = getchar()) != '\n' && c != EOF)
-                    ; // Clear remaining input
-            };
-            if (type_arg[0] != '\0')
+            SeqTypeOption *type_option = type_options + j;
+            StrArray *type_identifiers = types_identifiers + j;
+            if (str_is_in((const char **)type_identifiers->data, type_identifiers->len, type_arg)) // Cast to silence warning
             {
-                for (unsigned int j = 0; j < N_TYPE_OPTIONS; j++)
-                {
-                    SeqTypeOption *type_option = type_options + j;
-                    StrArray *type_identifiers = types_identifiers + j;
-                    if (str_is_in((const char **)type_identifiers->data, type_identifiers->len, type_arg)) // Cast to silence warning
-                    {
-                        SeqType type = type_option->type;
-                        if (record->type != SEQ_TYPE_ERROR) // Allow forced type unless error
-                            record->type = type;
-                        break;
-                    }
-                }
+                forced_type = type_option->type;
+                break;
             }
-            else if (record->type == SEQ_TYPE_INDETERMINATE && record->len >= rcparams_nucleic_tiebreak_len)
-                record->type = SEQ_TYPE_NUCLEIC;
         }
 
+        FileJob *job = file_jobs + file_index;
+        job->format = format;
+        job->write_index = write_index;
+        job->write_cache = write_cache;
+
         FileState *file = state->files + file_index;
         file->file_path = file_path;
-        file->records = records;
-        file->nrecords = nrecords;
+        file->forced_type = forced_type;
+        file->nucleic_tiebreak_len = rcparams_nucleic_tiebreak_len;
+        file->type_sample_len = rcparams_type_sample_len;
+        file->loading = true; // Set before any loads start, so waits never see an unstarted file as loaded
+        file->follow = follow;
+        file->pack = pack;
         file->records_offset = 1;
-        file->records_maxlen = maxlen;
         file->header_pane_width = rcparams_header_pane_width;
         file->ruler_pane_height = rcparams_ruler_pane_height;
+        file->show_profile = profile;
+        file->profile_height = profile ? DISPLAY_PROFILE_HEIGHT : 0;
+        file->ruler_pane_height += file->profile_height;
         file->tick_spacing = rcparams_tick_spacing;
         file->offset_record = 0;
         file->offset_header = 0;
@@ -494,6 +756,53 @@ int read_files(State *state,
         file->cursor_sequence_j = 0;
     }
 
+    // Load files concurrently but report them in order as they finish
+    if (njobs == 0)
+    {
+        long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+        njobs = (nprocs > 0) ? nprocs : 1;
+    }
+    if (njobs > state->nfiles)
+        njobs = state->nfiles;
+    if (loader_start_pool(state, njobs, &load_file, file_jobs) != 0)
+    {
+        for (unsigned int i = 0; i < state->nfiles; i++)
+            load_file(state, i, file_jobs);
+    }
+
+    // Wait for a screenful of the first file so the first display is complete; the others are reported as viewed
+    FileState *file = state->files;
+    unsigned int rows, cols;
+    if (terminal_get_window_size(&rows, &cols) != 0 || rows == 0)
+        rows = 1; // Unsized terminals still wait for the first record or an error
+    loader_wait(state, file, rows);
+    pthread_mutex_lock(&state->lock);
+    int loader_code = file->loader_code;
+    bool nonascii = file->nonascii;
+    bool index_failed = file->index_failed;
+    bool cache_failed = file->cache_failed;
+    pthread_mutex_unlock(&state->lock);
+    if (loader_code < 0)
+    {
+        report_file(file_jobs, file, error_message, ERROR_MESSAGE_LEN);
+        code = 1;
+        goto cleanup;
+    }
+    if (index_failed)
+        fprintf(stderr, "%s: %s%s: Failed to write index\n", INVOCATION_NAME, file->file_path, file_jobs->format->index_ext);
+    if (cache_failed)
+        fprintf(stderr, "%s: %s: Failed to write cache\n", INVOCATION_NAME, file->file_path);
+
+    // Records found to be non-ASCII after the viewer starts are prompted for in the command pane instead
+    if (nonascii && !confirm_nonascii(file->file_path))
+    {
+        code = 1;
+        goto cleanup;
+    }
+    pthread_mutex_lock(&state->lock);
+    file->nonascii_confirmed = nonascii;
+    pthread_mutex_unlock(&state->lock);
+
 cleanup:
     for (unsigned int i = 0; i < N_FORMAT_OPTIONS; i++)
     {
@@ -513,3 +822,182 @@ cleanup:
     free(types_identifiers);
     return code;
 }
+
+int write_identities(State *state, const char *identity_path)
+{
+    // Identities are compared over all records, so the first file is waited on until it has loaded
+    FileState *file = state->files;
+    if (loader_wait(state, file, SIZE_MAX) < 0)
+    {
+        report_file(file_jobs, file, error_message, ERROR_MESSAGE_LEN);
+        return 1;
+    }
+    for (size_t i = 0; i < file->nrecords; i++)
+        state_prepare_record(file, i);
+    if (file->resolve_code < 0)
+    {
+        error_printf("%s: %s: Error reading records (code %d)\n", INVOCATION_NAME, file->file_path, file->resolve_code);
+        return 1;
+    }
+
+    bool to_stdout = strcmp(identity_path, "-") == 0;
+    const char *ext = strrchr(identity_path, '.');
+    bool tsv = to_stdout || (ext != NULL && strcmp(ext, ".tsv") == 0);
+    FILE *fp = to_stdout ? stdout : fopen(identity_path, "wb");
+    if (fp == NULL)
+    {
+        error_printf("%s: %s: %s\n", INVOCATION_NAME, identity_path, strerror(errno));
+        return 1;
+    }
+    long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+    int code = identity_write(fp, file->records, file->nrecords, tsv, (nprocs > 0) ? nprocs : 1);
+    if (fflush(fp) != 0 && code == 0)
+        code = IDENTITY_ERROR_FILE_IO;
+    if (!to_stdout && fclose(fp) != 0 && code == 0)
+        code = IDENTITY_ERROR_FILE_IO;
+    if (code == IDENTITY_ERROR_MEMORY_ALLOCATION)
+        error_printf("%s: Failed to allocate memory to compute identities\n", INVOCATION_NAME);
+    else if (code != 0)
+        error_printf("%s: %s: Failed to write identities\n", INVOCATION_NAME, identity_path);
+    return code != 0;
+}
+
+const char *get_format_ext(const char *file_path, char *buffer, size_t size)
+{
+    // Returns extension excluding dot, skipping a trailing compression extension
+    const char *file_ext = strrchr(file_path, '.');
+    if (file_ext == NULL)
+        return NULL;
+    if (strcmp(file_ext, ".gz") != 0 && strcmp(file_ext, ".bgz") != 0)
+        return file_ext + 1;
+    const char *compression_ext = file_ext;
+    for (file_ext = compression_ext; file_ext > file_path && file_ext[-1] != '.' && file_ext[-1] != '/'; file_ext--)
+        ;
+    if (file_ext == file_path || file_ext[-1] != '.' || (size_t)(compression_ext - file_ext) >= size)
+        return compression_ext + 1; // Reported as unknown
+    memcpy(buffer, file_ext, compression_ext - file_ext);
+    buffer[compression_ext - file_ext] = '\0';
+    return buffer;
+}
+
+void load_file(State *state, unsigned int file_index, void *data)
+{
+    FileJob *job = (FileJob *)data + file_index;
+    FileState *file = state->files + file_index;
+    FormatOption *format = job->format;
+    const char *file_path = file->file_path;
+
+    // Read file
+    SeqRecord *records = NULL;
+    FastaMap map = {.data = NULL, .len = 0, .index = NULL, .bgzf = NULL, .allocated = false};
+    bool indexed = false, cached = false, index_failed = false, cache_failed = false;
+    CacheInfo cache_info = {.forced_type = file->forced_type,
+                            .nucleic_tiebreak_len = file->nucleic_tiebreak_len,
+                            .type_sample_len = file->type_sample_len};
+    int open_errno = 0;
+    int reader_code;
+    struct stat sb;
+    FILE *fp;
+    if (strcmp(file_path, "-") == 0)
+        fp = stdin;
+    else if ((fp = fopen(file_path, "r")) == NULL)
+        open_errno = errno;
+    bool regular = fp != NULL && fstat(fileno(fp), &sb) == 0 && S_ISREG(sb.st_mode);
+    bool cacheable = regular && fp != stdin; // Caches are keyed by path
+    if (fp == NULL)
+        reader_code = FASTA_ERROR_FILE_IO;
+    else if (cacheable && (reader_code = cache_read(file_path, &sb, &cache_info, &map, &records)) > 0) // Skip parsing
+        cached = true;
+    else if (format->mapped_reader != NULL && regular) // Map seekable inputs
+    {
+        // Compressed files are detected by content since extensions are optional
+        unsigned char magic[2];
+        int (*mapped_reader)(int, FastaMap *, SeqRecord **) = format->mapped_reader;
+        int (*indexed_reader)(const char *, int, FastaMap *, SeqRecord **) = format->indexed_reader;
+        if (pread(fileno(fp), magic, sizeof(magic), 0) == sizeof(magic) && bgzf_is_gzip(magic, sizeof(magic)))
+        {
+            mapped_reader = format->compressed_reader;
+            indexed_reader = format->compressed_indexed_reader;
+        }
+
+        char *index_path = NULL;
+        if (format->index_ext != NULL && fp != stdin)
+        {
+            size_t path_len = strlen(file_path);
+            size_t ext_len = strlen(format->index_ext);
+            if ((index_path = malloc(path_len + ext_len + 1)) != NULL)
+            {
+                memcpy(index_path, file_path, path_len);
+                memcpy(index_path + path_len, format->index_ext, ext_len + 1);
+            }
+        }
+        reader_code = FASTA_ERROR_INVALID_FORMAT;
+        if (index_path != NULL && indexed_reader != NULL && !job->write_cache) // Caches need types from a full read
+        {
+            reader_code = indexed_reader(index_path, fileno(fp), &map, &records);
+            indexed = reader_code > 0;
+        }
+        if (!indexed && mapped_reader != NULL) // Missing or stale indices are re-built by reading the whole file
+        {
+            reader_code = mapped_reader(fileno(fp), &map, &records);
+            if (job->write_index && index_path != NULL && format->index_writer != NULL && reader_code > 0 &&
+                format->index_writer(index_path, &map, records, reader_code) != 0)
+                index_failed = true;
+        }
+        free(index_path);
+    }
+    else if (format->record_reader != NULL) // Stream other inputs as they are parsed
+    {
+        if (loader_start(state, file, fp, format->record_reader) == 0)
+            return;
+        reader_code = FASTA_ERROR_MEMORY_ALLOCATION;
+    }
+    else
+        reader_code = format->reader(fp, &file->arena, &records);
+    if (fp != NULL && fp != stdin)
+        fclose(fp);
+
+    // Get maxlen and set sequence type; indexed records are instead typed as they are displayed
+    size_t maxlen = cache_info.maxlen;
+    bool nonascii = cache_info.nonascii;
+    for (int i = 0; i < reader_code && !cached; i++)
+    {
+        SeqRecord *record = records + i;
+        if (record->len > maxlen)
+            maxlen = record->len;
+        if (!indexed &&
+            sequences_assign_seq_type(record, file->forced_type, file->nucleic_tiebreak_len, file->type_sample_len) >= 2)
+            nonascii = true;
+    }
+
+    if (job->write_cache && cacheable && !cached && !indexed && reader_code > 0)
+    {
+        cache_info.maxlen = maxlen;
+        cache_info.nonascii = nonascii;
+        cache_failed = cache_write(file_path, &sb, &cache_info, records, reader_code) != 0;
+    }
+
+    // Publish records
+    pthread_mutex_lock(&state->lock);
+    job->open_errno = open_errno;
+    file->index_failed = index_failed;
+    file->cache_failed = cache_failed;
+    if (reader_code >= 0)
+    {
+        file->records = records;
+        file->nrecords = reader_code;
+        file->map = map;
+        file->records_maxlen = maxlen;
+    }
+    file->nonascii = nonascii;
+    file->loader_code = reader_code;
+    file->loading = false;
+    if (file == state->active_file)
+    {
+        state->refresh_header_pane = true;
+        state->refresh_sequence_pane = true;
+    }
+    pthread_cond_broadcast(&state->loaded);
+    state_wake(state);
+    pthread_mutex_unlock(&state->lock);
+}
@@ -0,0 +1,135 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile.h"
+
+const int PROFILE_ERROR_MEMORY_ALLOCATION = -1;
+const int PROFILE_ERROR_TOO_LARGE = -2;
+
+// Bytes per column of a profile's arrays
+#define COLUMN_SIZE (PROFILE_NCLASSES * sizeof(uint32_t) + 3 * sizeof(float) + sizeof(char))
+
+int profile_init(Profile *profile, size_t nrows, size_t ncols, float max_entropy)
+{
+    profile->nrows = nrows;
+    profile->ncols = ncols;
+    profile->nchunks = (ncols + PROFILE_CHUNK_NCOLS - 1) / PROFILE_CHUNK_NCOLS;
+    profile->max_entropy = max_entropy;
+    profile->counts = NULL;
+    profile->gap_fractions = NULL;
+    profile->entropies = NULL;
+    profile->conservations = NULL;
+    profile->consensus = NULL;
+    profile->chunks_done = NULL;
+    if (ncols == 0)
+        return 0;
+    if (ncols > SIZE_MAX / COLUMN_SIZE)
+        return PROFILE_ERROR_MEMORY_ALLOCATION;
+
+    for (unsigned int c = 0; c < 256; c++)
+    {
+        if (c == 0)
+            profile->classes[c] = PROFILE_CLASS_EMPTY;
+        else if (c == '-' || c == '.')
+            profile->classes[c] = PROFILE_CLASS_GAP;
+        else if ('A' <= c && c <= 'Z')
+            profile->classes[c] = PROFILE_CLASS_A + (c - 'A');
+        else if ('a' <= c && c <= 'z')
+            profile->classes[c] = PROFILE_CLASS_A + (c - 'a');
+        else
+            profile->classes[c] = PROFILE_CLASS_OTHER;
+    }
+
+    if ((profile->counts = malloc(ncols * PROFILE_NCLASSES * sizeof(uint32_t))) == NULL ||
+        (profile->gap_fractions = malloc(ncols * sizeof(float))) == NULL ||
+        (profile->entropies = malloc(ncols * sizeof(float))) == NULL ||
+        (profile->conservations = malloc(ncols * sizeof(float))) == NULL ||
+        (profile->consensus = malloc(ncols)) == NULL ||
+        (profile->chunks_done = calloc(profile->nchunks, sizeof(bool))) == NULL)
+    {
+        profile_free(profile);
+        return PROFILE_ERROR_MEMORY_ALLOCATION;
+    }
+    return 0;
+}
+
+void profile_free(Profile *profile)
+{
+    free(profile->counts);
+    free(profile->gap_fractions);
+    free(profile->entropies);
+    free(profile->conservations);
+    free(profile->consensus);
+    free(profile->chunks_done);
+    profile->counts = NULL;
+    profile->gap_fractions = NULL;
+    profile->entropies = NULL;
+    profile->conservations = NULL;
+    profile->consensus = NULL;
+    profile->chunks_done = NULL;
+    profile->nchunks = 0;
+}
+
+size_t profile_get_size(size_t nrows, size_t ncols)
+{
+    // Returns the bytes needed to build a profile, including the tiles it is counted from, or SIZE_MAX on overflow
+    size_t nbands = (nrows + TILES_NROWS - 1) / TILES_NROWS;
+    size_t tile_ncols = (ncols + TILES_NCOLS - 1) / TILES_NCOLS * TILES_NCOLS;
+    if (tile_ncols > 0 && nbands > SIZE_MAX / TILES_NROWS / tile_ncols)
+        return SIZE_MAX;
+    size_t tiles_size = nbands * TILES_NROWS * tile_ncols;
+    if (ncols > (SIZE_MAX - tiles_size) / COLUMN_SIZE)
+        return SIZE_MAX;
+    return tiles_size + ncols * COLUMN_SIZE;
+}
+
+void profile_count_chunk(Profile *profile, const Tiles *tiles, size_t chunk)
+{
+    // Counts the chunk's columns from filled tiles and derives their statistics
+    if (chunk >= profile->nchunks)
+        return;
+    size_t start = chunk * PROFILE_CHUNK_NCOLS;
+    size_t ncols = profile->ncols - start;
+    if (ncols > PROFILE_CHUNK_NCOLS)
+        ncols = PROFILE_CHUNK_NCOLS;
+    uint32_t *counts = profile->counts + start * PROFILE_NCLASSES;
+    memset(counts, 0, ncols * PROFILE_NCLASSES * sizeof(uint32_t));
+    tiles_count_columns(tiles, start, ncols, profile->classes, PROFILE_NCLASSES, counts);
+
+    for (size_t j = 0; j < ncols; j++)
+    {
+        const uint32_t *column_counts = counts + j * PROFILE_NCLASSES;
+        uint32_t nresidues = column_counts[PROFILE_CLASS_OTHER];
+        unsigned int max_class = PROFILE_CLASS_EMPTY;
+        uint32_t max_count = 0;
+        for (unsigned int k = PROFILE_CLASS_A; k < PROFILE_CLASS_OTHER; k++)
+        {
+            nresidues += column_counts[k];
+            if (column_counts[k] > max_count) // Ties go to the earlier letter
+            {
+                max_class = k;
+                max_count = column_counts[k];
+            }
+        }
+
+        // Other symbols are pooled, so they add at most one symbol's worth of entropy
+        float entropy = 0;
+        for (unsigned int k = PROFILE_CLASS_A; k <= PROFILE_CLASS_OTHER && nresidues > 0; k++)
+        {
+            if (column_counts[k] == 0)
+                continue;
+            float p = (float)column_counts[k] / nresidues;
+            entropy -= p * log2f(p);
+        }
+        float residue_fraction = (profile->nrows > 0) ? (float)nresidues / profile->nrows : 0;
+        float conservation = (nresidues > 0) ? 1 - entropy / profile->max_entropy : 0;
+        if (conservation < 0)
+            conservation = 0;
+
+        profile->gap_fractions[start + j] = 1 - residue_fraction;
+        profile->entropies[start + j] = entropy;
+        profile->conservations[start + j] = conservation * residue_fraction;
+        profile->consensus[start + j] = (max_class == PROFILE_CLASS_EMPTY) ? '-' : 'A' + (max_class - PROFILE_CLASS_A);
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+/*
+ * Column profiles of alignments
+ *
+ * A profile holds each column's counts of residues and gaps and the statistics derived from them. Columns are counted
+ * from tiles a chunk at a time, so separate threads may count separate chunks, and a chunk's columns may only be read
+ * once it is marked done. Rows shorter than a column count as gaps in it.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tiles.h"
+
+#define PROFILE_NCLASSES 29 // Empty cells, gaps, letters case-folded from A to Z, and other symbols
+#define PROFILE_CLASS_EMPTY 0
+#define PROFILE_CLASS_GAP 1
+#define PROFILE_CLASS_A 2
+#define PROFILE_CLASS_OTHER 28
+#define PROFILE_CHUNK_NCOLS 256
+#define PROFILE_NUCLEIC_MAX_ENTROPY 2.0f
+#define PROFILE_PROTEIN_MAX_ENTROPY 4.321928f // log2(20)
+
+extern const int PROFILE_ERROR_MEMORY_ALLOCATION;
+extern const int PROFILE_ERROR_TOO_LARGE;
+
+typedef struct
+{
+    uint32_t *counts;     // PROFILE_NCLASSES per column
+    float *gap_fractions; // Fraction of rows without a residue
+    float *entropies;     // Shannon entropy of residues in bits
+    float *conservations; // One less entropy relative to max_entropy, scaled by the fraction of rows with residues
+    char *consensus;      // Most common letter, or '-' if the column has no letters
+    bool *chunks_done;
+    size_t nrows;
+    size_t ncols;
+    size_t nchunks;
+    float max_entropy; // Entropy of a column evenly split over the alphabet
+    unsigned char classes[256];
+} Profile;
+
+int profile_init(Profile *profile, size_t nrows, size_t ncols, float max_entropy);
+void profile_free(Profile *profile);
+size_t profile_get_size(size_t nrows, size_t ncols);
+void profile_count_chunk(Profile *profile, const Tiles *tiles, size_t chunk);
+
+#endif // PROFILE_H
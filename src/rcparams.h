@@ -9,5 +9,8 @@ unsigned int rcparams_header_pane_width = 30;
 unsigned int rcparams_ruler_pane_height = 5;
 unsigned int rcparams_tick_spacing = 10;
 unsigned int rcparams_nucleic_tiebreak_len = 10; // Threshold for when indeterminate sequences are called nucleic
+unsigned int rcparams_type_sample_len = 1 << 20;  // Threshold for when sequence types are inferred from a sample; 0 disables
+size_t rcparams_profile_max_size = (size_t)1 << 30; // Bytes beyond which column profiles are not built
+unsigned int rcparams_frame_interval = 16;           // Milliseconds between frames drawn for background jobs
 
 #endif // RCPARAMS_H
@@ -34,6 +34,7 @@ int schemes_init_base(void)
                 scheme->mask.bg[index] = true;
             }
         }
+        color_compile_color_scheme(scheme, alphabet->index_map);
         schemes_base[scheme_index] = *scheme;
         scheme_index++;
     }
@@ -62,6 +63,7 @@ int schemes_init_base(void)
                 scheme->mask.bg[index] = true;
             }
         }
+        color_compile_color_scheme(scheme, alphabet->index_map);
         schemes_base[scheme_index] = *scheme;
         scheme_index++;
     }
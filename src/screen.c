@@ -0,0 +1,539 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "screen.h"
+
+#define CSI_MAX_PARAMS 16
+#define MAX_REWRITE_LEN 4 // Unchanged cells rewritten rather than jumped over, since a jump takes at least 6 bytes
+
+const int SCREEN_ERROR_MEMORY_ALLOCATION = -1;
+
+static Cell make_blank(uint16_t fg, uint16_t bg)
+{
+    Cell cell;
+    memset(&cell, 0, sizeof(Cell)); // Cells are compared bytewise
+    cell.glyph[0] = ' ';
+    cell.fg = fg;
+    cell.bg = bg;
+    cell.len = 1;
+    cell.width = 1;
+    return cell;
+}
+
+static void fill_blank(Cell *cells, size_t n, uint16_t fg, uint16_t bg)
+{
+    Cell blank = make_blank(fg, bg);
+    for (size_t k = 0; k < n; k++)
+        cells[k] = blank;
+}
+
+int screen_init(Screen *screen, unsigned int rows, unsigned int cols)
+{
+    screen->front = NULL;
+    screen->back = NULL;
+    screen->rows = 0;
+    screen->cols = 0;
+    screen->i = 0;
+    screen->j = 0;
+    screen->fg = SCREEN_COLOR_DEFAULT;
+    screen->bg = SCREEN_COLOR_DEFAULT;
+    screen->cursor_visible = true;
+    screen->out_i = UINT_MAX;
+    screen->out_j = 0;
+    screen->out_fg = SCREEN_COLOR_DEFAULT;
+    screen->out_bg = SCREEN_COLOR_DEFAULT;
+    screen->out_cursor_visible = true;
+    screen->nframes = 0;
+    screen->nbytes = 0;
+    screen->nbytes_frame = 0;
+    screen->nbytes_pending = 0;
+    return screen_resize(screen, rows, cols);
+}
+
+void screen_free(Screen *screen)
+{
+    free(screen->front);
+    free(screen->back);
+    screen->front = NULL;
+    screen->back = NULL;
+    screen->rows = 0;
+    screen->cols = 0;
+}
+
+int screen_resize(Screen *screen, unsigned int rows, unsigned int cols)
+{
+    // Terminals differ in how they reflow on resizes, so both grids are blanked and the terminal is cleared
+    size_t n = (size_t)rows * cols;
+    if (n > SIZE_MAX / sizeof(Cell) - 1)
+        return SCREEN_ERROR_MEMORY_ALLOCATION;
+    Cell *front = malloc(n * sizeof(Cell) + 1); // Never 0 bytes
+    Cell *back = malloc(n * sizeof(Cell) + 1);
+    if (front == NULL || back == NULL)
+    {
+        free(front);
+        free(back);
+        return SCREEN_ERROR_MEMORY_ALLOCATION;
+    }
+    free(screen->front);
+    free(screen->back);
+    screen->front = front;
+    screen->back = back;
+    screen->rows = rows;
+    screen->cols = cols;
+    fill_blank(front, n, SCREEN_COLOR_DEFAULT, SCREEN_COLOR_DEFAULT);
+    fill_blank(back, n, SCREEN_COLOR_DEFAULT, SCREEN_COLOR_DEFAULT);
+    screen->i = 0;
+    screen->j = 0;
+    screen->clear_pending = true;
+    return 0;
+}
+
+// Interpretation
+static void erase(Screen *screen, unsigned int i, unsigned int start, unsigned int end)
+{
+    // Blanks cells from start to end in the current colors, including any halves of wide characters cut off
+    if (i >= screen->rows || start >= end)
+        return;
+    Cell *row = screen->back + (size_t)i * screen->cols;
+    if (start > 0 && row[start].len == 0)
+        start--;
+    if (end < screen->cols && row[end].len == 0)
+        end++;
+    fill_blank(row + start, end - start, screen->fg, screen->bg);
+}
+
+static void put_glyph(Screen *screen, const char *glyph, unsigned int len, unsigned int width)
+{
+    // Glyphs past the last column wrap, and those past the last row are dropped since panes never scroll
+    if (width == 0) // Combining characters join the previous cell if they fit
+    {
+        if (screen->i < screen->rows && screen->j > 0)
+        {
+            Cell *cell = screen->back + (size_t)screen->i * screen->cols + screen->j - 1;
+            if (cell->len == 0 && screen->j > 1)
+                cell--;
+            if (cell->len + len <= SCREEN_GLYPH_SIZE)
+            {
+                memcpy(cell->glyph + cell->len, glyph, len);
+                cell->len += len;
+            }
+        }
+        return;
+    }
+    if (screen->j + width > screen->cols)
+    {
+        screen->i++;
+        screen->j = 0;
+    }
+    if (screen->i >= screen->rows || width > screen->cols)
+    {
+        screen->j += width;
+        return;
+    }
+    erase(screen, screen->i, screen->j, screen->j + width); // Clears halves of wide characters overwritten
+    Cell *cell = screen->back + (size_t)screen->i * screen->cols + screen->j;
+    memset(cell->glyph, 0, SCREEN_GLYPH_SIZE);
+    memcpy(cell->glyph, glyph, len);
+    cell->fg = screen->fg;
+    cell->bg = screen->bg;
+    cell->len = len;
+    cell->width = width;
+    if (width == 2)
+    {
+        cell[1] = *cell;
+        memset(cell[1].glyph, 0, SCREEN_GLYPH_SIZE);
+        cell[1].len = 0;
+        cell[1].width = 0;
+    }
+    screen->j += width;
+}
+
+static void render_sgr(Screen *screen, const unsigned int *params, unsigned int nparams)
+{
+    for (unsigned int k = 0; k < nparams; k++)
+    {
+        unsigned int p = params[k];
+        if (p == 0)
+        {
+            screen->fg = SCREEN_COLOR_DEFAULT;
+            screen->bg = SCREEN_COLOR_DEFAULT;
+        }
+        else if ((30 <= p && p <= 37) || (90 <= p && p <= 97))
+            screen->fg = SCREEN_COLOR_4_BIT | p;
+        else if ((40 <= p && p <= 47) || (100 <= p && p <= 107))
+            screen->bg = SCREEN_COLOR_4_BIT | p;
+        else if (p == 39)
+            screen->fg = SCREEN_COLOR_DEFAULT;
+        else if (p == 49)
+            screen->bg = SCREEN_COLOR_DEFAULT;
+        else if ((p == 38 || p == 48) && k + 2 < nparams && params[k + 1] == 5)
+        {
+            uint16_t color = SCREEN_COLOR_8_BIT | (params[k + 2] & 0xFF);
+            if (p == 38)
+                screen->fg = color;
+            else
+                screen->bg = color;
+            k += 2;
+        }
+    }
+}
+
+static size_t render_csi(Screen *screen, const char *data, size_t len)
+{
+    // Interprets a control sequence following ESC [; returns the bytes consumed
+    unsigned int params[CSI_MAX_PARAMS];
+    unsigned int nparams = 0;
+    unsigned int value = 0;
+    bool private = false;
+    size_t k = 0;
+    if (k < len && data[k] == '?')
+    {
+        private = true;
+        k++;
+    }
+    for (; k < len; k++)
+    {
+        char c = data[k];
+        if ('0' <= c && c <= '9')
+            value = (value < UINT_MAX / 10) ? 10 * value + (c - '0') : value;
+        else if (c == ';')
+        {
+            if (nparams < CSI_MAX_PARAMS)
+                params[nparams++] = value;
+            value = 0;
+        }
+        else
+            break;
+    }
+    if (k == len) // Truncated sequences are dropped
+        return len;
+    if (nparams < CSI_MAX_PARAMS)
+        params[nparams++] = value;
+    char final = data[k++];
+
+    unsigned int n = (params[0] > 0) ? params[0] : 1;
+    unsigned int last_i = (screen->rows > 0) ? screen->rows - 1 : 0;
+    unsigned int last_j = (screen->cols > 0) ? screen->cols - 1 : 0;
+    if (screen->j > last_j && final != 'm' && final != 'h' && final != 'l')
+        screen->j = last_j; // Moves and erases cancel pending wraps
+    switch (final)
+    {
+    case 'H':
+        screen->i = (params[0] > 0) ? params[0] - 1 : 0;
+        screen->j = (nparams > 1 && params[1] > 0) ? params[1] - 1 : 0;
+        if (screen->i > last_i)
+            screen->i = last_i;
+        if (screen->j > last_j)
+            screen->j = last_j;
+        break;
+    case 'A':
+        screen->i = (n > screen->i) ? 0 : screen->i - n;
+        break;
+    case 'B':
+        screen->i = (n > last_i - screen->i) ? last_i : screen->i + n;
+        break;
+    case 'C':
+        screen->j = (n > last_j - screen->j) ? last_j : screen->j + n;
+        break;
+    case 'D':
+        screen->j = (n > screen->j) ? 0 : screen->j - n;
+        break;
+    case 'J':
+        if (params[0] == 0)
+            erase(screen, screen->i, screen->j, screen->cols);
+        else if (params[0] == 1)
+            erase(screen, screen->i, 0, screen->j + 1);
+        for (unsigned int i = 0; i < screen->rows; i++)
+        {
+            if (params[0] == 2 || (params[0] == 0 && i > screen->i) || (params[0] == 1 && i < screen->i))
+                erase(screen, i, 0, screen->cols);
+        }
+        break;
+    case 'K':
+        if (params[0] == 0)
+            erase(screen, screen->i, screen->j, screen->cols);
+        else if (params[0] == 1)
+            erase(screen, screen->i, 0, screen->j + 1);
+        else if (params[0] == 2)
+            erase(screen, screen->i, 0, screen->cols);
+        break;
+    case 'm':
+        render_sgr(screen, params, nparams);
+        break;
+    case 'h':
+    case 'l':
+        if (private && params[0] == 25)
+            screen->cursor_visible = final == 'h';
+        break;
+    }
+    return k;
+}
+
+void screen_render(Screen *screen, const char *data, size_t len)
+{
+    // Interprets the sequences panes write into the back grid
+    size_t k = 0;
+    while (k < len)
+    {
+        unsigned char c = data[k];
+        if (c == '\x1b')
+        {
+            if (k + 1 < len && data[k + 1] == '[')
+                k += 2 + render_csi(screen, data + k + 2, len - k - 2);
+            else
+                k++;
+            continue;
+        }
+        if (c < 0x20 || c == 0x7f)
+        {
+            if (c == '\n' && screen->i + 1 < screen->rows)
+                screen->i++;
+            else if (c == '\r')
+                screen->j = 0;
+            else if (c == '\b' && screen->j > 0)
+                screen->j -= (screen->j >= screen->cols && screen->j > 1) ? 2 : 1; // From a pending wrap, as xterm
+            k++;
+            continue;
+        }
+
+        // Invalid UTF-8 is kept bytewise, which terminals show as one replacement character each
+        unsigned int n = 1;
+        wchar_t wc = c;
+        if (0xc0 <= c && c < 0xf8)
+        {
+            n = (c < 0xe0) ? 2 : (c < 0xf0) ? 3 : 4;
+            wc = c & (0x7f >> n);
+            for (unsigned int m = 1; m < n; m++)
+            {
+                if (k + m >= len || ((unsigned char)data[k + m] & 0xc0) != 0x80)
+                {
+                    n = 1;
+                    break;
+                }
+                wc = (wc << 6) | ((unsigned char)data[k + m] & 0x3f);
+            }
+        }
+        int width = 1;
+        if (n > 1 && (width = wcwidth(wc)) < 0)
+            width = 1;
+        put_glyph(screen, data + k, n, width);
+        k += n;
+    }
+}
+
+// Flushing
+static void write_bytes(Array *output, const char *s, size_t len)
+{
+    array_extend(output, s, len);
+}
+
+static int format_color(char *s, uint16_t color, bool foreground)
+{
+    if (color == SCREEN_COLOR_DEFAULT)
+        return sprintf(s, foreground ? "39" : "49");
+    if (color & SCREEN_COLOR_8_BIT)
+        return sprintf(s, foreground ? "38;5;%u" : "48;5;%u", color & 0xFF);
+    return sprintf(s, "%u", color & 0xFF);
+}
+
+static void write_colors(Screen *screen, Array *output, uint16_t fg, uint16_t bg)
+{
+    // Writes only the colors that differ from the terminal's
+    if (fg == screen->out_fg && bg == screen->out_bg)
+        return;
+    char s[32] = "\x1b[";
+    int n = 2;
+    if (fg != screen->out_fg)
+        n += format_color(s + n, fg, true);
+    if (bg != screen->out_bg)
+    {
+        if (fg != screen->out_fg)
+            s[n++] = ';';
+        n += format_color(s + n, bg, false);
+    }
+    s[n++] = 'm';
+    write_bytes(output, s, n);
+    screen->out_fg = fg;
+    screen->out_bg = bg;
+}
+
+static void write_move(Screen *screen, Array *output, unsigned int i, unsigned int j)
+{
+    if (screen->out_i == i && screen->out_j == j)
+        return;
+    char s[4 + 2 * 3 * sizeof(unsigned int) + 1];
+    int n = sprintf(s, "\x1b[%u;%uH", i + 1, j + 1);
+    write_bytes(output, s, n);
+    screen->out_i = i;
+    screen->out_j = j;
+}
+
+static void begin_move(Screen *screen, Array *output)
+{
+    // Hides the cursor while cells move and sets default colors, since terminals blank exposed cells in current colors
+    if (screen->out_cursor_visible)
+    {
+        write_bytes(output, "\x1b[?25l", 6);
+        screen->out_cursor_visible = false;
+    }
+    write_colors(screen, output, SCREEN_COLOR_DEFAULT, SCREEN_COLOR_DEFAULT);
+}
+
+void screen_scroll_rows(Screen *screen, Array *output, unsigned int top, unsigned int bottom, int n)
+{
+    /* Scrolls rows from top to bottom up by n, or down if n is negative, on the terminal and in the front grid, so
+       only rows exposed at the edge differ from the back grid if its panes scrolled the same */
+    unsigned int m = (n < 0) ? -(unsigned int)n : (unsigned int)n;
+    if (n == 0 || top >= bottom || bottom >= screen->rows || m > bottom - top || screen->clear_pending)
+        return;
+    size_t start_len = output->len;
+    begin_move(screen, output);
+    char s[3 * (4 + 2 * 3 * sizeof(unsigned int))];
+    int len = sprintf(s, "\x1b[%u;%ur\x1b[%u%c\x1b[r", top + 1, bottom + 1, m, (n > 0) ? 'S' : 'T');
+    write_bytes(output, s, len);
+    screen->out_i = UINT_MAX; // Setting the region homes the cursor
+    screen->nbytes_pending += output->len - start_len;
+
+    size_t ncols = screen->cols;
+    Cell *region = screen->front + top * ncols;
+    size_t nkept = (bottom - top + 1 - m) * ncols;
+    if (n > 0)
+    {
+        memmove(region, region + m * ncols, nkept * sizeof(Cell));
+        fill_blank(region + nkept, m * ncols, SCREEN_COLOR_DEFAULT, SCREEN_COLOR_DEFAULT);
+    }
+    else
+    {
+        memmove(region + m * ncols, region, nkept * sizeof(Cell));
+        fill_blank(region, m * ncols, SCREEN_COLOR_DEFAULT, SCREEN_COLOR_DEFAULT);
+    }
+}
+
+void screen_shift_columns(Screen *screen, Array *output, unsigned int top, unsigned int bottom, unsigned int left,
+                          int n)
+{
+    /* Shifts cells right of left in rows from top to bottom left by n, or right if n is negative, on the terminal and
+       in the front grid, deleting or inserting characters row by row */
+    unsigned int m = (n < 0) ? -(unsigned int)n : (unsigned int)n;
+    if (n == 0 || top > bottom || bottom >= screen->rows || left >= screen->cols || m >= screen->cols - left ||
+        screen->clear_pending)
+        return;
+    size_t start_len = output->len;
+    begin_move(screen, output);
+    size_t nkept = screen->cols - left - m;
+    for (unsigned int i = top; i <= bottom; i++)
+    {
+        write_move(screen, output, i, left);
+        char s[4 + 3 * sizeof(unsigned int)];
+        int len = sprintf(s, "\x1b[%u%c", m, (n > 0) ? 'P' : '@');
+        write_bytes(output, s, len);
+
+        Cell *cells = screen->front + (size_t)i * screen->cols + left;
+        if (n > 0)
+        {
+            memmove(cells, cells + m, nkept * sizeof(Cell));
+            fill_blank(cells + nkept, m, SCREEN_COLOR_DEFAULT, SCREEN_COLOR_DEFAULT);
+        }
+        else
+        {
+            memmove(cells + m, cells, nkept * sizeof(Cell));
+            fill_blank(cells, m, SCREEN_COLOR_DEFAULT, SCREEN_COLOR_DEFAULT);
+        }
+        if (cells[0].len == 0) // Split from its wide character, so it is marked to differ from any back cell
+            cells[0].width = UINT8_MAX;
+    }
+    screen->nbytes_pending += output->len - start_len;
+}
+
+static bool can_rewrite(Screen *screen, const Cell *row, unsigned int i, unsigned int j)
+{
+    // Checks if the cells between the terminal's cursor and (i, j) can be rewritten as they are without changing colors
+    if (screen->out_i != i || screen->out_j >= j || j - screen->out_j > MAX_REWRITE_LEN)
+        return false;
+    for (unsigned int k = screen->out_j; k < j; k++)
+    {
+        if (row[k].width != 1 || row[k].fg != screen->out_fg || row[k].bg != screen->out_bg)
+            return false;
+    }
+    return true;
+}
+
+void screen_flush(Screen *screen, Array *output)
+{
+    // Writes the cells of the back grid that differ from the front grid, after which the grids match
+    size_t start_len = output->len;
+    if (screen->clear_pending)
+    {
+        char s[] = "\x1b[39;49m\x1b[2J";
+        write_bytes(output, s, sizeof(s) - 1);
+        screen->out_fg = SCREEN_COLOR_DEFAULT;
+        screen->out_bg = SCREEN_COLOR_DEFAULT;
+        screen->out_i = UINT_MAX;
+        fill_blank(screen->front, (size_t)screen->rows * screen->cols, SCREEN_COLOR_DEFAULT, SCREEN_COLOR_DEFAULT);
+        screen->clear_pending = false;
+    }
+
+    for (unsigned int i = 0; i < screen->rows; i++)
+    {
+        Cell *back_row = screen->back + (size_t)i * screen->cols;
+        Cell *front_row = screen->front + (size_t)i * screen->cols;
+        for (unsigned int j = 0; j < screen->cols; j++)
+        {
+            Cell *cell = back_row + j;
+            if (memcmp(cell, front_row + j, sizeof(Cell)) == 0)
+                continue;
+            if (cell->len == 0) // Written with the wide character to its left
+            {
+                front_row[j] = *cell;
+                continue;
+            }
+            if (screen->out_cursor_visible)
+            {
+                write_bytes(output, "\x1b[?25l", 6);
+                screen->out_cursor_visible = false;
+            }
+            if (can_rewrite(screen, back_row, i, j))
+            {
+                for (unsigned int k = screen->out_j; k < j; k++)
+                    write_bytes(output, back_row[k].glyph, back_row[k].len);
+                screen->out_j = j;
+            }
+            else
+                write_move(screen, output, i, j);
+            write_colors(screen, output, cell->fg, cell->bg);
+            write_bytes(output, cell->glyph, cell->len);
+            front_row[j] = *cell;
+            screen->out_j += cell->width;
+            if (screen->out_j >= screen->cols)
+                screen->out_i = UINT_MAX; // Terminals differ in where a pending wrap leaves the cursor
+        }
+    }
+
+    if (screen->cursor_visible && screen->rows > 0 && screen->cols > 0)
+    {
+        unsigned int j = (screen->j < screen->cols) ? screen->j : screen->cols - 1;
+        write_move(screen, output, screen->i, j);
+        if (!screen->out_cursor_visible)
+        {
+            write_bytes(output, "\x1b[?25h", 6);
+            screen->out_cursor_visible = true;
+        }
+    }
+    else if (!screen->cursor_visible && screen->out_cursor_visible)
+    {
+        write_bytes(output, "\x1b[?25l", 6);
+        screen->out_cursor_visible = false;
+    }
+
+    size_t nbytes = output->len - start_len + screen->nbytes_pending;
+    screen->nbytes_pending = 0;
+    if (nbytes > 0)
+    {
+        screen->nframes++;
+        screen->nbytes += nbytes;
+        screen->nbytes_frame = nbytes;
+    }
+}
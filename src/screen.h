@@ -0,0 +1,72 @@
+#ifndef SCREEN_H
+#define SCREEN_H
+
+/*
+ * Screen models of the terminal
+ *
+ * Panes are rendered as the escape sequences they would write to the terminal, which a screen interprets into a back
+ * grid of cells. Flushing compares the back grid to the front grid, which holds what the terminal last showed, and
+ * writes cursor moves, colors, and glyphs only for cells that changed. Scrolling or shifting cells on the terminal
+ * moves those of the front grid too, so the next flush writes only the cells exposed. Colors are stored as
+ * SCREEN_COLOR_DEFAULT, a 4-bit SGR code tagged with SCREEN_COLOR_4_BIT, or an 8-bit index tagged with
+ * SCREEN_COLOR_8_BIT.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "array.h"
+
+#define SCREEN_COLOR_DEFAULT 0
+#define SCREEN_COLOR_4_BIT 0x100
+#define SCREEN_COLOR_8_BIT 0x200
+#define SCREEN_GLYPH_SIZE 4 // Bytes of the longest UTF-8 sequence
+
+extern const int SCREEN_ERROR_MEMORY_ALLOCATION;
+
+typedef struct
+{
+    char glyph[SCREEN_GLYPH_SIZE]; // UTF-8 bytes of the cell's character; unused bytes are 0
+    uint16_t fg;
+    uint16_t bg;
+    uint8_t len;   // Bytes of glyph, or 0 if the cell is covered by a wide character to its left
+    uint8_t width; // Columns the glyph takes
+} Cell;
+
+typedef struct
+{
+    Cell *front;
+    Cell *back;
+    unsigned int rows;
+    unsigned int cols;
+    // Back grid state as sequences are interpreted
+    unsigned int i;
+    unsigned int j; // Equal to cols while a wrap is pending
+    uint16_t fg;
+    uint16_t bg;
+    bool cursor_visible;
+    // Terminal state as sequences are written
+    unsigned int out_i; // UINT_MAX if unknown
+    unsigned int out_j;
+    uint16_t out_fg;
+    uint16_t out_bg;
+    bool out_cursor_visible;
+    bool clear_pending; // The terminal's contents are unknown, so it is cleared before the next flush
+    // Metrics
+    size_t nframes;        // Flushes that wrote at least one byte
+    size_t nbytes;         // Bytes written over all flushes
+    size_t nbytes_frame;   // Bytes written by the last frame
+    size_t nbytes_pending; // Bytes written by scrolls and shifts since the last flush
+} Screen;
+
+int screen_init(Screen *screen, unsigned int rows, unsigned int cols);
+void screen_free(Screen *screen);
+int screen_resize(Screen *screen, unsigned int rows, unsigned int cols);
+void screen_render(Screen *screen, const char *data, size_t len);
+void screen_flush(Screen *screen, Array *output);
+void screen_scroll_rows(Screen *screen, Array *output, unsigned int top, unsigned int bottom, int n);
+void screen_shift_columns(Screen *screen, Array *output, unsigned int top, unsigned int bottom, unsigned int left,
+                          int n);
+
+#endif // SCREEN_H
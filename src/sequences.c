@@ -1,10 +1,47 @@
 #include <ctype.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "sequences.h"
 
+#define NUCLEIC_CLASS 1
+#define PROTEIN_CLASS 2
+#define HIGH_BITS 0x8080808080808080
+#define LOW_BITS 0x0101010101010101
+#define LOW_SEVEN_BITS 0x7F7F7F7F7F7F7F7F
+#define SAMPLE_PREFIX_LEN (1 << 14)
+#define SAMPLE_WINDOW_LEN (1 << 10)
+#define SAMPLE_NWINDOWS 64
+#define SAMPLE_MIN_EVIDENCE 16 // Residues ruling out the other alphabet before a sample settles on one
+#define NUCLEIC_PACK_BITS 2    // Codes for ACGT
+#define PROTEIN_PACK_BITS 5    // Codes for all protein symbols in upper case
+#define GAP_INDEX_STRIDE 16    // Gap runs per entry in the index of gaps preceding them
+
+typedef struct
+{
+    size_t start;
+    size_t len;
+    char sym;
+} PackedRun;
+
+typedef struct
+{
+    size_t offset; // Offset of a run in the encoded runs
+    size_t column; // Column following the previous run
+    size_t gaps;   // Gaps preceding the run
+} GapIndexEntry;
+
 Alphabet NUCLEIC_ALPHABET = {.name = "nucleic", .syms = "ACGTUN.-", .case_sensitive = false};
 Alphabet PROTEIN_ALPHABET = {.name = "protein", .syms = "ACDEFGHIKLMNPQRSTVWYX.-", .case_sensitive = false};
 
+// Bitmasks of the base alphabets containing each byte; spans additionally let line breaks through
+static unsigned char seq_classes[256];
+static unsigned char span_classes[256];
+
+// Symbols of packed codes, which are indices into the base alphabets
+static char nucleic_codes[1 << NUCLEIC_PACK_BITS];
+static char protein_codes[1 << PROTEIN_PACK_BITS];
+
 void sequences_free_seq_records(SeqRecord *records, size_t nrecords)
 {
     if (records == NULL)
@@ -25,6 +62,456 @@ void sequences_free_seq_record_array(SeqRecordArray *record_array)
     record_array->len = 0;
 }
 
+void sequences_compact_seq(SeqRecord *record)
+{
+    if (record->span <= record->len) // Spans are unset for records built in memory
+        return;
+
+    // Shift lines over the line breaks that precede them
+    char *src = record->seq;
+    char *dst = record->seq;
+    char *end = record->seq + record->span;
+    while (src < end)
+    {
+        char *line_end = memchr(src, '\n', end - src);
+        if (line_end == NULL)
+            line_end = end;
+        char *trim_end = line_end;
+        while (trim_end > src && trim_end[-1] == '\r')
+            trim_end--;
+        memmove(dst, src, trim_end - src);
+        dst += trim_end - src;
+        if (line_end == end)
+            break;
+        src = line_end + 1;
+    }
+    record->span = record->len;
+}
+
+static bool is_gap(char sym)
+{
+    return sym == '-' || sym == '.';
+}
+
+static int get_pack_code(const Alphabet *alphabet, const char *codes, unsigned int bits, char sym)
+{
+    // Returns the code of sym in upper case or -1 if it is stored in a run
+    if ((unsigned char)sym >= 128)
+        return -1;
+    if (!alphabet->case_sensitive)
+        sym = toupper(sym);
+    int index = alphabet->index_map[(unsigned char)sym];
+    if (index < 0 || index >= (1 << bits) || codes[index] != sym)
+        return -1;
+    return index;
+}
+
+static int pack_residues(SeqType type, char *seq, size_t len, SeqRecord *record, size_t *size)
+{
+    /* Return codes
+        0: residues are packed into their first size bytes and the record's packed members are set
+        1: residues are unchanged since their type has no codes, packing would not shrink them, or allocation failed
+    */
+    const Alphabet *alphabet;
+    const char *codes;
+    unsigned int bits;
+    if (type == SEQ_TYPE_NUCLEIC)
+    {
+        alphabet = &NUCLEIC_ALPHABET;
+        codes = nucleic_codes;
+        bits = NUCLEIC_PACK_BITS;
+    }
+    else if (type == SEQ_TYPE_PROTEIN)
+    {
+        alphabet = &PROTEIN_ALPHABET;
+        codes = protein_codes;
+        bits = PROTEIN_PACK_BITS;
+    }
+    else
+        return 1;
+
+    // Count runs to check the packed residues fit in fewer bytes; lower case runs continue over residues without codes
+    size_t nruns = 0, ncase_runs = 0;
+    bool in_run = false, in_case_run = false;
+    for (size_t i = 0; i < len; i++)
+    {
+        bool run = get_pack_code(alphabet, codes, bits, seq[i]) < 0;
+        bool case_run = islower((unsigned char)seq[i]) || (run && in_case_run);
+        nruns += run && (!in_run || seq[i] != seq[i - 1]);
+        ncase_runs += case_run && !in_case_run;
+        in_run = run;
+        in_case_run = case_run;
+    }
+    size_t per_word = 64 / bits;
+    size_t nwords = (len + per_word - 1) / per_word;
+    size_t words_size = nwords * sizeof(uint64_t);
+    if (words_size >= len || nruns + ncase_runs > (len - words_size - 1) / sizeof(PackedRun))
+        return 1;
+    PackedRun *runs = NULL;
+    if (nruns + ncase_runs > 0 && (runs = malloc((nruns + ncase_runs) * sizeof(PackedRun))) == NULL)
+        return 1;
+
+    // Words are written over residues already read since each word's residues span more bytes than it
+    PackedRun *case_runs = (runs != NULL) ? runs + nruns : NULL;
+    size_t j = 0, k = 0;
+    uint64_t word = 0;
+    in_run = in_case_run = false;
+    for (size_t i = 0; i < len; i++)
+    {
+        char sym = seq[i];
+        int code = get_pack_code(alphabet, codes, bits, sym);
+        bool run = code < 0;
+        bool case_run = islower((unsigned char)sym) || (run && in_case_run);
+        if (run && (!in_run || sym != runs[j - 1].sym))
+            runs[j++] = (PackedRun){.start = i, .len = 0, .sym = sym};
+        if (case_run && !in_case_run)
+            case_runs[k++] = (PackedRun){.start = i, .len = 0, .sym = '\0'};
+        if (run)
+            runs[j - 1].len++;
+        if (case_run)
+            case_runs[k - 1].len++;
+        in_run = run;
+        in_case_run = case_run;
+
+        word |= (uint64_t)(run ? 0 : code) << (i % per_word * bits);
+        if (i % per_word == per_word - 1 || i == len - 1)
+        {
+            memcpy(seq + i / per_word * sizeof(uint64_t), &word, sizeof(uint64_t));
+            word = 0;
+        }
+    }
+    if (runs != NULL)
+        memcpy(seq + words_size, runs, (nruns + ncase_runs) * sizeof(PackedRun));
+    free(runs);
+
+    record->packed_bits = bits;
+    record->packed_nruns = nruns;
+    record->packed_ncase_runs = ncase_runs;
+    *size = words_size + (nruns + ncase_runs) * sizeof(PackedRun);
+    return 0;
+}
+
+static size_t get_varint_len(size_t x)
+{
+    size_t n = 1;
+    while (x >= 0x80)
+    {
+        x >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static size_t put_varint(unsigned char *p, size_t x)
+{
+    // Writes x in groups of seven bits, low first, with the high bit set on all but the last
+    size_t n = 0;
+    while (x >= 0x80)
+    {
+        p[n++] = (x & 0x7f) | 0x80;
+        x >>= 7;
+    }
+    p[n++] = x;
+    return n;
+}
+
+static size_t get_varint(const unsigned char *p, size_t *x)
+{
+    size_t n = 0;
+    unsigned int shift = 0;
+    *x = 0;
+    do
+    {
+        *x |= (size_t)(p[n] & 0x7f) << shift;
+        shift += 7;
+    } while (p[n++] & 0x80);
+    return n;
+}
+
+int sequences_pack_seq(SeqRecord *record, size_t *size)
+{
+    /* Return codes
+        0: seq is packed into its first size bytes
+        1: seq is unchanged since neither dropping gaps nor packing residues would shrink it, or allocation failed
+
+    Packed seqs hold their residues, as codes if their type has them, followed by the gaps dropped from them. Gaps are
+    stored as an index of every GAP_INDEX_STRIDE runs and then the runs themselves, each encoded as varints of the
+    residues preceding it and of its length and symbol.
+    */
+    if (record->packed_bits > 0 || record->ngap_runs > 0)
+        return 1;
+    sequences_compact_seq(record);
+    char *seq = record->seq;
+    size_t len = record->len;
+
+    // Gather gap runs to check dropping them saves space
+    size_t ngaps = 0, ngap_runs = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (is_gap(seq[i]))
+        {
+            ngaps++;
+            ngap_runs += i == 0 || seq[i] != seq[i - 1];
+        }
+    }
+    PackedRun *gap_runs = NULL;
+    if (ngap_runs > 0 && (gap_runs = malloc(ngap_runs * sizeof(PackedRun))) == NULL)
+        ngap_runs = 0;
+    size_t j = 0;
+    for (size_t i = 0; i < len && ngap_runs > 0; i++)
+    {
+        if (!is_gap(seq[i]))
+            continue;
+        if (j > 0 && gap_runs[j - 1].sym == seq[i] && gap_runs[j - 1].start + gap_runs[j - 1].len == i)
+            gap_runs[j - 1].len++;
+        else
+            gap_runs[j++] = (PackedRun){.start = i, .len = 1, .sym = seq[i]};
+    }
+    size_t nentries = (ngap_runs + GAP_INDEX_STRIDE - 1) / GAP_INDEX_STRIDE + 1; // Last entry marks the end
+    size_t gaps_size = nentries * sizeof(GapIndexEntry);
+    for (size_t k = 0, column = 0; k < ngap_runs; k++)
+    {
+        gaps_size += get_varint_len(gap_runs[k].start - column) + get_varint_len(gap_runs[k].len << 1);
+        column = gap_runs[k].start + gap_runs[k].len;
+    }
+    if (ngap_runs > 0 && gaps_size >= ngaps)
+    {
+        free(gap_runs);
+        gap_runs = NULL;
+        ngap_runs = 0;
+    }
+
+    // Shift residues over gaps
+    size_t nresidues = len;
+    if (ngap_runs > 0)
+    {
+        nresidues = 0;
+        for (size_t i = 0; i < len; i++)
+        {
+            if (!is_gap(seq[i]))
+                seq[nresidues++] = seq[i];
+        }
+    }
+    size_t residues_size = nresidues;
+    if (pack_residues(record->type, seq, nresidues, record, &residues_size) != 0 && ngap_runs == 0)
+        return 1;
+
+    // Append the index and encoded runs
+    if (ngap_runs > 0)
+    {
+        char *index = seq + residues_size;
+        unsigned char *runs = (unsigned char *)index + nentries * sizeof(GapIndexEntry);
+        GapIndexEntry entry = {.offset = 0, .column = 0, .gaps = 0};
+        for (size_t k = 0; k <= ngap_runs; k++)
+        {
+            if (k % GAP_INDEX_STRIDE == 0 || k == ngap_runs)
+                memcpy(index + (k + GAP_INDEX_STRIDE - 1) / GAP_INDEX_STRIDE * sizeof(GapIndexEntry), &entry,
+                       sizeof(GapIndexEntry));
+            if (k == ngap_runs)
+                break;
+            PackedRun *run = gap_runs + k;
+            entry.offset += put_varint(runs + entry.offset, run->start - entry.column);
+            entry.offset += put_varint(runs + entry.offset, run->len << 1 | (run->sym == '.'));
+            entry.column = run->start + run->len;
+            entry.gaps += run->len;
+        }
+        free(gap_runs);
+    }
+
+    record->gaps_offset = residues_size;
+    record->ngap_runs = ngap_runs;
+    *size = residues_size + (ngap_runs > 0 ? gaps_size : 0);
+    return 0;
+}
+
+static size_t find_run(const char *runs, size_t nruns, size_t start, PackedRun *run)
+{
+    // Returns the index of the first run ending after start, found by bisection since runs are ordered
+    size_t lo = 0, hi = nruns;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        memcpy(run, runs + mid * sizeof(PackedRun), sizeof(PackedRun)); // Runs are not aligned
+        if (run->start + run->len <= start)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void unpack_residues(const SeqRecord *record, size_t nresidues, size_t start, size_t len, char *buffer)
+{
+    if (record->packed_bits == 0)
+    {
+        memcpy(buffer, record->seq + start, len);
+        return;
+    }
+    unsigned int bits = record->packed_bits;
+    const char *codes = (bits == NUCLEIC_PACK_BITS) ? nucleic_codes : protein_codes;
+    size_t per_word = 64 / bits;
+    uint64_t mask = ((uint64_t)1 << bits) - 1;
+    size_t i = 0;
+    while (i < len)
+    {
+        size_t k = (start + i) % per_word;
+        uint64_t word;
+        memcpy(&word, record->seq + (start + i) / per_word * sizeof(uint64_t), sizeof(uint64_t));
+        word >>= k * bits;
+        for (; k < per_word && i < len; k++, i++)
+        {
+            buffer[i] = codes[word & mask];
+            word >>= bits;
+        }
+    }
+
+    // Lower case runs may span residues without codes, so those are restored after
+    const char *runs = record->seq + (nresidues + per_word - 1) / per_word * sizeof(uint64_t);
+    const char *case_runs = runs + record->packed_nruns * sizeof(PackedRun);
+    PackedRun run;
+    for (size_t j = find_run(case_runs, record->packed_ncase_runs, start, &run); j < record->packed_ncase_runs; j++)
+    {
+        memcpy(&run, case_runs + j * sizeof(PackedRun), sizeof(PackedRun));
+        if (run.start >= start + len)
+            break;
+        size_t from = (run.start > start) ? run.start : start;
+        size_t to = (run.start + run.len < start + len) ? run.start + run.len : start + len;
+        for (size_t k = from; k < to; k++)
+            buffer[k - start] = tolower(buffer[k - start]);
+    }
+    for (size_t j = find_run(runs, record->packed_nruns, start, &run); j < record->packed_nruns; j++)
+    {
+        memcpy(&run, runs + j * sizeof(PackedRun), sizeof(PackedRun));
+        if (run.start >= start + len)
+            break;
+        size_t from = (run.start > start) ? run.start : start;
+        size_t to = (run.start + run.len < start + len) ? run.start + run.len : start + len;
+        memset(buffer + from - start, run.sym, to - from);
+    }
+}
+
+static void unpack_window(const SeqRecord *record, size_t start, size_t len, char *buffer)
+{
+    size_t ngap_runs = record->ngap_runs;
+    if (ngap_runs == 0)
+    {
+        unpack_residues(record, record->len, start, len, buffer);
+        return;
+    }
+
+    // Resume decoding runs from the last index entry at or before the window, found by bisection
+    const char *index = record->seq + record->gaps_offset;
+    size_t nentries = (ngap_runs + GAP_INDEX_STRIDE - 1) / GAP_INDEX_STRIDE + 1;
+    const unsigned char *runs = (const unsigned char *)index + nentries * sizeof(GapIndexEntry);
+    GapIndexEntry entry;
+    memcpy(&entry, index + (nentries - 1) * sizeof(GapIndexEntry), sizeof(GapIndexEntry)); // Entries are not aligned
+    size_t nresidues = record->len - entry.gaps;
+    size_t lo = 0, hi = nentries - 1;
+    while (hi - lo > 1)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        memcpy(&entry, index + mid * sizeof(GapIndexEntry), sizeof(GapIndexEntry));
+        if (entry.column <= start)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    memcpy(&entry, index + lo * sizeof(GapIndexEntry), sizeof(GapIndexEntry));
+
+    // Alternate between residues and gap runs, decoding runs until one ends past the window start
+    size_t k = lo * GAP_INDEX_STRIDE;
+    const unsigned char *p = runs + entry.offset;
+    size_t column = entry.column; // Column following the last decoded run
+    size_t gaps = entry.gaps;     // Gaps preceding column
+    size_t run_start = SIZE_MAX, run_len = 0;
+    char run_sym = '\0';
+    size_t i = 0;
+    while (i < len)
+    {
+        if (run_start == SIZE_MAX && k < ngap_runs)
+        {
+            size_t residues, x;
+            p += get_varint(p, &residues);
+            p += get_varint(p, &x);
+            run_start = column + residues;
+            run_len = x >> 1;
+            run_sym = (x & 1) ? '.' : '-';
+            k++;
+        }
+        size_t pos = start + i;
+        if (pos < run_start) // Residues before the next run, if any
+        {
+            size_t n = (run_start - pos < len - i) ? run_start - pos : len - i;
+            unpack_residues(record, nresidues, pos - gaps, n, buffer + i);
+            i += n;
+        }
+        else if (pos < run_start + run_len)
+        {
+            size_t n = (run_start + run_len - pos < len - i) ? run_start + run_len - pos : len - i;
+            memset(buffer + i, run_sym, n);
+            i += n;
+        }
+        if (run_start != SIZE_MAX && start + i >= run_start + run_len)
+        {
+            column = run_start + run_len;
+            gaps += run_len;
+            run_start = SIZE_MAX;
+        }
+    }
+}
+
+const char *sequences_get_window(SeqRecord *record, size_t start, size_t len, char *buffer)
+{
+    if (record->packed_bits > 0 || record->ngap_runs > 0)
+    {
+        unpack_window(record, start, len, buffer);
+        return buffer;
+    }
+    if (record->span > record->len && record->line_bases == 0)
+        sequences_compact_seq(record); // Irregular wrapping has no direct mapping from residues to bytes
+    if (record->span <= record->len)
+        return record->seq + start;
+
+    // Gather residues line by line from uniformly wrapped sequences
+    size_t i = 0;
+    while (i < len)
+    {
+        size_t line = (start + i) / record->line_bases;
+        size_t col = (start + i) % record->line_bases;
+        size_t n = record->line_bases - col;
+        if (n > len - i)
+            n = len - i;
+        memcpy(buffer + i, record->seq + line * record->line_width + col, n);
+        i += n;
+    }
+    return buffer;
+}
+
+static inline uint64_t get_zero_bytes(uint64_t x)
+{
+    // Returns a word with the high bit set in each zero byte of x; bytes cannot carry into each other
+    return ~(((x & LOW_SEVEN_BITS) + LOW_SEVEN_BITS) | x | LOW_SEVEN_BITS);
+}
+
+void sequences_dot_identities(char *dst, const char *seq, const char *reference, size_t len)
+{
+    // Copies seq to dst with residues identical to the reference's replaced by dots; gaps are always kept
+    // Words are compared and blended without branches; dst may be seq
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t s, r;
+        memcpy(&s, seq + i, 8);
+        memcpy(&r, reference + i, 8);
+        uint64_t gaps = get_zero_bytes(r ^ (LOW_BITS * '-')) | get_zero_bytes(r ^ (LOW_BITS * '.'));
+        uint64_t mask = ((get_zero_bytes(s ^ r) & ~gaps) >> 7) * 0xFF;
+        uint64_t d = (s & ~mask) | (LOW_BITS * '.' & mask);
+        memcpy(dst + i, &d, 8);
+    }
+    for (; i < len; i++)
+        dst[i] = (seq[i] == reference[i] && !is_gap(seq[i])) ? '.' : seq[i];
+}
+
 int sequences_init_alphabet(Alphabet *alphabet, char *name, char *syms, bool case_sensitive)
 {
     if (!alphabet || !name || !syms)
@@ -70,6 +557,18 @@ int sequences_init_alphabet(Alphabet *alphabet, char *name, char *syms, bool cas
     return 0;
 }
 
+static void init_pack_codes(const Alphabet *alphabet, char *codes, unsigned int bits)
+{
+    // Codes are the first indices of an alphabet, each standing for its symbol in upper case if case-insensitive
+    memset(codes, 0, 1 << bits);
+    for (char *sym = alphabet->syms; *sym != '\0'; sym++)
+    {
+        int index = alphabet->index_map[(unsigned char)*sym];
+        if (index < (1 << bits) && codes[index] == '\0')
+            codes[index] = alphabet->case_sensitive ? *sym : toupper(*sym);
+    }
+}
+
 int sequences_init_base_alphabets(void)
 {
     Alphabet *BASE_ALPHABETS[] = {&NUCLEIC_ALPHABET, &PROTEIN_ALPHABET};
@@ -83,13 +582,34 @@ int sequences_init_base_alphabets(void)
         if (code != 0)
             return code;
     }
+
+    // Classify bytes against all base alphabets at once for type inference
+    for (unsigned int i = 0; i < 256; i++)
+    {
+        unsigned char classes = 0;
+        if (i < 128 && NUCLEIC_ALPHABET.index_map[i] != -1)
+            classes |= NUCLEIC_CLASS;
+        if (i < 128 && PROTEIN_ALPHABET.index_map[i] != -1)
+            classes |= PROTEIN_CLASS;
+        seq_classes[i] = classes;
+        span_classes[i] = classes;
+    }
+    span_classes['\n'] = NUCLEIC_CLASS | PROTEIN_CLASS;
+    span_classes['\r'] = NUCLEIC_CLASS | PROTEIN_CLASS;
+
+    init_pack_codes(&NUCLEIC_ALPHABET, nucleic_codes, NUCLEIC_PACK_BITS);
+    init_pack_codes(&PROTEIN_ALPHABET, protein_codes, PROTEIN_PACK_BITS);
     return code;
 }
 
 int sequences_in_alphabet(Alphabet *alphabet, SeqRecord *record)
 {
-    for (char *sym = record->seq; *sym != '\0'; sym++)
+    bool compact = record->span <= record->len;
+    size_t n = compact ? record->len : record->span;
+    for (char *sym = record->seq; sym < record->seq + n; sym++)
     {
+        if (!compact && (*sym == '\n' || *sym == '\r'))
+            continue;
         if (!isascii(*sym))
             return -1;
         unsigned int index = *sym;
@@ -111,23 +631,156 @@ int sequences_is_protein(SeqRecord *record)
 
 int sequences_infer_seq_type(SeqRecord *record)
 {
-    int is_nucleic = sequences_is_nucleic(record);
-    int is_protein = sequences_is_protein(record);
-    if ((is_nucleic == 1) && (is_protein == 1))
+    bool compact = record->span <= record->len;
+    const unsigned char *classes = compact ? seq_classes : span_classes;
+    const unsigned char *sym = (const unsigned char *)record->seq;
+    const unsigned char *end = sym + (compact ? record->len : record->span);
+
+    // Narrow candidate alphabets eight bytes at a time, gathering high bits for the ASCII check as words
+    unsigned char candidates = NUCLEIC_CLASS | PROTEIN_CLASS;
+    uint64_t high = 0;
+    while (end - sym >= 8 && candidates != 0)
+    {
+        uint64_t word;
+        memcpy(&word, sym, sizeof(word));
+        high |= word;
+        candidates &= classes[sym[0]] & classes[sym[1]] & classes[sym[2]] & classes[sym[3]] &
+                      classes[sym[4]] & classes[sym[5]] & classes[sym[6]] & classes[sym[7]];
+        sym += 8;
+    }
+    while (sym < end && candidates != 0)
+    {
+        high |= *sym;
+        candidates &= classes[*sym];
+        sym++;
+    }
+
+    // Once no alphabet is left, only the ASCII check remains
+    for (; end - sym >= 8; sym += 8)
+    {
+        uint64_t word;
+        memcpy(&word, sym, sizeof(word));
+        high |= word;
+    }
+    for (; sym < end; sym++)
+        high |= *sym;
+
+    if (high & HIGH_BITS)
+    {
+        record->type = SEQ_TYPE_ERROR;
+        return 2;
+    }
+    switch (candidates)
+    {
+    case NUCLEIC_CLASS | PROTEIN_CLASS:
         record->type = SEQ_TYPE_INDETERMINATE;
-    else if (is_nucleic == 1)
+        break;
+    case NUCLEIC_CLASS:
         record->type = SEQ_TYPE_NUCLEIC;
-    else if (is_protein == 1)
+        break;
+    case PROTEIN_CLASS:
         record->type = SEQ_TYPE_PROTEIN;
-    else if ((is_nucleic == -1) || (is_protein == -1))
+        break;
+    default:
+        record->type = SEQ_TYPE_UNKNOWN;
+        return 1;
+    }
+    return 0;
+}
+
+static void count_classes(const unsigned char *sym, const unsigned char *end, const unsigned char *classes,
+                          size_t counts[4], uint64_t *high)
+{
+    for (; sym < end; sym++)
+    {
+        *high |= *sym;
+        counts[classes[*sym]]++;
+    }
+}
+
+static bool has_high_bits(const unsigned char *sym, size_t n)
+{
+    // Checks eight bytes at a time, which is much faster than classifying them
+    const unsigned char *end = sym + n;
+    uint64_t high = 0;
+    for (; end - sym >= 8; sym += 8)
+    {
+        uint64_t word;
+        memcpy(&word, sym, sizeof(word));
+        high |= word;
+    }
+    for (; sym < end; sym++)
+        high |= *sym;
+    return (high & HIGH_BITS) != 0;
+}
+
+static bool sample_settled(const size_t counts[4])
+{
+    // A symbol outside both alphabets or evidence for each settles the sample as unknown
+    size_t nucleic = counts[NUCLEIC_CLASS], protein = counts[PROTEIN_CLASS];
+    return counts[0] > 0 || (nucleic > 0 && protein > 0) || nucleic >= SAMPLE_MIN_EVIDENCE ||
+           protein >= SAMPLE_MIN_EVIDENCE;
+}
+
+int sequences_sample_seq_type(SeqRecord *record)
+{
+    bool compact = record->span <= record->len;
+    const unsigned char *classes = compact ? seq_classes : span_classes;
+    const unsigned char *seq = (const unsigned char *)record->seq;
+    size_t n = compact ? record->len : record->span;
+    if (n < SAMPLE_PREFIX_LEN + 2 * SAMPLE_NWINDOWS * SAMPLE_WINDOW_LEN) // Sample would be most of the sequence
+        return sequences_infer_seq_type(record);
+
+    // Count classes in a prefix, then in evenly strided windows until the counts settle on a type
+    size_t counts[4] = {0, 0, 0, 0};
+    uint64_t high = 0;
+    count_classes(seq, seq + SAMPLE_PREFIX_LEN, classes, counts, &high);
+    size_t stride = (n - SAMPLE_PREFIX_LEN) / SAMPLE_NWINDOWS;
+    for (unsigned int i = 0; i < SAMPLE_NWINDOWS && !(high & 0x80) && !sample_settled(counts); i++)
+    {
+        const unsigned char *window = seq + SAMPLE_PREFIX_LEN + i * stride;
+        count_classes(window, window + SAMPLE_WINDOW_LEN, classes, counts, &high);
+    }
+
+    size_t nucleic = counts[NUCLEIC_CLASS], protein = counts[PROTEIN_CLASS];
+    if (high & 0x80)
     {
         record->type = SEQ_TYPE_ERROR;
         return 2;
     }
-    else
+    if (counts[0] > 0 || (nucleic > 0 && protein > 0)) // Unknown needs a full scan to rule out non-ASCII symbols
+        return sequences_infer_seq_type(record);
+    if (nucleic < SAMPLE_MIN_EVIDENCE && protein < SAMPLE_MIN_EVIDENCE && (nucleic > 0 || protein > 0))
+        return sequences_infer_seq_type(record); // Too little evidence to rule out the other alphabet from a sample
+
+    // Symbols outside the sample are not classified, but they are still checked for non-ASCII symbols
+    if (has_high_bits(seq, n))
     {
-        record->type = SEQ_TYPE_UNKNOWN;
-        return 1;
+        record->type = SEQ_TYPE_ERROR;
+        return 2;
     }
+    if (nucleic >= SAMPLE_MIN_EVIDENCE)
+        record->type = SEQ_TYPE_NUCLEIC;
+    else if (protein >= SAMPLE_MIN_EVIDENCE)
+        record->type = SEQ_TYPE_PROTEIN;
+    else // No evidence for either across the whole sample, so symbols unique to either are at most rare
+        record->type = SEQ_TYPE_INDETERMINATE;
     return 0;
 }
+
+int sequences_assign_seq_type(SeqRecord *record, SeqType forced_type, size_t nucleic_tiebreak_len, size_t sample_len)
+{
+    int code;
+    if (sample_len > 0 && record->len >= sample_len)
+        code = sequences_sample_seq_type(record);
+    else
+        code = sequences_infer_seq_type(record);
+    if (forced_type != SEQ_TYPE_UNSPECIFIED)
+    {
+        if (record->type != SEQ_TYPE_ERROR) // Allow forced type unless error
+            record->type = forced_type;
+    }
+    else if (record->type == SEQ_TYPE_INDETERMINATE && record->len >= nucleic_tiebreak_len)
+        record->type = SEQ_TYPE_NUCLEIC;
+    return code;
+}
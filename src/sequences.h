@@ -28,13 +28,24 @@ typedef struct
     int index_map[128];
 } Alphabet;
 
+// Readers build records with designated initializers, so fields they do not set, like those of packing, are zero
 typedef struct
 {
     char *header;
     char *seq;
     char *id;
+    size_t header_len;
+    size_t id_len;
     size_t len;
+    size_t span;       // Bytes spanned by seq in its source; exceeds len while line breaks remain
+    size_t line_bases; // Residues per line if uniformly wrapped; 0 otherwise
+    size_t line_width; // Bytes per line, including line breaks, if uniformly wrapped
     SeqType type;
+    unsigned int packed_bits; // Bits per residue if seq is packed; packed residues are read with sequences_get_window
+    size_t packed_nruns;      // Runs of residues stored outside the packed codes
+    size_t packed_ncase_runs; // Runs of lower case residues
+    size_t gaps_offset;       // Offset in seq of runs of gaps dropped from it
+    size_t ngap_runs;
 } SeqRecord;
 
 typedef struct
@@ -43,15 +54,23 @@ typedef struct
     unsigned int len;
 } SeqRecordArray;
 
+typedef int (*SeqRecordCallback)(SeqRecord *record, void *data); // Returns 0 to take ownership of record
+
 extern Alphabet NUCLEIC_ALPHABET;
 extern Alphabet PROTEIN_ALPHABET;
 
 void sequences_free_seq_records(SeqRecord *records, size_t nrecords);
 void sequences_free_seq_record_array(SeqRecordArray *record_array);
+void sequences_compact_seq(SeqRecord *record);
+int sequences_pack_seq(SeqRecord *record, size_t *size);
+const char *sequences_get_window(SeqRecord *record, size_t start, size_t len, char *buffer);
+void sequences_dot_identities(char *dst, const char *seq, const char *reference, size_t len);
 int sequences_init_alphabet(Alphabet *alphabet, char *name, char *syms, bool case_sensitive);
 int sequences_init_base_alphabets(void);
 int sequences_in_alphabet(Alphabet *alphabet, SeqRecord *record);
 int sequences_is_nucleic(SeqRecord *record);
 int sequences_is_protein(SeqRecord *record);
 int sequences_infer_seq_type(SeqRecord *record);
+int sequences_sample_seq_type(SeqRecord *record);
+int sequences_assign_seq_type(SeqRecord *record, SeqType forced_type, size_t nucleic_tiebreak_len, size_t sample_len);
 #endif // SEQUENCES_H
@@ -1,3 +1,7 @@
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include <wchar.h>
 
 #include "display.h"
@@ -26,6 +30,8 @@ void state_set_ruler_pane_height(State *state, unsigned int ruler_pane_height)
 {
     FileState *active_file = state->active_file;
     unsigned int min_height = wcswidth(DISPLAY_RULER_PANE_ELLIPSES, sizeof(DISPLAY_RULER_PANE_ELLIPSES)) + 1;
+    if (active_file->show_profile)
+        min_height += DISPLAY_PROFILE_HEIGHT;
     if (ruler_pane_height > state->terminal_rows - 2)
         ruler_pane_height = state->terminal_rows - 2;
     if (ruler_pane_height < min_height)
@@ -91,14 +97,136 @@ inline void state_set_cursor_sequence_j(State *state, unsigned int cursor_sequen
     active_file->cursor_sequence_j = cursor_sequence_j;
 }
 
+// FileState records
+static void resolve_file_record(FileState *file, size_t record_index)
+{
+    SeqRecord *record = file->records + record_index;
+    int code = fasta_resolve_record(&file->map, record);
+    if (code < 0 && file->resolve_code == 0)
+        file->resolve_code = code;
+    if (record->type == SEQ_TYPE_UNSPECIFIED && // Records read from an index are typed when first needed
+        sequences_assign_seq_type(record, file->forced_type, file->nucleic_tiebreak_len, file->type_sample_len) >= 2)
+        file->nonascii = true; // Prompted for in the command pane, so indexed files are never read whole to check
+}
+
+void state_resolve_record(State *state, size_t record_index)
+{
+    resolve_file_record(state->active_file, record_index);
+}
+
+void state_prepare_record(FileState *file, size_t record_index)
+{
+    // Resolves and compacts irregularly wrapped records, so windows of them are read without writing to them
+    resolve_file_record(file, record_index);
+    SeqRecord *record = file->records + record_index;
+    if (record->packed_bits == 0 && record->ngap_runs == 0 && record->line_bases == 0)
+        sequences_compact_seq(record);
+}
+
+void state_free_file(FileState *file)
+{
+    free(file->identities);
+    free(file->row_records);
+    file->identities = NULL;
+    file->row_records = NULL;
+    profile_free(&file->profile);
+    free(file->records); // Members point into the arena or mapping
+    file->records = NULL;
+    file->nrecords = 0;
+    arena_free(&file->arena);
+    if (file->map.data != NULL || file->map.bgzf != NULL)
+        fasta_munmap(&file->map);
+}
+
+typedef struct
+{
+    float identity;
+    size_t record_index;
+} RankedRecord;
+
+static int compare_ranked_records(const void *a, const void *b)
+{
+    // Orders by descending identity with NaNs last, breaking ties by record
+    const RankedRecord *x = a, *y = b;
+    bool x_nan = isnan(x->identity), y_nan = isnan(y->identity);
+    if (x_nan != y_nan)
+        return x_nan ? 1 : -1;
+    if (!x_nan && x->identity != y->identity)
+        return (x->identity > y->identity) ? -1 : 1;
+    return (x->record_index > y->record_index) - (x->record_index < y->record_index);
+}
+
+int state_sort_rows(FileState *file)
+{
+    // Orders rows by their records' identities, placing the identity reference first
+    size_t *row_records = malloc(file->nrecords * sizeof(size_t) + 1); // Never 0 bytes
+    RankedRecord *ranked = malloc(file->nrecords * sizeof(RankedRecord) + 1);
+    if (row_records == NULL || ranked == NULL)
+    {
+        free(row_records);
+        free(ranked);
+        return 1;
+    }
+    for (size_t i = 0; i < file->nrecords; i++)
+    {
+        ranked[i].identity = (i == file->identity_reference) ? INFINITY : file->identities[i];
+        ranked[i].record_index = i;
+    }
+    qsort(ranked, file->nrecords, sizeof(RankedRecord), &compare_ranked_records);
+    for (size_t i = 0; i < file->nrecords; i++)
+        row_records[i] = ranked[i].record_index;
+    free(ranked);
+    free(file->row_records);
+    file->row_records = row_records;
+    return 0;
+}
+
+void state_unsort_rows(FileState *file)
+{
+    free(file->row_records);
+    file->row_records = NULL;
+}
+
 // FileState getters
+size_t state_get_row_record(const FileState *file, size_t row)
+{
+    return (file->row_records != NULL) ? file->row_records[row] : row;
+}
+
+size_t state_get_cursor_record(State *state)
+{
+    // The cursor is clamped to the record panes as it is displayed; returns 0 if there are no records
+    FileState *active_file = state->active_file;
+    unsigned int record_panes_height = state_get_record_panes_height(state);
+    unsigned int cursor_record_i = active_file->cursor_record_i;
+    if (record_panes_height > 0 && cursor_record_i >= record_panes_height)
+        cursor_record_i = record_panes_height - 1;
+    size_t row = active_file->offset_record + cursor_record_i;
+    if (active_file->nrecords == 0)
+        return 0;
+    if (row >= active_file->nrecords)
+        row = active_file->nrecords - 1;
+    return state_get_row_record(active_file, row);
+}
+
+unsigned int state_get_pinned_height(State *state)
+{
+    // Rows pinned between the ruler and record panes, which only show if a record row is left beneath them
+    FileState *active_file = state->active_file;
+    if (!active_file->show_dots || state->terminal_rows <= active_file->ruler_pane_height + 3)
+        return 0;
+    else
+        return 1;
+}
+
 unsigned int state_get_record_panes_height(State *state)
 {
     FileState *active_file = state->active_file;
-    if (state->terminal_rows <= active_file->ruler_pane_height + 2)
+    unsigned int pinned_height = state_get_pinned_height(state);
+    if (state->terminal_rows <= active_file->ruler_pane_height + pinned_height + 2)
         return 0;
     else
-        return state->terminal_rows - active_file->ruler_pane_height - 2;
+        return state->terminal_rows - active_file->ruler_pane_height - pinned_height - 2;
 }
 
 unsigned int state_get_sequence_pane_width(State *state)
@@ -110,6 +238,59 @@ unsigned int state_get_sequence_pane_width(State *state)
         return state->terminal_cols - active_file->header_pane_width;
 }
 
+// State synchronization
+int state_init_sync(State *state)
+{
+    pthread_mutexattr_t attr;
+    if (pthread_mutexattr_init(&attr) != 0)
+        return 1;
+    int code = 0;
+    if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0 ||
+        pthread_mutex_init(&state->lock, &attr) != 0)
+        code = 1;
+    else if (pthread_cond_init(&state->loaded, NULL) != 0)
+    {
+        pthread_mutex_destroy(&state->lock);
+        code = 1;
+    }
+    pthread_mutexattr_destroy(&attr);
+    if (code != 0)
+        return code;
+
+    // Neither end blocks, so a full pipe drops wakes that are already pending, and draining stops when it is empty
+    if (pipe(state->wake_fds) != 0)
+        goto error;
+    for (int i = 0; i < 2; i++)
+    {
+        int flags = fcntl(state->wake_fds[i], F_GETFL);
+        if (flags == -1 || fcntl(state->wake_fds[i], F_SETFL, flags | O_NONBLOCK) == -1 ||
+            fcntl(state->wake_fds[i], F_SETFD, FD_CLOEXEC) == -1)
+        {
+            close(state->wake_fds[0]);
+            close(state->wake_fds[1]);
+            goto error;
+        }
+    }
+    state->wake_pending = false;
+    return 0;
+
+error:
+    pthread_cond_destroy(&state->loaded);
+    pthread_mutex_destroy(&state->lock);
+    return 1;
+}
+
+void state_wake(State *state)
+{
+    // Called under the lock by background jobs after changes the display shows
+    if (state->wake_pending)
+        return;
+    state->wake_pending = true;
+    char c = 0;
+    if (write(state->wake_fds[1], &c, 1) != 1)
+        return; // Only fails if the pipe is full, in which case the main loop is woken already
+}
+
 // State setters
 void state_set_active_file_index(State *state, unsigned int file_index)
 {
@@ -132,5 +313,6 @@ void state_set_type_color_scheme(State *state, unsigned int type_index, ColorSch
     SeqTypeState *type = state->types + type_index;
     if (type->alphabet->len != color_scheme->len)
         return;
+    color_compile_color_scheme(color_scheme, type->alphabet->index_map); // Tables follow the alphabet of the type
     type->color_scheme = color_scheme;
 }
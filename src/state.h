@@ -5,10 +5,14 @@
  * Program state
  */
 
+#include <pthread.h>
 #include <stdbool.h>
 
+#include "arena.h"
 #include "array.h"
 #include "color.h"
+#include "fasta.h"
+#include "profile.h"
 #include "sequences.h"
 
 typedef struct
@@ -27,6 +31,38 @@ typedef struct
     size_t nrecords;
     size_t records_maxlen;
     size_t records_offset;
+    Arena arena;                 // Backs records read from a stream
+    FastaMap map;                // Backs records if set by a mapped reader
+    SeqType forced_type;         // Type for records resolved after reading
+    size_t nucleic_tiebreak_len; // Length for calling indeterminate records resolved after reading nucleic
+    size_t type_sample_len;      // Length from which records resolved after reading are typed from a sample
+    bool loading;                // Records are still being appended by a loader
+    bool follow;                 // Scroll to records appended by a loader unless scrolled away from the end
+    bool pack;                   // Pack residues of records appended by a loader
+    size_t follow_offset;        // Offset record last set by following
+    bool nonascii;               // Loader typed at least one record containing non-ASCII symbols
+    bool nonascii_confirmed;     // Non-ASCII symbols were confirmed at a prompt, so the file is viewed without asking
+    bool index_failed;           // Index of a file read from disk failed to write
+    bool cache_failed;           // Cache of a file read from disk failed to write
+    int loader_code;             // Reader code once loading finishes
+    int resolve_code;            // First error resolving records read from an index, whose failed blocks are null
+    bool show_profile;           // Show the column profile in the ruler pane
+    unsigned int profile_height; // Rows the ruler pane grew by when the profile was shown, returned when hidden
+    bool profile_requested;      // Profile is being or has been built
+    bool profiling;              // Profile is still being built in the background
+    int profile_code;            // Profile error code if the profile could not be built
+    Profile profile;             // Columns of chunks marked done may be read under the state lock
+    bool show_dots;              // Show residues identical to the reference record's as dots
+    size_t reference_index;      // Record pinned atop the record panes while showing dots
+    bool show_identities;        // Show identities to the identity reference in the header pane
+    bool sort_identities;        // Order rows by identity to the identity reference, which then stays fixed
+    bool identifying;            // Identities are still being computed in the background
+    bool identity_failed;        // Identities could not be allocated
+    size_t identity_reference;   // Record whose identities are cached
+    size_t identity_generation;  // Incremented as the identity reference changes, so stale results are dropped
+    size_t nidentities_done;
+    float *identities;           // Per record, or IDENTITY_PENDING until computed; read under the state lock
+    size_t *row_records;         // Record shown in each row while rows are sorted, else NULL
 } FileState;
 
 typedef struct
@@ -54,9 +90,18 @@ typedef struct
     ColorScheme *color_schemes;
     unsigned int n_color_schemes;
     int ncolors;
+    // Terminal capability variables
+    bool scroll_rows;   // Scroll regions and multi-line scrolls, so record panes scroll rather than redraw
+    bool shift_columns; // Character deletes and inserts, so sequence panes shift rather than redraw
     // Type variables
     SeqTypeState *types;
     unsigned int ntypes;
+    // Synchronization variables
+    pthread_mutex_t lock;  // Recursive; guards files while loaders run
+    pthread_cond_t loaded; // Broadcast when loaders append records or finish
+    int wake_fds[2];       // Self-pipe the main loop polls; background jobs and signal handlers write to wake it
+    bool wake_pending;     // Set while a wake is unread, so jobs write once between refreshes; guarded by lock
+    unsigned int nworkers; // Background threads that may still read files; guarded by lock
 } State;
 
 // FileState setters
@@ -70,10 +115,24 @@ void state_set_cursor_record_i(State *state, unsigned int cursor_record_i);
 void state_set_cursor_header_j(State *state, unsigned int cursor_header_j);
 void state_set_cursor_sequence_j(State *state, unsigned int cursor_sequence_j);
 
+// FileState records
+void state_resolve_record(State *state, size_t record_index);
+void state_prepare_record(FileState *file, size_t record_index);
+void state_free_file(FileState *file);
+int state_sort_rows(FileState *file);
+void state_unsort_rows(FileState *file);
+
 // FileState getters
+size_t state_get_row_record(const FileState *file, size_t row);
+size_t state_get_cursor_record(State *state);
+unsigned int state_get_pinned_height(State *state);
 unsigned int state_get_record_panes_height(State *state);
 unsigned int state_get_sequence_pane_width(State *state);
 
+// State synchronization
+int state_init_sync(State *state);
+void state_wake(State *state);
+
 // State setters
 void state_set_active_file_index(State *state, unsigned int file_index);
 void state_set_type_color_scheme(State *state, unsigned int type_index, ColorScheme *color_scheme);
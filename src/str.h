@@ -5,6 +5,8 @@
  * String functions
  */
 
+#include <sys/types.h>
+
 typedef struct
 {
     char **data;
@@ -125,66 +125,3 @@ void terminal_clear_line_right(Array *buffer)
     char s[] = "\x1b[0K";
     array_extend(buffer, s, sizeof(s) - 1);
 }
-
-void terminal_set_foreground_color_4bit(Array *buffer, const Color4Bit color)
-{
-    char s[7];
-    int len = sprintf(s, "\x1b[%dm", color);
-    array_extend(buffer, s, len);
-}
-
-void terminal_set_background_color_4bit(Array *buffer, const Color4Bit color)
-{
-    char s[7];
-    int len = sprintf(s, "\x1b[%dm", color);
-    array_extend(buffer, s, len);
-}
-
-void terminal_set_color_4bit(Array *buffer, const Color4Bit fg_color, const Color4Bit bg_color)
-
-{
-    char s[11];
-    int len = sprintf(s, "\x1b[%d;%dm", fg_color, bg_color);
-    array_extend(buffer, s, len);
-}
-
-void terminal_set_foreground_color_8bit(Array *buffer, const Color8Bit color)
-{
-
-    char s[12];
-    int len = sprintf(s, "\x1b[38;5;%dm", color);
-    array_extend(buffer, s, len);
-}
-
-void terminal_set_background_color_8bit(Array *buffer, const Color8Bit color)
-{
-
-    char s[12];
-    int len = sprintf(s, "\x1b[48;5;%dm", color);
-    array_extend(buffer, s, len);
-}
-
-void terminal_set_color_8bit(Array *buffer, const Color8Bit fg_color, const Color8Bit bg_color)
-{
-    char s[21];
-    int len = sprintf(s, "\x1b[38;5;%d;48;5;%dm", fg_color, bg_color);
-    array_extend(buffer, s, len);
-}
-
-void terminal_set_foreground_color_default(Array *buffer)
-{
-    char s[] = "\x1b[39m";
-    array_extend(buffer, s, sizeof(s) - 1);
-}
-
-void terminal_set_background_color_default(Array *buffer)
-{
-    char s[] = "\x1b[49m";
-    array_extend(buffer, s, sizeof(s) - 1);
-}
-
-void terminal_set_color_default(Array *buffer)
-{
-    char s[] = "\x1b[39;49m";
-    array_extend(buffer, s, sizeof(s) - 1);
-}
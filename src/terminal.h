@@ -63,14 +63,5 @@ void terminal_clear_screen(Array *buffer);
 void terminal_clear_line(Array *buffer);
 void terminal_clear_line_left(Array *buffer);
 void terminal_clear_line_right(Array *buffer);
-void terminal_set_foreground_color_4bit(Array *buffer, const Color4Bit color);
-void terminal_set_background_color_4bit(Array *buffer, const Color4Bit color);
-void terminal_set_color_4bit(Array *buffer, const Color4Bit fg_color, const Color4Bit bg_color);
-void terminal_set_foreground_color_8bit(Array *buffer, const Color8Bit color);
-void terminal_set_background_color_8bit(Array *buffer, const Color8Bit color);
-void terminal_set_color_8bit(Array *buffer, const Color8Bit fg_color, const Color8Bit bg_color);
-void terminal_set_foreground_color_default(Array *buffer);
-void terminal_set_background_color_default(Array *buffer);
-void terminal_set_color_default(Array *buffer);
 
 #endif // TERMINAL_H
@@ -0,0 +1,104 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tiles.h"
+
+#define TILE_SIZE ((size_t)TILES_NROWS * TILES_NCOLS)
+
+const int TILES_ERROR_MEMORY_ALLOCATION = -1;
+
+int tiles_init(Tiles *tiles, size_t nrows, size_t ncols)
+{
+    size_t nbands = (nrows + TILES_NROWS - 1) / TILES_NROWS;
+    size_t ntile_cols = (ncols + TILES_NCOLS - 1) / TILES_NCOLS;
+    tiles->data = NULL;
+    if (ntile_cols > 0 && nbands > SIZE_MAX / TILE_SIZE / ntile_cols)
+        return TILES_ERROR_MEMORY_ALLOCATION;
+    if (nbands > 0 && ntile_cols > 0 && (tiles->data = calloc(nbands * ntile_cols, TILE_SIZE)) == NULL) // Zeroes pad
+        return TILES_ERROR_MEMORY_ALLOCATION;
+    tiles->nrows = nrows;
+    tiles->ncols = ncols;
+    tiles->nbands = nbands;
+    tiles->ntile_cols = ntile_cols;
+    return 0;
+}
+
+void tiles_free(Tiles *tiles)
+{
+    free(tiles->data);
+    tiles->data = NULL;
+    tiles->nbands = 0;
+}
+
+void tiles_fill_tile(Tiles *tiles, size_t band, size_t tile_col, SeqRecord *records)
+{
+    // Fills a tile from the records of its band, which start at records
+    if (band >= tiles->nbands || tile_col >= tiles->ntile_cols)
+        return;
+    size_t nrows = tiles->nrows - band * TILES_NROWS;
+    if (nrows > TILES_NROWS)
+        nrows = TILES_NROWS;
+
+    // Rows are fetched a tile's width at a time, so packed rows are decoded once per tile
+    char window[TILES_NCOLS];
+    size_t start = tile_col * TILES_NCOLS;
+    char *tile = tiles->data + (band * tiles->ntile_cols + tile_col) * TILE_SIZE;
+    for (size_t i = 0; i < nrows; i++)
+    {
+        SeqRecord *record = records + i;
+        size_t len = (record->len < tiles->ncols) ? record->len : tiles->ncols;
+        if (len <= start)
+            continue;
+        size_t n = (len - start < TILES_NCOLS) ? len - start : TILES_NCOLS;
+        const char *seq = sequences_get_window(record, start, n, window);
+        for (size_t j = 0; j < n; j++)
+            tile[j * TILES_NROWS + i] = seq[j];
+    }
+}
+
+const char *tiles_get_column(const Tiles *tiles, size_t band, size_t column)
+{
+    // Returns the TILES_NROWS cells of a band in column
+    return tiles->data + (band * tiles->ntile_cols + column / TILES_NCOLS) * TILE_SIZE +
+           column % TILES_NCOLS * TILES_NROWS;
+}
+
+void tiles_count_columns(const Tiles *tiles, size_t start, size_t ncols, const unsigned char classes[256],
+                         unsigned int nclasses, uint32_t *counts)
+{
+    // Adds counts of each class of cell in all bands to counts, which hold nclasses entries per column
+    if (start >= tiles->ncols)
+        return;
+    if (ncols > tiles->ncols - start)
+        ncols = tiles->ncols - start;
+    for (size_t band = 0; band < tiles->nbands; band++)
+    {
+        size_t j = 0;
+        while (j < ncols)
+        {
+            // Columns are contiguous to the end of their tile, and neighbors are counted together for independent adds
+            size_t end = j + TILES_NCOLS - (start + j) % TILES_NCOLS;
+            if (end > ncols)
+                end = ncols;
+            const unsigned char *cells = (const unsigned char *)tiles_get_column(tiles, band, start + j);
+            for (; j + 4 <= end; j += 4, cells += 4 * TILES_NROWS)
+            {
+                uint32_t *column_counts = counts + j * nclasses;
+                for (unsigned int i = 0; i < TILES_NROWS; i++)
+                {
+                    column_counts[classes[cells[i]]]++;
+                    column_counts[nclasses + classes[cells[TILES_NROWS + i]]]++;
+                    column_counts[2 * nclasses + classes[cells[2 * TILES_NROWS + i]]]++;
+                    column_counts[3 * nclasses + classes[cells[3 * TILES_NROWS + i]]]++;
+                }
+            }
+            for (; j < end; j++, cells += TILES_NROWS)
+            {
+                uint32_t *column_counts = counts + j * nclasses;
+                for (unsigned int i = 0; i < TILES_NROWS; i++)
+                    column_counts[classes[cells[i]]]++;
+            }
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef TILES_H
+#define TILES_H
+
+/*
+ * Column-major tiled copies of alignments
+ *
+ * Tiles hold TILES_NROWS rows by TILES_NCOLS columns with each column's rows contiguous, so column-wise scans read
+ * memory in order rather than striding across row buffers. A band is a row of tiles. Tiles are filled one at a time in
+ * any order, so separate threads may fill separate tiles; cells outside the alignment's rows or not yet filled are
+ * zero, so scans should give zero a class of its own.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sequences.h"
+
+#define TILES_NROWS 64
+#define TILES_NCOLS 4096
+
+extern const int TILES_ERROR_MEMORY_ALLOCATION;
+
+typedef struct
+{
+    char *data;
+    size_t nrows;
+    size_t ncols;
+    size_t nbands;
+    size_t ntile_cols;
+} Tiles;
+
+int tiles_init(Tiles *tiles, size_t nrows, size_t ncols);
+void tiles_free(Tiles *tiles);
+void tiles_fill_tile(Tiles *tiles, size_t band, size_t tile_col, SeqRecord *records);
+const char *tiles_get_column(const Tiles *tiles, size_t band, size_t column);
+void tiles_count_columns(const Tiles *tiles, size_t start, size_t ncols, const unsigned char classes[256],
+                         unsigned int nclasses, uint32_t *counts);
+
+#endif // TILES_H
@@ -0,0 +1,133 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arena.h"
+#include "utils.h"
+
+#define MODULE_NAME "test_arena"
+
+int test_alloc(void)
+{
+    int code = 0;
+    Arena arena;
+    arena_init(&arena, 64);
+
+    // Fill several blocks and check earlier allocations are undisturbed
+    char *ptrs[100];
+    for (int i = 0; i < 100; i++)
+    {
+        ptrs[i] = arena_alloc(&arena, 10);
+        if (ptrs[i] == NULL)
+        {
+            code = 1;
+            goto cleanup;
+        }
+        memset(ptrs[i], i, 10);
+    }
+    for (int i = 0; i < 100; i++)
+    {
+        for (int j = 0; j < 10; j++)
+        {
+            if (ptrs[i][j] != i)
+            {
+                code = 2;
+                goto cleanup;
+            }
+        }
+    }
+
+cleanup:
+    arena_free(&arena);
+    return code;
+}
+
+int test_alloc_oversized(void)
+{
+    int code = 0;
+    Arena arena;
+    arena_init(&arena, 64);
+
+    char *small = arena_alloc(&arena, 8);
+    char *large = arena_alloc(&arena, 1000);
+    char *next = arena_alloc(&arena, 8);
+    if (small == NULL || large == NULL || next == NULL)
+        code = 1;
+    else if (next != small + 8) // Oversized allocations leave the current block in use
+        code = 2;
+    else
+    {
+        memset(large, 'x', 1000);
+        memset(next, 'y', 8);
+        if (large[999] != 'x')
+            code = 3;
+    }
+    if (arena_alloc(&arena, SIZE_MAX) != NULL)
+        code = 4;
+
+    arena_free(&arena);
+    return code;
+}
+
+int test_zeroed(void)
+{
+    int code = 0;
+    Arena arena = {0};
+
+    char *ptr = arena_alloc(&arena, 100);
+    if (ptr == NULL)
+        code = 1;
+    arena_free(&arena);
+    if (arena.head != NULL)
+        code = 2;
+    arena_free(&arena); // Freeing twice is safe
+    return code;
+}
+
+int test_shrink(void)
+{
+    int code = 0;
+    Arena arena;
+    arena_init(&arena, 64);
+
+    // Shrunk space is handed out again
+    char *first = arena_alloc(&arena, 8);
+    char *last = arena_alloc(&arena, 32);
+    if (first == NULL || last == NULL || arena_shrink(&arena, last, 8) != last || arena_alloc(&arena, 8) != last + 8)
+    {
+        code = 1;
+        goto cleanup;
+    }
+
+    // Allocations with a block of their own keep their contents and leave the head in use
+    char *large = arena_alloc(&arena, 1000);
+    char *sole = arena_alloc(&arena, 48); // Too large for the rest of the head
+    if (large == NULL || sole == NULL)
+    {
+        code = 2;
+        goto cleanup;
+    }
+    memset(sole, 'y', 48);
+    sole = arena_shrink(&arena, sole, 10);
+    memset(large, 'x', 1000); // Shrinks only apply to the latest allocation
+    if (arena_shrink(&arena, large, 100) != large || sole[9] != 'y' || arena_alloc(&arena, 8) != last + 16)
+        code = 3;
+
+cleanup:
+    arena_free(&arena);
+    return code;
+}
+
+TestFunction tests[] = {
+    {&test_alloc, "test_alloc"},
+    {&test_alloc_oversized, "test_alloc_oversized"},
+    {&test_shrink, "test_shrink"},
+    {&test_zeroed, "test_zeroed"},
+};
+
+#define NTESTS sizeof(tests) / sizeof(TestFunction)
+
+int main(void)
+{
+    run_tests(tests, NTESTS, MODULE_NAME);
+}
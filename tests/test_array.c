@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include <stdio.h>
 
 #include "array.h"
@@ -206,12 +207,48 @@ cleanup:
     return code;
 }
 
+int test_reserve(void)
+{
+    int code = 0;
+    Array array;
+    int value;
+
+    value = array_init(&array, sizeof(int));
+    if (value != 0)
+    {
+        code = 1;
+        goto cleanup;
+    }
+    size_t capacity = array.capacity;
+    array_reserve(&array, capacity - 1);
+    if (array.capacity != capacity)
+    {
+        code = 2;
+        goto cleanup;
+    }
+    array_reserve(&array, 10 * capacity + 1);
+    if (array.capacity < 10 * capacity + 1 || array.len != 0)
+    {
+        code = 3;
+        goto cleanup;
+    }
+    if (array_reserve(&array, SIZE_MAX) == 0)
+    {
+        code = 4;
+        goto cleanup;
+    }
+cleanup:
+    array_free(&array);
+    return code;
+}
+
 TestFunction tests[] = {
     {&test_init, "test_init"},
     {&test_append_get, "test_append"},
     {&test_extend_get, "test_extend"},
     {&test_get_out_of_bounds, "test_get_out_of_bounds"},
     {&test_shrink, "test_shrink"},
+    {&test_reserve, "test_reserve"},
 };
 
 #define NTESTS sizeof(tests) / sizeof(TestFunction)
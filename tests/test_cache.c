@@ -0,0 +1,179 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "fasta.h"
+#include "sequences.h"
+#include "utils.h"
+
+#define MODULE_NAME "test_cache"
+
+#define FASTA ">id1 metadata1\nACGTACGT\nACG\n>id2\nMKLVWY\n>id3 metadata3\n\n"
+
+char cache_dir[] = "/tmp/test_cache_XXXXXX";
+char path[] = "/tmp/test_cache_fasta_XXXXXX";
+
+int write_fasta(const char *data)
+{
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+        return 1;
+    fputs(data, fp);
+    return fclose(fp) != 0;
+}
+
+int read_and_cache(struct stat *sb, CacheInfo *info)
+{
+    // Reads the FASTA from path, types its records, and caches them
+    int fd = open(path, O_RDONLY);
+    if (fd == -1 || fstat(fd, sb) != 0)
+        return 1;
+    FastaMap map;
+    SeqRecord *records = NULL;
+    int nrecords = fasta_mmap_read(fd, &map, &records);
+    close(fd);
+    if (nrecords != 3)
+        return 2;
+    info->maxlen = 0;
+    info->nonascii = false;
+    for (int i = 0; i < nrecords; i++)
+    {
+        sequences_assign_seq_type(records + i, info->forced_type, info->nucleic_tiebreak_len, info->type_sample_len);
+        if (records[i].len > info->maxlen)
+            info->maxlen = records[i].len;
+    }
+    int code = cache_write(path, sb, info, records, nrecords) != 0 ? 3 : 0;
+    free(records);
+    fasta_munmap(&map);
+    return code;
+}
+
+int test_read_write(void)
+{
+    int code = 0;
+    if (write_fasta(FASTA) != 0)
+        return 1;
+    struct stat sb;
+    CacheInfo info = {.forced_type = SEQ_TYPE_UNSPECIFIED, .nucleic_tiebreak_len = 0};
+    if ((code = read_and_cache(&sb, &info)) != 0)
+        return code + 1;
+
+    CacheInfo cached_info = {.forced_type = SEQ_TYPE_UNSPECIFIED, .nucleic_tiebreak_len = 0};
+    FastaMap map;
+    SeqRecord *records = NULL;
+    int nrecords = cache_read(path, &sb, &cached_info, &map, &records);
+    if (nrecords != 3 || cached_info.maxlen != 11 || cached_info.nonascii)
+        return 5;
+    SeqRecord expected[] = {
+        {.header = "id1 metadata1", .id = "id1", .seq = "ACGTACGTACG", .type = SEQ_TYPE_NUCLEIC},
+        {.header = "id2", .id = "id2", .seq = "MKLVWY", .type = SEQ_TYPE_PROTEIN},
+        {.header = "id3 metadata3", .id = "id3", .seq = ""},
+    };
+    for (int i = 0; i < nrecords; i++)
+    {
+        SeqRecord *record = records + i;
+        if (record->header_len != strlen(expected[i].header) ||
+            memcmp(record->header, expected[i].header, record->header_len) != 0 ||
+            record->id_len != strlen(expected[i].id) || memcmp(record->id, expected[i].id, record->id_len) != 0 ||
+            record->len != strlen(expected[i].seq) || memcmp(record->seq, expected[i].seq, record->len) != 0 ||
+            (expected[i].type != SEQ_TYPE_UNSPECIFIED && record->type != expected[i].type))
+            code = 6;
+    }
+    free(records);
+    fasta_munmap(&map);
+    return code;
+}
+
+int test_read_window(void)
+{
+    // Records read from a cache are plain residues, however the heap they are allocated from was left
+    if (write_fasta(FASTA) != 0)
+        return 1;
+    struct stat sb;
+    CacheInfo info = {.forced_type = SEQ_TYPE_UNSPECIFIED, .nucleic_tiebreak_len = 0};
+    if (read_and_cache(&sb, &info) != 0)
+        return 2;
+    size_t dirty_size = 3 * sizeof(SeqRecord);
+    unsigned char *dirty = malloc(dirty_size); // Likely reused for the records, so fields left unset are nonzero
+    if (dirty == NULL)
+        return 3;
+    memset(dirty, 0xff, dirty_size);
+    free(dirty);
+
+    FastaMap map;
+    SeqRecord *records = NULL;
+    if (cache_read(path, &sb, &info, &map, &records) != 3)
+        return 4;
+    int code = 0;
+    char buffer[8];
+    const char *window = sequences_get_window(records, 2, 8, buffer);
+    if (records[0].packed_bits != 0 || records[0].ngap_runs != 0 || memcmp(window, "GTACGTAC", 8) != 0)
+        code = 5;
+    window = sequences_get_window(records + 1, 1, 4, buffer);
+    if (records[1].packed_bits != 0 || records[1].ngap_runs != 0 || memcmp(window, "KLVW", 4) != 0)
+        code = 6;
+    free(records);
+    fasta_munmap(&map);
+    return code;
+}
+
+int test_stale(void)
+{
+    if (write_fasta(FASTA) != 0)
+        return 1;
+    struct stat sb;
+    CacheInfo info = {.forced_type = SEQ_TYPE_UNSPECIFIED, .nucleic_tiebreak_len = 0};
+    if (read_and_cache(&sb, &info) != 0)
+        return 2;
+
+    // Type settings are part of the key
+    FastaMap map;
+    SeqRecord *records = NULL;
+    CacheInfo forced_info = {.forced_type = SEQ_TYPE_PROTEIN, .nucleic_tiebreak_len = 0};
+    if (cache_read(path, &sb, &forced_info, &map, &records) != CACHE_ERROR_STALE)
+        return 3;
+
+    // So is the file's size
+    if (write_fasta(FASTA ">id4\nA\n") != 0 || stat(path, &sb) != 0)
+        return 4;
+    if (cache_read(path, &sb, &info, &map, &records) != CACHE_ERROR_STALE)
+        return 5;
+    return 0;
+}
+
+TestFunction tests[] = {
+    {&test_read_write, "test_read_write"},
+    {&test_read_window, "test_read_window"},
+    {&test_stale, "test_stale"},
+};
+
+#define NTESTS sizeof(tests) / sizeof(TestFunction)
+
+int main(void)
+{
+    // Keep caches out of the user's cache directory
+    if (mkdtemp(cache_dir) == NULL || setenv("XDG_CACHE_HOME", cache_dir, 1) != 0)
+        return 1;
+    if (sequences_init_base_alphabets() != 0)
+        return 1;
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return 1;
+    close(fd);
+
+    run_tests(tests, NTESTS, MODULE_NAME);
+
+    char *cache_path = cache_get_path(path);
+    if (cache_path != NULL)
+        remove(cache_path);
+    free(cache_path);
+    remove(path);
+    char aalv_dir[sizeof(cache_dir) + sizeof("/aalv")];
+    snprintf(aalv_dir, sizeof(aalv_dir), "%s/aalv", cache_dir);
+    rmdir(aalv_dir);
+    rmdir(cache_dir);
+}
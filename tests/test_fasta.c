@@ -1,7 +1,13 @@
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <zlib.h>
+
+#include "arena.h"
 #include "fasta.h"
 #include "sequences.h"
 #include "utils.h"
@@ -11,10 +17,13 @@
 #define SEQ1 "This is the first sequence."
 #define SEQ2 "This is the second sequence. It is a bit longer than the first."
 #define SEQ3 "This is the third sequence in the array!"
+#define HEADER1 "id1 metadata1"
+#define HEADER2 "id2 metadata2"
+#define HEADER3 "id3 metadata3"
 SeqRecord records[] = {
-    {.header = "id1 metadata1", .seq = SEQ1, .len = sizeof(SEQ1) - 1},
-    {.header = "id2 metadata2", .seq = SEQ2, .len = sizeof(SEQ2) - 1},
-    {.header = "id3 metadata3", .seq = SEQ3, .len = sizeof(SEQ3) - 1},
+    {.header = HEADER1, .seq = SEQ1, .header_len = sizeof(HEADER1) - 1, .len = sizeof(SEQ1) - 1},
+    {.header = HEADER2, .seq = SEQ2, .header_len = sizeof(HEADER2) - 1, .len = sizeof(SEQ2) - 1},
+    {.header = HEADER3, .seq = SEQ3, .header_len = sizeof(HEADER3) - 1, .len = sizeof(SEQ3) - 1},
 };
 #define NRECORDS sizeof(records) / sizeof(SeqRecord)
 #define BUFFERLEN 1024 // Must be large enough to hold above SeqRecords
@@ -25,11 +34,13 @@ int records_equal(SeqRecord *records_1, SeqRecord *records_2, int nrecords)
     for (int i = 0; i < nrecords; i++)
     {
         SeqRecord record_1, record_2;
+        sequences_compact_seq(records_1 + i);
+        sequences_compact_seq(records_2 + i);
         record_1 = records_1[i];
         record_2 = records_2[i];
-        if (strcmp(record_1.header, record_2.header) != 0)
+        if (record_1.header_len != record_2.header_len || memcmp(record_1.header, record_2.header, record_1.header_len) != 0)
             return 0;
-        if (strcmp(record_1.seq, record_2.seq) != 0)
+        if (record_1.len != record_2.len || memcmp(record_1.seq, record_2.seq, record_1.len) != 0)
             return 0;
     }
     return 1;
@@ -56,16 +67,153 @@ int test_read_write(void)
 {
     int code = 0;
     char buffer[BUFFERLEN];
-    FILE *fp = fmemopen(buffer, BUFFERLEN, "rw");
+    FILE *fp = fmemopen(buffer, BUFFERLEN, "w+");
     fasta_fwrite(fp, records, NRECORDS, MAXLEN);
     fseek(fp, 0, SEEK_SET);
+    Arena arena;
+    arena_init(&arena, 0);
     SeqRecord *new_records = NULL;
-    int nrecords = fasta_fread(fp, &new_records);
+    int nrecords = fasta_fread(fp, &arena, &new_records);
     if (nrecords != NRECORDS)
         code = 1;
     else if (records_equal(records, new_records, NRECORDS) != 1)
         code = 1;
-    sequences_free_seq_records(new_records, nrecords);
+    free(new_records);
+    arena_free(&arena);
+    fclose(fp);
+    return code;
+}
+
+int test_fdwrite(void)
+{
+    // Buffered writer matches stdio writer, including runs long enough to be written directly from records
+    int code = 0;
+    size_t long_len = 5000;
+    char *long_seq = malloc(long_len);
+    SeqRecord long_records[20];
+    if (long_seq == NULL)
+        return 1;
+    for (size_t i = 0; i < long_len; i++)
+        long_seq[i] = "ACGT"[i % 7 % 4];
+    for (int i = 0; i < 20; i++)
+        long_records[i] = (SeqRecord){.header = HEADER1, .seq = long_seq, .header_len = sizeof(HEADER1) - 1,
+                                      .len = long_len - i};
+
+    size_t line_lens[] = {0, 1, MAXLEN, 4096};
+    for (unsigned int i = 0; i < sizeof(line_lens) / sizeof(line_lens[0]) && code == 0; i++)
+    {
+        FILE *expected_fp = tmpfile();
+        FILE *fp = tmpfile();
+        fasta_fwrite(expected_fp, records, NRECORDS, line_lens[i]);
+        fasta_fwrite(expected_fp, long_records, 20, line_lens[i]);
+        fflush(expected_fp);
+        if (fasta_fdwrite(fileno(fp), records, NRECORDS, line_lens[i]) != 0 ||
+            fasta_fdwrite(fileno(fp), long_records, 20, line_lens[i]) != 0)
+            code = 2;
+        long expected_len = ftell(expected_fp);
+        if (code == 0 && lseek(fileno(fp), 0, SEEK_END) != expected_len)
+            code = 3;
+        rewind(expected_fp);
+        rewind(fp);
+        int c;
+        while (code == 0 && (c = fgetc(expected_fp)) != EOF)
+            if (fgetc(fp) != c)
+                code = 4;
+        fclose(expected_fp);
+        fclose(fp);
+    }
+    free(long_seq);
+    return code;
+}
+
+int test_write_atomic(void)
+{
+    int code = 0;
+    char path[] = "/tmp/test_fasta_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return 1;
+    fchmod(fd, 0640);
+    close(fd);
+
+    if (fasta_write(path, records, NRECORDS, MAXLEN, true) != 0)
+        code = 2;
+    struct stat sb;
+    if (code == 0 && (stat(path, &sb) != 0 || (sb.st_mode & 0777) != 0640)) // Permissions of replaced file are kept
+        code = 3;
+    Arena arena;
+    arena_init(&arena, 0);
+    SeqRecord *new_records = NULL;
+    if (code == 0 && (fasta_read(path, &arena, &new_records) != NRECORDS ||
+                      records_equal(records, new_records, NRECORDS) != 1))
+        code = 4;
+    free(new_records);
+    arena_free(&arena);
+    remove(path);
+    return code;
+}
+
+int stop_after_first(SeqRecord *record, void *data)
+{
+    SeqRecord *first = data;
+    if (first->seq != NULL)
+        return -1;
+    *first = *record;
+    return 0;
+}
+
+int test_read_records(void)
+{
+    int code = 0;
+    char buffer[BUFFERLEN];
+    FILE *fp = fmemopen(buffer, BUFFERLEN, "w+");
+    fasta_fwrite(fp, records, NRECORDS, MAXLEN);
+    fseek(fp, 0, SEEK_SET);
+    Arena arena;
+    arena_init(&arena, 0);
+    SeqRecord first = {.seq = NULL};
+    if (fasta_fread_records(fp, &arena, &stop_after_first, &first) != -1) // Callback codes are passed through
+        code = 1;
+    else if (records_equal(records, &first, 1) != 1)
+        code = 1;
+    arena_free(&arena);
+    fclose(fp);
+    return code;
+}
+
+int test_long_lines(void)
+{
+    int code = 0;
+    size_t len = 1000000; // Longer than a read chunk
+    char *seq = malloc(len);
+    FILE *fp = tmpfile(); // Backed by a file descriptor, unlike fmemopen
+    if (seq == NULL || fp == NULL)
+    {
+        free(seq);
+        if (fp != NULL)
+            fclose(fp);
+        return 1;
+    }
+    for (size_t i = 0; i < len; i++)
+        seq[i] = "ACGT"[i % 4];
+    fputs(">long\r\n", fp);
+    fwrite(seq, sizeof(char), len, fp);
+    fputs("\r\n>short\r\nAC\r\nGT", fp);
+    fseek(fp, 0, SEEK_SET);
+
+    Arena arena;
+    arena_init(&arena, 0);
+    SeqRecord *new_records = NULL;
+    int nrecords = fasta_fread(fp, &arena, &new_records);
+    if (nrecords != 2)
+        code = 1;
+    else if (new_records[0].header_len != 4 || new_records[0].len != len || memcmp(new_records[0].seq, seq, len) != 0)
+        code = 2;
+    else if (new_records[1].len != 4 || strcmp(new_records[1].seq, "ACGT") != 0)
+        code = 3;
+    free(new_records);
+    arena_free(&arena);
+    free(seq);
     fclose(fp);
     return code;
 }
@@ -74,15 +222,18 @@ int test_no_header(void)
 {
     int code = 0;
     char buffer[BUFFERLEN];
-    FILE *fp = fmemopen(buffer, BUFFERLEN, "rw");
+    FILE *fp = fmemopen(buffer, BUFFERLEN, "w+");
     fasta_wrap_string(fp, records[0].seq, records[0].len, MAXLEN);
     fasta_fwrite(fp, records + 1, NRECORDS - 1, MAXLEN);
     fseek(fp, 0, SEEK_SET);
+    Arena arena;
+    arena_init(&arena, 0);
     SeqRecord *new_records = NULL;
-    int nrecords = fasta_fread(fp, &new_records);
+    int nrecords = fasta_fread(fp, &arena, &new_records);
     if (nrecords != FASTA_ERROR_INVALID_FORMAT)
         code = 1;
-    sequences_free_seq_records(new_records, nrecords);
+    free(new_records);
+    arena_free(&arena);
     fclose(fp);
     return code;
 }
@@ -91,13 +242,16 @@ int test_empty_file(void)
 {
     int code = 0;
     char buffer[BUFFERLEN];
-    FILE *fp = fmemopen(buffer, 1, "rw");
+    FILE *fp = fmemopen(buffer, 1, "r");
     fgetc(fp); // Consume the single byte of buffer
+    Arena arena;
+    arena_init(&arena, 0);
     SeqRecord *new_records = NULL;
-    int nrecords = fasta_fread(fp, &new_records);
+    int nrecords = fasta_fread(fp, &arena, &new_records);
     if (nrecords != 0)
         code = 1;
-    sequences_free_seq_records(new_records, nrecords);
+    free(new_records);
+    arena_free(&arena);
     fclose(fp);
     return code;
 }
@@ -106,7 +260,7 @@ int test_blank_lines(void)
 {
     int code = 0;
     char buffer[BUFFERLEN];
-    FILE *fp = fmemopen(buffer, BUFFERLEN, "rw");
+    FILE *fp = fmemopen(buffer, BUFFERLEN, "w+");
     fputs("\n\n\n", fp);
     for (size_t i = 0; i < NRECORDS; i++) // To match NRECORDS type
     {
@@ -115,13 +269,16 @@ int test_blank_lines(void)
         wrap_string_with_blanks(fp, record.seq, record.len, MAXLEN);
     }
     fseek(fp, 0, SEEK_SET);
+    Arena arena;
+    arena_init(&arena, 0);
     SeqRecord *new_records = NULL;
-    int nrecords = fasta_fread(fp, &new_records);
+    int nrecords = fasta_fread(fp, &arena, &new_records);
     if (nrecords != NRECORDS)
         code = 1;
     else if (records_equal(records, new_records, NRECORDS) != 1)
         code = 1;
-    sequences_free_seq_records(new_records, nrecords);
+    free(new_records);
+    arena_free(&arena);
     fclose(fp);
     return code;
 }
@@ -133,13 +290,483 @@ int test_non_fasta(void)
         "Here's a multiline\n"
         "file that's definitely not\n"
         "a FASTA.";
-    FILE *fp = fmemopen(buffer, BUFFERLEN, "rw");
+    FILE *fp = fmemopen(buffer, BUFFERLEN, "r");
+    Arena arena;
+    arena_init(&arena, 0);
     SeqRecord *new_records = NULL;
-    int nrecords = fasta_fread(fp, &new_records);
+    int nrecords = fasta_fread(fp, &arena, &new_records);
     if (nrecords != FASTA_ERROR_INVALID_FORMAT)
         code = 1;
-    sequences_free_seq_records(new_records, nrecords);
+    free(new_records);
+    arena_free(&arena);
+    fclose(fp);
+    return code;
+}
+
+int test_mmap_read(void)
+{
+    int code = 0;
+    FILE *fp = tmpfile();
+    if (fp == NULL)
+        return 1;
+    fputs("\n>", fp); // Leading blank line and an empty header
+    fputs("\n\n", fp);
+    for (size_t i = 0; i < NRECORDS; i++) // To match NRECORDS type
+    {
+        SeqRecord record = records[i];
+        fprintf(fp, ">%s\r\n", record.header);
+        wrap_string_with_blanks(fp, record.seq, record.len, MAXLEN);
+    }
+    fflush(fp);
+    FastaMap map;
+    SeqRecord *new_records = NULL;
+    int nrecords = fasta_mmap_read(fileno(fp), &map, &new_records);
+    if (nrecords != NRECORDS + 1)
+        code = 1;
+    else if (new_records[0].header_len != 0 || new_records[0].len != 0 || new_records[0].id_len != 0)
+        code = 2;
+    else if (new_records[1].id_len != 3 || memcmp(new_records[1].id, "id1", 3) != 0)
+        code = 3;
+    else if (records_equal(records, new_records + 1, NRECORDS) != 1)
+        code = 4;
+    free(new_records);
+    fasta_munmap(&map);
+    fclose(fp);
+    return code;
+}
+
+int records_unpacked(SeqRecord *new_records, size_t nrecords)
+{
+    // Checks that records of readers other than the packing loader are read as their residues
+    char buffer[BUFFERLEN];
+    for (size_t i = 0; i < nrecords; i++)
+    {
+        SeqRecord *record = new_records + i;
+        if (record->packed_bits != 0 || record->packed_nruns != 0 || record->packed_ncase_runs != 0 ||
+            record->gaps_offset != 0 || record->ngap_runs != 0)
+            return 0;
+        const char *window = sequences_get_window(record, 1, records[i].len - 1, buffer);
+        if (memcmp(window, records[i].seq + 1, records[i].len - 1) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+int test_readers_unpacked(void)
+{
+    int code = 0;
+    char path[] = "/tmp/test_fasta_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return 1;
+    char index_path[sizeof(path) + sizeof(FASTA_INDEX_EXT) - 1];
+    snprintf(index_path, sizeof(index_path), "%s%s", path, FASTA_INDEX_EXT);
+    FILE *fp = fdopen(fd, "w+");
+    fasta_fwrite(fp, records, NRECORDS, MAXLEN);
+    fflush(fp);
+
+    Arena arena;
+    arena_init(&arena, 0);
+    FastaMap map, index_map;
+    SeqRecord *read_records = NULL, *mapped_records = NULL, *index_records = NULL;
+    int index_nrecords = 0;
+    int nrecords = fasta_read(path, &arena, &read_records);
+    if (nrecords != NRECORDS || records_unpacked(read_records, nrecords) != 1)
+        code = 2;
+    int mapped_nrecords = fasta_mmap_read(fileno(fp), &map, &mapped_records);
+    if (code == 0 && (mapped_nrecords != NRECORDS || records_unpacked(mapped_records, mapped_nrecords) != 1))
+        code = 3;
+    if (code == 0 && fasta_index_write(index_path, &map, mapped_records, mapped_nrecords) != 0)
+        code = 4;
+    if (code == 0)
+        index_nrecords = fasta_index_read(index_path, fileno(fp), &index_map, &index_records);
+    if (code == 0 && (index_nrecords != NRECORDS || records_unpacked(index_records, index_nrecords) != 1))
+        code = 5;
+
+    free(read_records);
+    arena_free(&arena);
+    free(mapped_records);
+    if (mapped_nrecords > 0)
+        fasta_munmap(&map);
+    free(index_records);
+    if (index_nrecords > 0)
+        fasta_munmap(&index_map);
+    fclose(fp);
+    remove(path);
+    remove(index_path);
+    return code;
+}
+
+int test_mmap_parallel(void)
+{
+    int code = 0;
+    FILE *fp = tmpfile();
+    if (fp == NULL)
+        return 1;
+    fputs("\n", fp);
+    for (int i = 0; i < 200; i++) // Varied lengths and wrapping so range boundaries land everywhere
+    {
+        SeqRecord record = records[i % NRECORDS];
+        fprintf(fp, ">%d>%s\n", i, record.header); // > within headers must not resync ranges
+        fasta_wrap_string(fp, record.seq, record.len - i % 7, 1 + i % 13);
+    }
+    fflush(fp);
+
+    FastaMap serial_map, parallel_map;
+    SeqRecord *serial_records = NULL;
+    fasta_set_nthreads(1);
+    int serial_nrecords = fasta_mmap_read(fileno(fp), &serial_map, &serial_records);
+    if (serial_nrecords != 200)
+        code = 1;
+    for (unsigned int nthreads = 2; nthreads <= 64 && code == 0; nthreads *= 2)
+    {
+        SeqRecord *parallel_records = NULL;
+        fasta_set_nthreads(nthreads);
+        int parallel_nrecords = fasta_mmap_read(fileno(fp), &parallel_map, &parallel_records);
+        if (parallel_nrecords != serial_nrecords)
+            code = 2;
+        for (int i = 0; i < serial_nrecords && code == 0; i++)
+        {
+            SeqRecord *a = serial_records + i, *b = parallel_records + i;
+            if (a->header - serial_map.data != b->header - parallel_map.data ||
+                a->seq - serial_map.data != b->seq - parallel_map.data ||
+                a->header_len != b->header_len || a->len != b->len || a->span != b->span ||
+                a->line_bases != b->line_bases || a->line_width != b->line_width)
+                code = 3;
+        }
+        free(parallel_records);
+        fasta_munmap(&parallel_map);
+    }
+    fasta_set_nthreads(0);
+
+    free(serial_records);
+    fasta_munmap(&serial_map);
+    fclose(fp);
+    return code;
+}
+
+int test_mmap_non_fasta(void)
+{
+    int code = 0;
+    FILE *fp = tmpfile();
+    if (fp == NULL)
+        return 1;
+    fputs("Here's a multiline\nfile that's definitely not\na FASTA.", fp);
+    fflush(fp);
+    FastaMap map;
+    SeqRecord *new_records = NULL;
+    int nrecords = fasta_mmap_read(fileno(fp), &map, &new_records);
+    if (nrecords != FASTA_ERROR_INVALID_FORMAT || map.data != NULL)
+        code = 1;
+    fclose(fp);
+    return code;
+}
+
+int test_index_read_write(void)
+{
+    int code = 0;
+    char path[] = "/tmp/test_fasta_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return 1;
+    char index_path[sizeof(path) + sizeof(FASTA_INDEX_EXT) - 1];
+    snprintf(index_path, sizeof(index_path), "%s%s", path, FASTA_INDEX_EXT);
+    FILE *fp = fdopen(fd, "w+");
+    fasta_fwrite(fp, records, NRECORDS, MAXLEN);
+    fflush(fp);
+
+    FastaMap map, index_map;
+    SeqRecord *new_records = NULL, *index_records = NULL;
+    int nrecords = fasta_mmap_read(fileno(fp), &map, &new_records);
+    if (nrecords != NRECORDS || fasta_index_write(index_path, &map, new_records, nrecords) != 0)
+    {
+        code = 2;
+        goto cleanup;
+    }
+    int index_nrecords = fasta_index_read(index_path, fileno(fp), &index_map, &index_records);
+    if (index_nrecords != NRECORDS)
+    {
+        code = 3;
+        goto cleanup;
+    }
+    for (int i = 0; i < index_nrecords; i++)
+    {
+        SeqRecord *record = index_records + i;
+        char buffer[BUFFERLEN];
+        const char *window = sequences_get_window(record, MAXLEN - 1, MAXLEN + 2, buffer); // Straddles line breaks
+        if (record->header != NULL || memcmp(window, records[i].seq + MAXLEN - 1, MAXLEN + 2) != 0)
+        {
+            code = 4;
+            goto cleanup;
+        }
+        fasta_resolve_record(&index_map, record);
+    }
+    if (records_equal(records, index_records, NRECORDS) != 1)
+        code = 5;
+
+cleanup:
+    free(new_records);
+    free(index_records);
+    fasta_munmap(&map);
+    if (index_nrecords > 0)
+        fasta_munmap(&index_map);
+    fclose(fp);
+    remove(path);
+    remove(index_path);
+    return code;
+}
+
+int test_index_unterminated(void)
+{
+    // A full last line without a line break is still uniformly wrapped, as samtools faidx takes it
+    int code = 0;
+    char path[] = "/tmp/test_fasta_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return 1;
+    char index_path[sizeof(path) + sizeof(FASTA_INDEX_EXT) - 1];
+    snprintf(index_path, sizeof(index_path), "%s%s", path, FASTA_INDEX_EXT);
+    const char data[] = ">id1\nACGTA\nCGTAC\n>id2\nMKLVW\nYMKLV";
+    if (write(fd, data, sizeof(data) - 1) != sizeof(data) - 1)
+    {
+        close(fd);
+        remove(path);
+        return 1;
+    }
+
+    FastaMap map, index_map;
+    SeqRecord *new_records = NULL, *index_records = NULL;
+    int index_nrecords = 0;
+    int nrecords = fasta_mmap_read(fd, &map, &new_records);
+    if (nrecords != 2 || new_records[1].line_bases != 5 || new_records[1].line_width != 6)
+    {
+        code = 2;
+        goto cleanup;
+    }
+    if (fasta_index_write(index_path, &map, new_records, nrecords) != 0)
+    {
+        code = 3;
+        goto cleanup;
+    }
+    index_nrecords = fasta_index_read(index_path, fd, &index_map, &index_records);
+    if (index_nrecords != 2)
+    {
+        code = 4;
+        goto cleanup;
+    }
+    char buffer[16];
+    const char *window = sequences_get_window(index_records + 1, 3, 7, buffer); // Ends at the end of the data
+    if (memcmp(window, "VWYMKLV", 7) != 0)
+        code = 5;
+
+cleanup:
+    free(new_records);
+    free(index_records);
+    if (nrecords > 0)
+        fasta_munmap(&map);
+    if (index_nrecords > 0)
+        fasta_munmap(&index_map);
+    close(fd);
+    remove(path);
+    remove(index_path);
+    return code;
+}
+
+int test_index_stale(void)
+{
+    int code = 0;
+    char path[] = "/tmp/test_fasta_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return 1;
+    char index_path[sizeof(path) + sizeof(FASTA_INDEX_EXT) - 1];
+    snprintf(index_path, sizeof(index_path), "%s%s", path, FASTA_INDEX_EXT);
+    FILE *fp = fdopen(fd, "w+");
+    fputs(">id1\nACGT\n", fp);
+    fflush(fp);
+    FILE *index_fp = fopen(index_path, "w");
+    fputs("id1\t4\t5\t4\t5\nid2\t4\t15\t4\t5\n", index_fp); // Second record is past end of file
+    fclose(index_fp);
+
+    FastaMap map;
+    SeqRecord *new_records = NULL;
+    if (fasta_index_read(index_path, fileno(fp), &map, &new_records) != FASTA_ERROR_INVALID_INDEX || map.data != NULL)
+        code = 2;
+
+    fclose(fp);
+    remove(path);
+    remove(index_path);
+    return code;
+}
+
+int write_bgzf(FILE *fp, const char *data, size_t len, size_t block_len)
+{
+    // Writes data as BGZF blocks of at most block_len bytes followed by the empty EOF block
+    for (size_t offset = 0; offset <= len; offset += block_len)
+    {
+        size_t usize = (len - offset < block_len) ? len - offset : block_len;
+        unsigned char cdata[1024];
+        z_stream stream = {0};
+        if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            return 1;
+        stream.next_in = (unsigned char *)data + offset;
+        stream.avail_in = usize;
+        stream.next_out = cdata;
+        stream.avail_out = sizeof(cdata);
+        int ret = deflate(&stream, Z_FINISH);
+        size_t csize = sizeof(cdata) - stream.avail_out;
+        deflateEnd(&stream);
+        if (ret != Z_STREAM_END)
+            return 1;
+
+        size_t bsize = 18 + csize + 8;
+        unsigned long crc = crc32(crc32(0L, Z_NULL, 0), (unsigned char *)data + offset, usize);
+        unsigned char header[18] = {0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0,
+                                    (bsize - 1) & 0xff, (bsize - 1) >> 8};
+        unsigned char footer[8] = {crc & 0xff, (crc >> 8) & 0xff, (crc >> 16) & 0xff, crc >> 24,
+                                   usize & 0xff, (usize >> 8) & 0xff, 0, 0};
+        fwrite(header, 1, sizeof(header), fp);
+        fwrite(cdata, 1, csize, fp);
+        fwrite(footer, 1, sizeof(footer), fp);
+        if (usize == 0)
+            break;
+    }
+    return fflush(fp);
+}
+
+int test_gz_read(void)
+{
+    int code = 0;
+    char path[] = "/tmp/test_fasta_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return 1;
+    close(fd);
+    char index_path[sizeof(path) + sizeof(FASTA_INDEX_EXT) - 1];
+    snprintf(index_path, sizeof(index_path), "%s%s", path, FASTA_INDEX_EXT);
+    gzFile gz = gzopen(path, "wb");
+    if (gz == NULL)
+    {
+        remove(path);
+        return 1;
+    }
+    gzputs(gz, ">" HEADER1 "\n" SEQ1 "\n>" HEADER2 "\n" SEQ2 "\n>" HEADER3 "\n" SEQ3 "\n");
+    gzclose(gz);
+    FILE *index_fp = fopen(index_path, "w");
+    fprintf(index_fp, "id1\t%zu\t%zu\t%zu\t%zu\n", sizeof(SEQ1) - 1, sizeof(HEADER1) + 1, sizeof(SEQ1) - 1, sizeof(SEQ1));
+    fclose(index_fp);
+
+    FILE *fp = fopen(path, "r");
+    FastaMap map, index_map;
+    SeqRecord *new_records = NULL, *index_records = NULL;
+    int nrecords = fasta_gz_read(fileno(fp), &map, &new_records);
+    if (nrecords != NRECORDS || records_equal(records, new_records, NRECORDS) != 1)
+        code = 2;
+    else if (fasta_index_write(index_path, &map, new_records, nrecords) == 0) // Plain gzip can't be indexed
+        code = 3;
+    else if (fasta_gz_index_read(index_path, fileno(fp), &index_map, &index_records) != FASTA_ERROR_INVALID_INDEX)
+        code = 4;
+
+    free(new_records);
+    if (nrecords > 0)
+        fasta_munmap(&map);
+    fclose(fp);
+    remove(path);
+    remove(index_path);
+    return code;
+}
+
+int test_bgzf_index_read_write(void)
+{
+    int code = 0;
+    char path[] = "/tmp/test_fasta_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return 1;
+    char index_path[sizeof(path) + sizeof(FASTA_INDEX_EXT) - 1];
+    char gzi_path[sizeof(path) + sizeof(BGZF_INDEX_EXT) - 1];
+    snprintf(index_path, sizeof(index_path), "%s%s", path, FASTA_INDEX_EXT);
+    snprintf(gzi_path, sizeof(gzi_path), "%s%s", path, BGZF_INDEX_EXT);
+    FILE *fp = fdopen(fd, "w+");
+    FILE *fasta_fp = tmpfile();
+    fasta_fwrite(fasta_fp, records, NRECORDS, MAXLEN);
+    char data[BUFFERLEN];
+    rewind(fasta_fp);
+    size_t len = fread(data, 1, sizeof(data), fasta_fp);
+    fclose(fasta_fp);
+    write_bgzf(fp, data, len, 16); // Small blocks so records straddle several
+
+    FastaMap map, index_map;
+    SeqRecord *new_records = NULL, *index_records = NULL;
+    int index_nrecords = 0;
+    int nrecords = fasta_gz_read(fileno(fp), &map, &new_records);
+    if (nrecords != NRECORDS || map.len != len || memcmp(map.data, data, len) != 0 ||
+        fasta_index_write(index_path, &map, new_records, nrecords) != 0)
+    {
+        code = 2;
+        goto cleanup;
+    }
+    index_nrecords = fasta_gz_index_read(index_path, fileno(fp), &index_map, &index_records);
+    if (index_nrecords != NRECORDS || index_map.bgzf == NULL)
+    {
+        code = 3;
+        goto cleanup;
+    }
+    if (index_map.data[len - 1] != '\0') // Nothing is inflated until records are resolved
+    {
+        code = 4;
+        goto cleanup;
+    }
+    for (int i = 0; i < index_nrecords; i++)
+    {
+        if (fasta_resolve_record(&index_map, index_records + i) != 0)
+            code = 5;
+    }
+    if (code != 0 || records_equal(records, index_records, NRECORDS) != 1)
+    {
+        code = 6;
+        goto cleanup;
+    }
+
+    // Corrupt the checksum of the block starting the last sequence, which fails as its record is resolved
+    free(index_records);
+    index_records = NULL;
+    fasta_munmap(&index_map);
+    index_nrecords = 0;
+    Bgzf *bgzf = map.bgzf;
+    size_t seq_offset = new_records[NRECORDS - 1].seq - map.data;
+    size_t block = 0;
+    while (block + 1 < bgzf->nblocks && bgzf->blocks[block + 1].uoffset <= seq_offset)
+        block++;
+    if (block + 1 >= bgzf->nblocks) // Block ends where the next begins
+    {
+        code = 7;
+        goto cleanup;
+    }
+    size_t crc_offset = bgzf->blocks[block + 1].coffset - 8;
+    unsigned char crc_byte = bgzf->cdata[crc_offset] ^ 0xff;
+    if (pwrite(fileno(fp), &crc_byte, 1, crc_offset) != 1 || utimensat(AT_FDCWD, index_path, NULL, 0) != 0)
+    {
+        code = 7;
+        goto cleanup;
+    }
+    index_nrecords = fasta_gz_index_read(index_path, fileno(fp), &index_map, &index_records);
+    if (index_nrecords != NRECORDS ||
+        fasta_resolve_record(&index_map, index_records + NRECORDS - 1) != FASTA_ERROR_INVALID_FORMAT ||
+        fasta_resolve_record(&index_map, index_records) != 0)
+        code = 8;
+
+cleanup:
+    free(new_records);
+    free(index_records);
+    if (nrecords > 0)
+        fasta_munmap(&map);
+    if (index_nrecords > 0)
+        fasta_munmap(&index_map);
     fclose(fp);
+    remove(path);
+    remove(index_path);
+    remove(gzi_path);
     return code;
 }
 
@@ -177,10 +804,23 @@ int test_get_id(void)
 
 TestFunction tests[] = {
     {&test_read_write, "test_read_write"},
+    {&test_fdwrite, "test_fdwrite"},
+    {&test_write_atomic, "test_write_atomic"},
+    {&test_read_records, "test_read_records"},
+    {&test_long_lines, "test_long_lines"},
     {&test_no_header, "test_no_header"},
     {&test_empty_file, "test_empty_file"},
     {&test_blank_lines, "test_blank_lines"},
     {&test_non_fasta, "test_non_fasta"},
+    {&test_mmap_read, "test_mmap_read"},
+    {&test_readers_unpacked, "test_readers_unpacked"},
+    {&test_mmap_parallel, "test_mmap_parallel"},
+    {&test_mmap_non_fasta, "test_mmap_non_fasta"},
+    {&test_index_read_write, "test_index_read_write"},
+    {&test_index_unterminated, "test_index_unterminated"},
+    {&test_index_stale, "test_index_stale"},
+    {&test_gz_read, "test_gz_read"},
+    {&test_bgzf_index_read_write, "test_bgzf_index_read_write"},
     {&test_get_id, "test_get_id"},
 };
 
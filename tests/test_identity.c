@@ -0,0 +1,161 @@
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "identity.h"
+#include "sequences.h"
+#include "utils.h"
+
+#define MODULE_NAME "test_identity"
+
+// Bytewise identity of a pair, which the bit planes should match
+float naive_identity(const char *x, const char *y)
+{
+    unsigned int naligned = 0, nidentical = 0;
+    for (size_t k = 0; x[k] != '\0' && y[k] != '\0'; k++)
+    {
+        if (x[k] == '-' || x[k] == '.' || y[k] == '-' || y[k] == '.')
+            continue;
+        naligned++;
+        if (toupper((unsigned char)x[k]) == toupper((unsigned char)y[k]))
+            nidentical++;
+    }
+    return (naligned > 0) ? 100.0f * nidentical / naligned : NAN;
+}
+
+int test_get_pair(void)
+{
+    // Rows differ in length and case, span more than a word, and one never overlaps another
+    char seqs[5][101];
+    strcpy(seqs[0], "ACGT-acgtN.W*");
+    strcpy(seqs[1], "AcGA.aCcT-NWW");
+    strcpy(seqs[2], "------------T");
+    strcpy(seqs[3], "ACG");
+    for (size_t k = 0; k < 100; k++)
+        seqs[4][k] = "ACGTacgt-N"[(k * 7) % 10];
+    seqs[4][100] = '\0';
+    SeqRecord records[5];
+    for (unsigned int i = 0; i < 5; i++)
+        records[i] = (SeqRecord){.seq = seqs[i], .len = strlen(seqs[i]), .span = strlen(seqs[i])};
+
+    IdentityCodes codes;
+    if (identity_encode(&codes, records, 5) != 0)
+        return 1;
+    int code = 0;
+    if (codes.nwords != 2 || codes.nplanes != 3) // A, C, G, N, T, W, and *
+        code = 2;
+    for (unsigned int i = 0; i < 5 && code == 0; i++)
+    {
+        for (unsigned int j = 0; j < 5; j++)
+        {
+            float expected = naive_identity(seqs[i], seqs[j]);
+            float identity = identity_get_pair(&codes, i, j);
+            if (isnan(expected) != isnan(identity) || (!isnan(expected) && fabsf(identity - expected) > 1e-4f))
+                code = 3;
+            identity = identity_compare_records(records + i, records + j);
+            if (isnan(expected) != isnan(identity) || (!isnan(expected) && fabsf(identity - expected) > 1e-4f))
+                code = 5;
+        }
+    }
+    if (!isnan(identity_get_pair(&codes, 2, 3)))
+        code = 4;
+    identity_free(&codes);
+    return code;
+}
+
+int test_compute_rows(void)
+{
+    // Threads split more rows than a block, and rows of a band should match pairs in any order
+    size_t nrows = 3 * IDENTITY_BLOCK_NROWS + 5;
+    char (*seqs)[41] = malloc(nrows * sizeof(*seqs));
+    SeqRecord *records = malloc(nrows * sizeof(SeqRecord));
+    float *identities = malloc(3 * nrows * sizeof(float));
+    if (seqs == NULL || records == NULL || identities == NULL)
+        return 1;
+    unsigned int x = 1;
+    for (size_t i = 0; i < nrows; i++)
+    {
+        for (size_t k = 0; k < 40; k++)
+        {
+            x = 1664525 * x + 1013904223;
+            seqs[i][k] = "ACDEFGHIK-"[(x >> 16) % 10];
+        }
+        seqs[i][40] = '\0';
+        records[i] = (SeqRecord){.seq = seqs[i], .len = 40, .span = 40};
+    }
+
+    int code = 0;
+    IdentityCodes codes;
+    if (identity_encode(&codes, records, nrows) != 0 ||
+        identity_compute_rows(&codes, IDENTITY_BLOCK_NROWS - 1, 3, identities, 3) != 0)
+        code = 2;
+    for (size_t i = 0; i < 3 && code == 0; i++)
+    {
+        for (size_t j = 0; j < nrows; j++)
+        {
+            float identity = identities[i * nrows + j];
+            if (fabsf(identity - identity_get_pair(&codes, j, IDENTITY_BLOCK_NROWS - 1 + i)) > 1e-4f)
+                code = 3;
+        }
+        if (identities[i * nrows + IDENTITY_BLOCK_NROWS - 1 + i] != 100)
+            code = 4;
+    }
+    identity_free(&codes);
+    free(seqs);
+    free(records);
+    free(identities);
+    return code;
+}
+
+int test_write(void)
+{
+    // TSV labels rows and columns with ids, and binary follows its header with rows of floats
+    char *ids[] = {"s1", "s2"};
+    char *seqs[] = {"ACGT", "ACGA"};
+    SeqRecord records[2];
+    for (unsigned int i = 0; i < 2; i++)
+        records[i] = (SeqRecord){.id = ids[i], .id_len = 2, .seq = seqs[i], .len = 4, .span = 4};
+
+    char text[256];
+    FILE *fp = tmpfile();
+    if (fp == NULL || identity_write(fp, records, 2, true, 2) != 0)
+        return 1;
+    rewind(fp);
+    size_t len = fread(text, 1, sizeof(text) - 1, fp);
+    text[len] = '\0';
+    fclose(fp);
+    if (strcmp(text, "id\ts1\ts2\ns1\t100.00\t75.00\ns2\t75.00\t100.00\n") != 0)
+        return 2;
+
+    unsigned char data[256];
+    float expected[] = {100, 75, 75, 100};
+    uint64_t nrows = 2;
+    if ((fp = tmpfile()) == NULL || identity_write(fp, records, 2, false, 1) != 0)
+        return 3;
+    rewind(fp);
+    len = fread(data, 1, sizeof(data), fp);
+    fclose(fp);
+    size_t magic_len = sizeof(IDENTITY_MAGIC) - 1;
+    if (len != magic_len + sizeof(nrows) + sizeof(expected) || memcmp(data, IDENTITY_MAGIC, magic_len) != 0 ||
+        memcmp(data + magic_len, &nrows, sizeof(nrows)) != 0 ||
+        memcmp(data + magic_len + sizeof(nrows), expected, sizeof(expected)) != 0)
+        return 4;
+    return 0;
+}
+
+TestFunction tests[] = {
+    {&test_get_pair, "test_get_pair"},
+    {&test_compute_rows, "test_compute_rows"},
+    {&test_write, "test_write"},
+};
+
+#define NTESTS sizeof(tests) / sizeof(TestFunction)
+
+int main(void)
+{
+    if (sequences_init_base_alphabets() != 0)
+        return 1;
+    run_tests(tests, NTESTS, MODULE_NAME);
+}
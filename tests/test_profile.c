@@ -0,0 +1,80 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "profile.h"
+#include "sequences.h"
+#include "tiles.h"
+#include "utils.h"
+
+#define MODULE_NAME "test_profile"
+
+int test_count_chunk(void)
+{
+    // Columns are one residue, one residue in mixed case, a tie, unlike residues, mostly gaps, and past short rows
+    char *seqs[] = {"AaAWx-", "AAaK-", "AaCK.", "AAcK"};
+    SeqRecord records[4];
+    for (unsigned int i = 0; i < 4; i++)
+        records[i] = (SeqRecord){.seq = seqs[i], .len = strlen(seqs[i]), .span = strlen(seqs[i])};
+
+    int code = 0;
+    Tiles tiles;
+    Profile profile;
+    if (tiles_init(&tiles, 4, 6) != 0)
+        return 1;
+    if (profile_init(&profile, 4, 6, PROFILE_NUCLEIC_MAX_ENTROPY) != 0)
+    {
+        tiles_free(&tiles);
+        return 1;
+    }
+    tiles_fill_tile(&tiles, 0, 0, records);
+    profile_count_chunk(&profile, &tiles, 0);
+
+    char consensus[] = "AAAKX-";
+    float gap_fractions[] = {0, 0, 0, 0, 0.75f, 1};
+    float entropies[] = {0, 0, 1, 0.811278f, 0, 0};
+    for (unsigned int j = 0; j < 6; j++)
+    {
+        if (profile.consensus[j] != consensus[j])
+            code = 2;
+        if (fabsf(profile.gap_fractions[j] - gap_fractions[j]) > 1e-5f ||
+            fabsf(profile.entropies[j] - entropies[j]) > 1e-5f)
+            code = 3;
+    }
+    if (profile.counts[PROFILE_CLASS_A] != 4 || profile.counts[4 * PROFILE_NCLASSES + PROFILE_CLASS_GAP] != 2 ||
+        profile.counts[4 * PROFILE_NCLASSES + PROFILE_CLASS_EMPTY] != TILES_NROWS - 3) // Short row and padding
+        code = 4;
+    if (profile.conservations[0] != 1 || fabsf(profile.conservations[2] - 0.5f) > 1e-5f ||
+        profile.conservations[5] != 0)
+        code = 5;
+
+    profile_free(&profile);
+    tiles_free(&tiles);
+    return code;
+}
+
+int test_get_size(void)
+{
+    // Tiles are padded to whole bands and tile columns
+    size_t size = profile_get_size(65, TILES_NCOLS + 1);
+    size_t tiles_size = 2 * TILES_NROWS * 2 * TILES_NCOLS;
+    if (size <= tiles_size || size - tiles_size != profile_get_size(0, TILES_NCOLS + 1))
+        return 1;
+    if (profile_get_size(SIZE_MAX / 2, SIZE_MAX / 2) != SIZE_MAX)
+        return 2;
+    return 0;
+}
+
+TestFunction tests[] = {
+    {&test_count_chunk, "test_count_chunk"},
+    {&test_get_size, "test_get_size"},
+};
+
+#define NTESTS sizeof(tests) / sizeof(TestFunction)
+
+int main(void)
+{
+    if (sequences_init_base_alphabets() != 0)
+        return 1;
+    run_tests(tests, NTESTS, MODULE_NAME);
+}
@@ -0,0 +1,130 @@
+#include <string.h>
+
+#include "array.h"
+#include "screen.h"
+#include "utils.h"
+
+#define MODULE_NAME "test_screen"
+
+int test_flush_changes(void)
+{
+    // Only the changed cell is written, followed by the cursor's move back to where rendering left it
+    Screen screen;
+    Array output;
+    if (screen_init(&screen, 3, 10) != 0)
+        return 1;
+    if (array_init(&output, sizeof(char)) != 0)
+    {
+        screen_free(&screen);
+        return 1;
+    }
+    int code = 0;
+    char frame_1[] = "\x1b[2;1Habcdef";
+    char frame_2[] = "\x1b[2;1Habxdef";
+    char expected[] = "\x1b[?25l\x1b[2;3Hx\x1b[2;7H\x1b[?25h";
+    screen_render(&screen, frame_1, sizeof(frame_1) - 1);
+    screen_flush(&screen, &output);
+    if (output.len == 0 || memcmp(output.data, "\x1b[39;49m\x1b[2J", 12) != 0)
+        code = 2;
+    output.len = 0;
+    screen_render(&screen, frame_2, sizeof(frame_2) - 1);
+    screen_flush(&screen, &output);
+    if (output.len != sizeof(expected) - 1 || memcmp(output.data, expected, output.len) != 0)
+        code = 3;
+    output.len = 0;
+    screen_render(&screen, frame_2, sizeof(frame_2) - 1);
+    screen_flush(&screen, &output);
+    if (output.len != 0 || screen.nframes != 2 || screen.nbytes_frame != sizeof(expected) - 1)
+        code = 4;
+
+    array_free(&output);
+    screen_free(&screen);
+    return code;
+}
+
+int test_move_cells(void)
+{
+    // Scrolled and shifted cells are moved in the front grid, so only the exposed cells are written after
+    Screen screen;
+    Array output;
+    if (screen_init(&screen, 4, 6) != 0)
+        return 1;
+    if (array_init(&output, sizeof(char)) != 0)
+    {
+        screen_free(&screen);
+        return 1;
+    }
+    int code = 0;
+    char frame_1[] = "\x1b[1;1Habcdef\x1b[2;1Ha\x1b[3;1Hb\x1b[4;1Hc";
+    char frame_2[] = "\x1b[1;1Habdefg\x1b[2;1Hb\x1b[3;1Hc\x1b[4;1Hd";
+    char expected[] = "\x1b[?25l\x1b[2;4r\x1b[1S\x1b[r\x1b[1;3H\x1b[1Pdefg\x1b[4;1Hd\x1b[?25h";
+    screen_render(&screen, frame_1, sizeof(frame_1) - 1);
+    screen_flush(&screen, &output);
+    output.len = 0;
+    screen_scroll_rows(&screen, &output, 1, 3, 1);
+    screen_shift_columns(&screen, &output, 0, 0, 2, 1);
+    screen_render(&screen, frame_2, sizeof(frame_2) - 1);
+    screen_flush(&screen, &output);
+    if (output.len != sizeof(expected) - 1 || memcmp(output.data, expected, output.len) != 0)
+        code = 2;
+    if (screen.nbytes_frame != sizeof(expected) - 1)
+        code = 3;
+
+    array_free(&output);
+    screen_free(&screen);
+    return code;
+}
+
+int test_render_colors(void)
+{
+    // Colors are tracked through SGR sequences, and erases blank cells in the current colors
+    Screen screen;
+    if (screen_init(&screen, 2, 8) != 0)
+        return 1;
+    int code = 0;
+    char frame[] = "\x1b[1;1H\x1b[31;42ma\x1b[38;5;200;48;5;3mb\x1b[39mc\x1b[0K\x1b[0m\x1b[2;1Hd\b\be\n\bf";
+    screen_render(&screen, frame, sizeof(frame) - 1);
+    Cell *cells = screen.back;
+    if (cells[0].fg != (SCREEN_COLOR_4_BIT | 31) || cells[0].bg != (SCREEN_COLOR_4_BIT | 42) ||
+        cells[1].fg != (SCREEN_COLOR_8_BIT | 200) || cells[1].bg != (SCREEN_COLOR_8_BIT | 3))
+        code = 2;
+    if (cells[2].glyph[0] != 'c' || cells[2].fg != SCREEN_COLOR_DEFAULT || cells[7].glyph[0] != ' ' ||
+        cells[7].bg != (SCREEN_COLOR_8_BIT | 3))
+        code = 3;
+    if (cells[8].glyph[0] != 'f' || cells[9].glyph[0] != ' ' || screen.i != 1 || screen.j != 1)
+        code = 4; // Newlines stop at the last row, so f overwrites e
+    screen_free(&screen);
+    return code;
+}
+
+int test_render_utf8(void)
+{
+    // Multibyte characters take one cell, and a glyph in the last column leaves a wrap pending
+    Screen screen;
+    if (screen_init(&screen, 2, 3) != 0)
+        return 1;
+    int code = 0;
+    char frame[] = "\x1b[1;2H┃━━x";
+    screen_render(&screen, frame, sizeof(frame) - 1);
+    Cell *cells = screen.back;
+    if (cells[1].len != 3 || memcmp(cells[1].glyph, "┃", 3) != 0 || cells[2].len != 3)
+        code = 2;
+    if (memcmp(cells[3].glyph, "━", 3) != 0 || cells[4].glyph[0] != 'x')
+        code = 3;
+    screen_free(&screen);
+    return code;
+}
+
+TestFunction tests[] = {
+    {&test_flush_changes, "test_flush_changes"},
+    {&test_move_cells, "test_move_cells"},
+    {&test_render_colors, "test_render_colors"},
+    {&test_render_utf8, "test_render_utf8"},
+};
+
+#define NTESTS sizeof(tests) / sizeof(TestFunction)
+
+int main(void)
+{
+    run_tests(tests, NTESTS, MODULE_NAME);
+}
@@ -0,0 +1,269 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "sequences.h"
+#include "utils.h"
+
+#define MODULE_NAME "test_sequences"
+
+int test_infer_seq_type(void)
+{
+    typedef struct
+    {
+        char *seq;
+        SeqType type;
+        int code;
+    } TypeTest;
+    TypeTest tests[] = {
+        {"", SEQ_TYPE_INDETERMINATE, 0},
+        {"ACGT", SEQ_TYPE_INDETERMINATE, 0},
+        {"acgtacgtacgtacgtacgn-", SEQ_TYPE_INDETERMINATE, 0},
+        {"ACGTACGTACGTACGTU", SEQ_TYPE_NUCLEIC, 0},
+        {"ACGTACGTACGTACGTWY", SEQ_TYPE_PROTEIN, 0},
+        {"MKLVWYMKLVWYMKLVWYU", SEQ_TYPE_UNKNOWN, 1},
+        {"ACGTACGTJ", SEQ_TYPE_UNKNOWN, 1},
+        {"ACGTACGTACGTACGT\xc3\xa9", SEQ_TYPE_ERROR, 2},
+        {"JJJJJJJJJJJJJJJJJJJJ\xc3\xa9", SEQ_TYPE_ERROR, 2}, // Non-ASCII after all alphabets are ruled out
+        {NULL, 0, 0},
+    };
+
+    int code = 0;
+    for (TypeTest *test = tests; test->seq != NULL; test++)
+    {
+        SeqRecord record = {.seq = test->seq, .len = strlen(test->seq)};
+        if (sequences_infer_seq_type(&record) != test->code || record.type != test->type)
+            code++;
+    }
+    return code;
+}
+
+int test_infer_seq_type_span(void)
+{
+    // Line breaks in uncompacted spans are skipped
+    char seq[] = "ACGTACGTAC\nGTACGTACGU\r\nAC";
+    SeqRecord record = {.seq = seq, .len = 22, .span = sizeof(seq) - 1};
+    if (sequences_infer_seq_type(&record) != 0 || record.type != SEQ_TYPE_NUCLEIC)
+        return 1;
+    record.span = 0; // Compacted sequences with line breaks are unknown
+    record.len = sizeof(seq) - 1;
+    if (sequences_infer_seq_type(&record) != 1 || record.type != SEQ_TYPE_UNKNOWN)
+        return 2;
+    return 0;
+}
+
+int test_sample_seq_type(void)
+{
+    size_t len = 1 << 20;
+    char *seq = malloc(len);
+    if (seq == NULL)
+        return 1;
+    typedef struct
+    {
+        char *syms;
+        size_t pos; // Position of sym, if set
+        char sym;
+        SeqType type;
+        int code;
+    } SampleTest;
+    SampleTest tests[] = {
+        {"ACGT", 0, 0, SEQ_TYPE_INDETERMINATE, 0},
+        {"ACGU", 0, 0, SEQ_TYPE_NUCLEIC, 0},
+        {"ACDEFGHIKLMNPQRSTVWY", 0, 0, SEQ_TYPE_PROTEIN, 0},
+        {"ACGT", 100, 'E', SEQ_TYPE_PROTEIN, 0},            // Too little evidence in sample, so scanned in full
+        {"ACGT", 100, 'J', SEQ_TYPE_UNKNOWN, 1},            // Unknown is confirmed by a full scan
+        {"ACDEFGHIKLMNPQRSTVWY", 100, '\xff', SEQ_TYPE_ERROR, 2},
+        {"ACGU", (1 << 20) - 1, '\xff', SEQ_TYPE_ERROR, 2}, // Non-ASCII symbols past the sample are still found
+        {"ACDEFGHIKLMNPQRSTVWY", (1 << 20) - 1, '\xff', SEQ_TYPE_ERROR, 2},
+        {"ACGT", (1 << 20) - 1, '\xff', SEQ_TYPE_ERROR, 2},
+        {NULL, 0, 0, 0, 0},
+    };
+
+    int code = 0;
+    for (SampleTest *test = tests; test->syms != NULL; test++)
+    {
+        size_t nsyms = strlen(test->syms);
+        for (size_t i = 0; i < len; i++)
+            seq[i] = test->syms[i * 7 % nsyms];
+        if (test->sym != 0)
+            seq[test->pos] = test->sym;
+        SeqRecord record = {.seq = seq, .len = len};
+        if (sequences_sample_seq_type(&record) != test->code || record.type != test->type)
+            code++;
+    }
+
+    // Sampled indeterminate records are still called nucleic past the tiebreak length
+    memset(seq, 'A', len);
+    SeqRecord record = {.seq = seq, .len = len};
+    if (sequences_assign_seq_type(&record, SEQ_TYPE_UNSPECIFIED, 10, 1024) != 0 || record.type != SEQ_TYPE_NUCLEIC)
+        code++;
+    free(seq);
+    return code;
+}
+
+int test_pack_seq(void)
+{
+    typedef struct
+    {
+        char *syms;
+        char *blocks; // Residues written every 400 from 40, so runs start and end within words
+        SeqType type;
+        unsigned int packed_bits;
+    } PackTest;
+    PackTest tests[] = {
+        {"ACGT", "acgtnNNN--acgn", SEQ_TYPE_NUCLEIC, 2},
+        {"ACDEFGHIKLMNPQRSTVWY", "---mklvx.", SEQ_TYPE_PROTEIN, 5},
+        {"ACGT", "", SEQ_TYPE_NUCLEIC, 2},
+        {"ACGTN-", "", SEQ_TYPE_NUCLEIC, 0}, // Runs of alternating residues take more bytes than they hold
+        {"ACGTJ", "", SEQ_TYPE_UNKNOWN, 0},
+        {NULL, NULL, 0, 0},
+    };
+
+    int code = 0;
+    size_t len = 4000;
+    char *seq = malloc(len + 1);
+    char *expected = malloc(len);
+    char *buffer = malloc(len);
+    if (seq == NULL || expected == NULL || buffer == NULL)
+    {
+        code = 1;
+        goto cleanup;
+    }
+    for (PackTest *test = tests; test->syms != NULL; test++)
+    {
+        size_t nsyms = strlen(test->syms);
+        for (size_t i = 0; i < len; i++)
+            expected[i] = test->syms[i * 7 % nsyms];
+        for (size_t i = 40; i < len; i += 400)
+            memcpy(expected + i, test->blocks, strlen(test->blocks));
+        memcpy(seq, expected, len);
+        SeqRecord record = {.seq = seq, .len = len, .span = len, .type = test->type};
+        size_t size;
+        int pack_code = sequences_pack_seq(&record, &size);
+        if (pack_code != (test->packed_bits > 0 ? 0 : 1) || record.packed_bits != test->packed_bits ||
+            (pack_code == 0 && size >= len))
+        {
+            code++;
+            continue;
+        }
+
+        size_t windows[][2] = {{0, 4000}, {0, 1}, {5, 30}, {43, 13}, {45, 64}, {1230, 500}, {3999, 1}};
+        for (unsigned int i = 0; i < sizeof(windows) / sizeof(windows[0]); i++)
+        {
+            size_t start = windows[i][0], n = windows[i][1];
+            if (memcmp(sequences_get_window(&record, start, n, buffer), expected + start, n) != 0)
+                code++;
+        }
+    }
+
+cleanup:
+    free(seq);
+    free(expected);
+    free(buffer);
+    return code;
+}
+
+int test_pack_seq_gaps(void)
+{
+    typedef struct
+    {
+        char *syms;
+        SeqType type;
+        unsigned int packed_bits;
+    } GapTest;
+    GapTest tests[] = {
+        {"ACGT", SEQ_TYPE_NUCLEIC, 2},
+        {"ACDEFGHIKLMNPQRSTVWY", SEQ_TYPE_PROTEIN, 5},
+        {"ACGTJ", SEQ_TYPE_UNKNOWN, 0}, // Residues without codes are kept as they are
+        {NULL, 0, 0},
+    };
+
+    int code = 0;
+    size_t len = 4000;
+    char *seq = malloc(len + 1);
+    char *expected = malloc(len);
+    char *buffer = malloc(len);
+    if (seq == NULL || expected == NULL || buffer == NULL)
+    {
+        code = 1;
+        goto cleanup;
+    }
+    for (GapTest *test = tests; test->syms != NULL; test++)
+    {
+        // Blocks of 10 residues between runs of both gap symbols
+        size_t nsyms = strlen(test->syms);
+        for (size_t i = 0; i < len; i++)
+        {
+            size_t col = i % 100;
+            expected[i] = (col < 10) ? test->syms[i * 7 % nsyms] : (col < 60) ? '-' : '.';
+        }
+        memcpy(seq, expected, len);
+        SeqRecord record = {.seq = seq, .len = len, .span = len, .type = test->type};
+        size_t size;
+        if (sequences_pack_seq(&record, &size) != 0 || record.ngap_runs != 80 ||
+            record.packed_bits != test->packed_bits || size >= len / 5)
+        {
+            code++;
+            continue;
+        }
+
+        size_t windows[][2] = {{0, 4000}, {0, 1}, {5, 30}, {15, 13}, {60, 1}, {55, 64}, {1230, 500}, {3999, 1}};
+        for (unsigned int i = 0; i < sizeof(windows) / sizeof(windows[0]); i++)
+        {
+            size_t start = windows[i][0], n = windows[i][1];
+            if (memcmp(sequences_get_window(&record, start, n, buffer), expected + start, n) != 0)
+                code++;
+        }
+    }
+
+cleanup:
+    free(seq);
+    free(expected);
+    free(buffer);
+    return code;
+}
+
+int test_dot_identities(void)
+{
+    // Lengths leave tails past whole words, and residues and gaps match at every offset within words
+    char seq[64], reference[64], dst[64];
+    for (size_t i = 0; i < 64; i++)
+    {
+        seq[i] = "AC-.gT"[i * 5 % 6];
+        reference[i] = "AC-.GT"[i * 7 % 6];
+    }
+
+    int code = 0;
+    for (size_t len = 0; len <= 64; len += 13)
+    {
+        sequences_dot_identities(dst, seq, reference, len);
+        for (size_t i = 0; i < len; i++)
+        {
+            bool dotted = seq[i] == reference[i] && seq[i] != '-' && seq[i] != '.';
+            if (dst[i] != (dotted ? '.' : seq[i]))
+                code++;
+        }
+    }
+    memcpy(dst, seq, 64); // In place
+    sequences_dot_identities(dst, dst, reference, 64);
+    if (dst[0] != '.' || dst[2] != 'g' || dst[4] != '-')
+        code++;
+    return code;
+}
+
+TestFunction tests[] = {
+    {&test_infer_seq_type, "test_infer_seq_type"},
+    {&test_infer_seq_type_span, "test_infer_seq_type_span"},
+    {&test_sample_seq_type, "test_sample_seq_type"},
+    {&test_pack_seq, "test_pack_seq"},
+    {&test_pack_seq_gaps, "test_pack_seq_gaps"},
+    {&test_dot_identities, "test_dot_identities"},
+};
+
+#define NTESTS sizeof(tests) / sizeof(TestFunction)
+
+int main(void)
+{
+    if (sequences_init_base_alphabets() != 0)
+        return 1;
+    run_tests(tests, NTESTS, MODULE_NAME);
+}
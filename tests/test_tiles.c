@@ -0,0 +1,114 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sequences.h"
+#include "tiles.h"
+#include "utils.h"
+
+#define MODULE_NAME "test_tiles"
+
+#define NROWS 70 // Partial second band
+#define NCOLS 5000
+
+char seqs[NROWS][NCOLS];
+SeqRecord records[NROWS];
+
+void make_records(void)
+{
+    // Rows vary in length, so some end before the second tile column
+    for (size_t i = 0; i < NROWS; i++)
+    {
+        size_t len = NCOLS - i * 37;
+        for (size_t j = 0; j < len; j++)
+            seqs[i][j] = "ACGT-"[(i + j * 3) % 5];
+        records[i] = (SeqRecord){.seq = seqs[i], .len = len, .span = len, .type = SEQ_TYPE_NUCLEIC};
+    }
+}
+
+int test_fill(void)
+{
+    make_records();
+    size_t size;
+    sequences_pack_seq(records + 1, &size); // Packed rows are decoded as they are copied
+    char window[NCOLS];
+    Tiles tiles;
+    if (tiles_init(&tiles, NROWS, NCOLS) != 0)
+        return 1;
+    for (size_t tile_col = tiles.ntile_cols; tile_col-- > 0;) // In any order
+    {
+        tiles_fill_tile(&tiles, 1, tile_col, records + TILES_NROWS);
+        tiles_fill_tile(&tiles, 0, tile_col, records);
+    }
+    tiles_fill_tile(&tiles, 2, 0, records); // Past the last band does nothing
+
+    int code = 0;
+    for (size_t j = 0; j < NCOLS && code == 0; j++)
+    {
+        for (size_t i = 0; i < tiles.nbands * TILES_NROWS; i++)
+        {
+            char expected = '\0';
+            if (i < NROWS && j < records[i].len)
+                expected = *sequences_get_window(records + i, j, 1, window);
+            if (tiles_get_column(&tiles, i / TILES_NROWS, j)[i % TILES_NROWS] != expected)
+            {
+                code = 2;
+                break;
+            }
+        }
+    }
+    tiles_free(&tiles);
+    return code;
+}
+
+int test_count_columns(void)
+{
+    make_records();
+    unsigned char classes[256] = {0}; // Padding and other symbols
+    classes['-'] = 1;
+    classes['A'] = 2;
+    Tiles tiles;
+    if (tiles_init(&tiles, NROWS, NCOLS) != 0)
+        return 1;
+    for (size_t band = 0; band < tiles.nbands; band++)
+        for (size_t tile_col = 0; tile_col < tiles.ntile_cols; tile_col++)
+            tiles_fill_tile(&tiles, band, tile_col, records + band * TILES_NROWS);
+
+    // Counts are added over a range crossing tile columns
+    int code = 0;
+    size_t start = 3998, ncols = 1000; // Unaligned to groups of columns
+    uint32_t *counts = calloc(ncols * 3, sizeof(uint32_t));
+    if (counts == NULL)
+    {
+        code = 2;
+        goto cleanup;
+    }
+    tiles_count_columns(&tiles, start, ncols, classes, 3, counts);
+    for (size_t j = 0; j < ncols; j++)
+    {
+        uint32_t expected[3] = {0, 0, 0};
+        for (size_t i = 0; i < tiles.nbands * TILES_NROWS; i++)
+            expected[(i < NROWS && start + j < records[i].len) ? classes[(unsigned char)seqs[i][start + j]] : 0]++;
+        if (memcmp(counts + j * 3, expected, sizeof(expected)) != 0)
+            code = 3;
+    }
+
+cleanup:
+    free(counts);
+    tiles_free(&tiles);
+    return code;
+}
+
+TestFunction tests[] = {
+    {&test_fill, "test_fill"},
+    {&test_count_columns, "test_count_columns"},
+};
+
+#define NTESTS sizeof(tests) / sizeof(TestFunction)
+
+int main(void)
+{
+    if (sequences_init_base_alphabets() != 0)
+        return 1;
+    run_tests(tests, NTESTS, MODULE_NAME);
+}
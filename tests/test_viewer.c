@@ -0,0 +1,263 @@
+#if defined(_XOPEN_SOURCE) && _XOPEN_SOURCE < 600 // For pseudo-terminals
+#undef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 600
+#endif
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+#define MODULE_NAME "test_viewer"
+
+/*
+ * Runs the viewer in a pseudo-terminal and checks what it draws as files load and keys are sent
+ */
+
+#define VIEWER_PATH "build/" PROGRAM_NAME
+#define OUTPUT_SIZE (1 << 20)
+#define NROWS 24
+#define NCOLS 80
+#define NRECORDS 100
+
+char dir[] = "/tmp/test_viewer_XXXXXX";
+char path[sizeof(dir) + sizeof("/other.fa")];
+char stream_path[sizeof(dir) + sizeof("/stream.fa")];
+char nonascii_path[sizeof(dir) + sizeof("/nonascii.fa")];
+char indexed_path[sizeof(dir) + sizeof("/indexed.fa")];
+char index_path[sizeof(dir) + sizeof("/indexed.fa.fai")];
+
+char output[OUTPUT_SIZE];
+size_t output_len = 0;
+
+int start_viewer(char **argv, int input_fd, pid_t *pid)
+{
+    // Returns the controlling side of a pseudo-terminal the viewer runs in with input_fd as its stdin
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd == -1 || grantpt(fd) != 0 || unlockpt(fd) != 0)
+        return -1;
+    char *name = ptsname(fd);
+    if (name == NULL)
+        return -1;
+    struct winsize size = {.ws_row = NROWS, .ws_col = NCOLS};
+    if ((*pid = fork()) == -1)
+        return -1;
+    if (*pid == 0)
+    {
+        setsid();
+        int terminal_fd = open(name, O_RDWR);
+        if (terminal_fd == -1)
+            _exit(127);
+        ioctl(terminal_fd, TIOCSWINSZ, &size);
+        dup2(input_fd, STDIN_FILENO);
+        dup2(terminal_fd, STDOUT_FILENO);
+        dup2(terminal_fd, STDERR_FILENO);
+        setenv("TERM", "xterm", 1);
+        execv(VIEWER_PATH, argv);
+        _exit(127);
+    }
+    close(input_fd);
+    output_len = 0;
+    return fd;
+}
+
+void stop_viewer(int fd, pid_t pid)
+{
+    ssize_t n = write(fd, "q", 1);
+    (void)n;
+    for (int i = 0; i < 20 && waitpid(pid, NULL, WNOHANG) == 0; i++)
+        usleep(50000);
+    if (kill(pid, SIGKILL) == 0)
+        waitpid(pid, NULL, 0);
+    close(fd);
+}
+
+bool command_row_has(const char *text)
+{
+    // Replays the writes to the command pane, which are only made to cells that changed, and searches the row
+    char row[NCOLS + 1];
+    memset(row, ' ', NCOLS);
+    row[NCOLS] = '\0';
+    char prefix[16];
+    int prefix_len = snprintf(prefix, sizeof(prefix), "\033[%d;", NROWS);
+    for (char *p = output; (p = strstr(p, prefix)) != NULL;)
+    {
+        long col = strtol(p + prefix_len, &p, 10);
+        if (*p != 'H')
+            continue;
+        for (p++; col >= 1 && col <= NCOLS && *p >= ' ' && *p <= '~'; col++, p++)
+            row[col - 1] = *p;
+    }
+    return strstr(row, text) != NULL;
+}
+
+bool wait_output(int fd, const char *text, size_t from, bool command_row, int timeout_ms)
+{
+    // Reads the viewer's output until text is written after from, or shown in the command pane, or the timeout passes
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (1)
+    {
+        output[output_len] = '\0';
+        if (command_row ? command_row_has(text) : strstr(output + from, text) != NULL)
+            return true;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long elapsed = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        if (elapsed >= timeout_ms || poll(&pfd, 1, timeout_ms - elapsed) <= 0)
+            return false;
+        ssize_t n = read(fd, output + output_len, OUTPUT_SIZE - 1 - output_len);
+        if (n <= 0)
+            return false;
+        output_len += n;
+    }
+}
+
+int write_records(int fd, int start, int stop)
+{
+    char record[32];
+    for (int i = start; i < stop; i++)
+    {
+        int n = snprintf(record, sizeof(record), ">stream%d\nACGTACGT\n", i);
+        if (write(fd, record, n) != n)
+            return 1;
+    }
+    return 0;
+}
+
+int test_switch_while_loading(void)
+{
+    // The viewer starts before later files load, and a file switched to while it streams is redrawn as it loads
+    // though no keys follow the switch
+    char *argv[] = {PROGRAM_NAME, path, stream_path, NULL};
+    pid_t pid;
+    int input_fd = open("/dev/null", O_RDONLY);
+    if (input_fd == -1)
+        return 1;
+    int fd = start_viewer(argv, input_fd, &pid);
+    if (fd == -1)
+        return 2;
+    int code = 0;
+    int stream_fd = -1;
+    if (!wait_output(fd, "\033[?1049h", 0, false, 5000)) // Keys sent before raw mode are discarded
+        code = 3;
+    else if (write(fd, ">", 1) != 1 || !wait_output(fd, "stream.fa", output_len, true, 5000))
+        code = 4;
+    else if ((stream_fd = open(stream_path, O_WRONLY | O_NONBLOCK)) == -1) // The viewer is already opening it
+        code = 5;
+    else if (fcntl(stream_fd, F_SETFL, 0) != 0 || write_records(stream_fd, 0, NRECORDS) != 0)
+        code = 6;
+    if (stream_fd != -1)
+        close(stream_fd);
+    char count[32];
+    snprintf(count, sizeof(count), "ROW 1/%d", NRECORDS); // Only the loaded records are counted in the command pane
+    if (code == 0 && !wait_output(fd, count, output_len, true, 5000))
+        code = 7;
+    stop_viewer(fd, pid);
+    return code;
+}
+
+int test_nonascii_prompt(void)
+{
+    // Later files with non-ASCII symbols are prompted for when switched to, and declining returns to the previous file
+    char *argv[] = {PROGRAM_NAME, path, nonascii_path, NULL};
+    pid_t pid;
+    int input_fd = open("/dev/null", O_RDONLY);
+    if (input_fd == -1)
+        return 1;
+    int fd = start_viewer(argv, input_fd, &pid);
+    if (fd == -1)
+        return 2;
+    int code = 0;
+    if (!wait_output(fd, "\033[?1049h", 0, false, 5000))
+        code = 3;
+    else if (write(fd, ">", 1) != 1 || !wait_output(fd, "(y/n)", output_len, true, 5000))
+        code = 4;
+    else if (write(fd, "n", 1) != 1 || !wait_output(fd, "other.fa  ", output_len, true, 5000))
+        code = 5;
+    else if (write(fd, ">", 1) != 1 || !wait_output(fd, "(y/n)", output_len, true, 5000))
+        code = 6;
+    else if (write(fd, "y", 1) != 1 || !wait_output(fd, "non-ASCII symbols  ROW", output_len, true, 5000))
+        code = 7;
+    stop_viewer(fd, pid);
+    return code;
+}
+
+int test_indexed_nonascii_prompt(void)
+{
+    // Indexed files are checked for non-ASCII symbols as their records are shown, so the prompt follows in the viewer
+    char *argv[] = {PROGRAM_NAME, indexed_path, NULL};
+    pid_t pid;
+    int input_fd = open("/dev/null", O_RDONLY);
+    if (input_fd == -1)
+        return 1;
+    int fd = start_viewer(argv, input_fd, &pid);
+    if (fd == -1)
+        return 2;
+    int code = 0;
+    if (!wait_output(fd, "\033[?1049h", 0, false, 5000))
+        code = 3;
+    else if (!wait_output(fd, "(y/n)", output_len, true, 5000))
+        code = 4;
+    else if (write(fd, "y", 1) != 1 || !wait_output(fd, "non-ASCII symbols  ROW", output_len, true, 5000))
+        code = 5;
+    stop_viewer(fd, pid);
+    return code;
+}
+
+TestFunction tests[] = {
+    {&test_switch_while_loading, "test_switch_while_loading"},
+    {&test_nonascii_prompt, "test_nonascii_prompt"},
+    {&test_indexed_nonascii_prompt, "test_indexed_nonascii_prompt"},
+};
+
+#define NTESTS sizeof(tests) / sizeof(TestFunction)
+
+int main(void)
+{
+    if (mkdtemp(dir) == NULL)
+        return 1;
+    snprintf(path, sizeof(path), "%s/other.fa", dir);
+    snprintf(stream_path, sizeof(stream_path), "%s/stream.fa", dir);
+    snprintf(nonascii_path, sizeof(nonascii_path), "%s/nonascii.fa", dir);
+    snprintf(indexed_path, sizeof(indexed_path), "%s/indexed.fa", dir);
+    snprintf(index_path, sizeof(index_path), "%s/indexed.fa.fai", dir);
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+        return 1;
+    fputs(">other0\nACGTACGT\n>other1\nACGAACGA\n", fp);
+    if (fclose(fp) != 0)
+        return 1;
+    if ((fp = fopen(nonascii_path, "w")) == NULL)
+        return 1;
+    fputs(">nonascii0\nACG\xc3\xa9TACGT\n", fp);
+    if (fclose(fp) != 0 || mkfifo(stream_path, 0600) != 0)
+        return 1;
+    if ((fp = fopen(indexed_path, "w")) == NULL)
+        return 1;
+    fputs(">indexed0\nACG\xc3\xa9TACGT\n", fp);
+    if (fclose(fp) != 0 || (fp = fopen(index_path, "w")) == NULL) // Written after the file, so it is not stale
+        return 1;
+    fputs("indexed0\t11\t10\t11\t12\n", fp);
+    if (fclose(fp) != 0)
+        return 1;
+
+    run_tests(tests, NTESTS, MODULE_NAME);
+
+    remove(path);
+    remove(stream_path);
+    remove(nonascii_path);
+    remove(indexed_path);
+    remove(index_path);
+    rmdir(dir);
+}